@@ -0,0 +1,638 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "culling.hpp"
+#include "scenepipeline.hpp"
+#include "threadpool.hpp"
+
+namespace ldrawviewer {
+
+enum BenchmarkStage
+{
+  STAGE_CREATE_LOADER,
+  STAGE_DEPENDENCY,
+  STAGE_CACHE_LOOKUP,
+  STAGE_SCHEDULE,
+  STAGE_LOAD,
+  STAGE_RESOLVE,
+  STAGE_FIX,
+  STAGE_BUILD,
+  STAGE_RENDER_MODEL,
+  STAGE_OPTIMIZE,
+  STAGE_LODS,
+  STAGE_CACHE_STORE,
+  STAGE_LAYOUT,
+  STAGE_PACK,
+  STAGE_TOTAL,
+  NUM_STAGES,
+};
+
+static const char* s_stageNames[NUM_STAGES] = {
+    "create_loader", "dependency",   "cache_lookup", "schedule", "load",        "resolve", "fix",
+    "build",         "render_model", "optimize",     "lods",     "cache_store", "layout",  "pack", "total",
+};
+
+struct BenchmarkConfig
+{
+  uint32_t                 repetitions = 1;
+  uint32_t                 threads     = 0;
+  std::string              jsonFile;
+  std::string              ldrawPath;
+  std::string              partCostFile;
+  std::string              partCacheFile;
+  SceneLoadSettings        settings;
+  LdrLoaderCreateInfo      createInfo     = {};
+  bool                     drawRenderPart = false;
+  SceneVertexFormat        vertexFormat;
+  uint32_t                 cullReference = 0;  // resolution of the occlusion validation, 0 disables it
+  std::vector<std::string> models;
+};
+
+// hi-z occlusion of the packed scene against ground truth from the reference rasterizer
+struct CullReferenceResult
+{
+  bool     valid         = false;
+  uint32_t width         = 0;
+  uint32_t height        = 0;
+  uint32_t commands      = 0;
+  uint32_t frustumCulled = 0;
+  uint32_t hidden        = 0;  // no fragment passes the depth test
+  uint32_t occluded      = 0;  // culled by the pyramid
+  uint32_t falseOccluded = 0;  // culled by the pyramid but not hidden, must stay 0
+  double   rasterTime    = 0;
+  double   pyramidTime   = 0;
+  double   cullTime      = 0;
+};
+
+struct BenchmarkResult
+{
+  std::string          model;
+  std::string          error;
+  uint32_t             numParts     = 0;
+  uint32_t             numInstances = 0;
+  SceneLayout          layout;
+  QuantizationError    quantizationError = {};  // maximum over all parts
+  uint32_t             optimizedParts    = 0;   // parts optimized in the first repetition, summed in vertexCache
+  OptimizedPart::Stats vertexCache;
+  uint32_t             lodParts                      = 0;  // parts of the draw mode with simplified levels, summed in lodTriangles
+  uint64_t             lodTriangles[PART_LOD_LEVELS] = {};
+  std::vector<double>  samples[NUM_STAGES];
+  CullReferenceResult  cullReference;
+};
+
+static bool hasSuffix(const std::string& str, const char* suffix)
+{
+  size_t len = strlen(suffix);
+  return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+static bool parseCommandLine(int argc, const char** argv, BenchmarkConfig& config)
+{
+  config.createInfo.partFixMode         = LDR_PART_FIX_NONE;
+  config.createInfo.renderpartBuildMode = LDR_RENDERPART_BUILD_ONLOAD;
+  config.createInfo.partFixTjunctions   = LDR_TRUE;
+  config.createInfo.partFixOverlap      = LDR_TRUE;
+  config.createInfo.partHiResPrimitives = LDR_FALSE;
+  config.createInfo.renderpartChamfer   = 0.2f;
+
+  const char* ldrawPath = getenv("LDRAWDIR");
+  if(ldrawPath) {
+    config.ldrawPath = std::string(ldrawPath);
+  }
+
+  for(int i = 1; i < argc; i++) {
+    std::string arg   = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+    if(arg.size() > 1 && arg[0] == '-') {
+      if(!value) {
+        fprintf(stderr, "benchmark: missing value for %s\n", argv[i]);
+        return false;
+      }
+      std::string name = arg.substr(1);
+      if(name == "benchmark")
+        config.repetitions = std::max(atoi(value), 1);
+      else if(name == "threads")
+        config.threads = uint32_t(std::max(atoi(value), 0));
+      else if(name == "json")
+        config.jsonFile = value;
+      else if(name == "ldrawpath")
+        config.ldrawPath = value;
+      else if(name == "partcosts")
+        config.partCostFile = value;
+      else if(name == "partcachefile")
+        config.partCacheFile = value;
+      else if(name == "threadedload")
+        config.settings.threadedLoad = atoi(value) != 0;
+      else if(name == "pipelinedload")
+        config.settings.pipelinedLoad = atoi(value) != 0;
+      else if(name == "partcache")
+        config.settings.partCache = atoi(value) != 0;
+      else if(name == "optimizeparts")
+        config.settings.optimizeParts = atoi(value) != 0;
+      else if(name == "partlods")
+        config.settings.partLods = atoi(value) != 0;
+      else if(name == "renderpartbuild")
+        config.createInfo.renderpartBuildMode = decltype(config.createInfo.renderpartBuildMode)(atoi(value));
+      else if(name == "renderpartchamfer")
+        config.createInfo.renderpartChamfer = float(atof(value));
+      else if(name == "partfix")
+        config.createInfo.partFixMode = decltype(config.createInfo.partFixMode)(atoi(value));
+      else if(name == "partfixtj")
+        config.createInfo.partFixTjunctions = LdrBool32(atoi(value));
+      else if(name == "partfixov")
+        config.createInfo.partFixOverlap = LdrBool32(atoi(value));
+      else if(name == "drawrenderpart")
+        config.drawRenderPart = atoi(value) != 0;
+      else if(name == "vertexmaterials")
+        config.vertexFormat.materials = atoi(value) != 0;
+      else if(name == "quantizedvertices")
+        config.vertexFormat.quantized = atoi(value) != 0;
+      else if(name == "cullreference")
+        config.cullReference = uint32_t(std::max(atoi(value), 0));
+      else {
+        fprintf(stderr, "benchmark: unknown option %s\n", argv[i]);
+        return false;
+      }
+      i++;
+    }
+    else if(hasSuffix(arg, ".ldr") || hasSuffix(arg, ".mpd")) {
+      config.models.push_back(arg);
+    }
+    else {
+      fprintf(stderr, "benchmark: unsupported file %s\n", argv[i]);
+      return false;
+    }
+  }
+
+  if(config.settings.partCache && config.partCacheFile.empty()) {
+    fprintf(stderr, "benchmark: partcache requires partcachefile\n");
+    return false;
+  }
+  if(config.models.empty()) {
+    fprintf(stderr, "benchmark: no models given\n");
+    return false;
+  }
+
+  config.createInfo.basePath = config.ldrawPath.c_str();
+  return true;
+}
+
+static void multiplyMatrix(const float a[16], const float b[16], float result[16])
+{
+  for(int c = 0; c < 4; c++) {
+    for(int r = 0; r < 4; r++) {
+      result[c * 4 + r] = 0;
+      for(int k = 0; k < 4; k++) {
+        result[c * 4 + r] += a[k * 4 + r] * b[c * 4 + k];
+      }
+    }
+  }
+}
+
+// same camera setup as the viewer, looking at the scene from -z with -y up, fit to the bounds
+static void computeFitViewProj(const LdrBbox& bbox, float aspect, float viewProj[16])
+{
+  float center[3] = {(bbox.min.x + bbox.max.x) * 0.5f, (bbox.min.y + bbox.max.y) * 0.5f, (bbox.min.z + bbox.max.z) * 0.5f};
+  float extent[3] = {bbox.max.x - bbox.min.x, bbox.max.y - bbox.min.y, bbox.max.z - bbox.min.z};
+  float radius    = std::max(std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]) * 0.5f, 1.0f);
+
+  float fov      = 45.0f * 3.14159265f / 180.0f;
+  float distance = radius / std::sin(fov * 0.5f);
+  float nearZ    = std::max(distance - radius, radius * 0.01f);
+  float farZ     = distance + radius;
+
+  // look_at(center - z * distance, center, -y)
+  float view[16] = {1, 0, 0, 0, 0, -1, 0, 0, 0, 0, -1, 0, -center[0], center[1], center[2] - distance, 1};
+
+  float f        = 1.0f / std::tan(fov * 0.5f);
+  float proj[16] = {};
+  proj[0]        = f / aspect;
+  proj[5]        = f;
+  proj[10]       = (farZ + nearZ) / (nearZ - farZ);
+  proj[11]       = -1;
+  proj[14]       = 2 * farZ * nearZ / (nearZ - farZ);
+
+  multiplyMatrix(proj, view, viewProj);
+}
+
+static void runCullReference(ThreadPool&                  pool,
+                             LdrModelHDL                  model,
+                             const std::vector<DrawPart>& drawParts,
+                             const SceneLayout&           layout,
+                             const std::vector<uint8_t>&  vertexData,
+                             const std::vector<uint8_t>&  indexData,
+                             uint32_t                     resolution,
+                             CullReferenceResult&         result)
+{
+  std::vector<LdrBbox> partBounds;
+  computePartBounds(pool, drawParts, layout.vertexSize, vertexData.data(), partBounds);
+
+  // the rasterizer reads uint32_t indices, so the triangles of each drawn part are widened once,
+  // commands index this copy instead of the index buffer's pools
+  std::vector<uint32_t> triangleIndices;
+  std::vector<uint32_t> firstTriangleIndex(drawParts.size(), ~0u);
+
+  // one command per instance with triangles, in a single range
+  std::vector<DrawIndirectCommand> commands;
+  LdrBbox                          sceneBbox = makeEmptyBbox();
+  for(uint32_t i = 0; i < model->numInstances; i++) {
+    const LdrInstance& instance = model->instances[i];
+    if(instance.part == LDR_INVALID_ID)
+      continue;
+
+    const DrawPart& drawPart = drawParts[instance.part];
+    if(!(drawPart.flags & DRAWPART_ACTIVE) || !drawPart.triangleCount)
+      continue;
+
+    float matrix[16];
+    memcpy(matrix, &instance.transform, sizeof(matrix));
+    extendBbox(sceneBbox, transformBbox(partBounds[instance.part], matrix));
+
+    if(firstTriangleIndex[instance.part] == ~0u) {
+      firstTriangleIndex[instance.part] = uint32_t(triangleIndices.size());
+      for(uint32_t t = 0; t < drawPart.triangleCount * 3; t++) {
+        uint32_t index = drawPart.triangleOffset + t;
+        if(drawPart.flags & DRAWPART_INDEX16) {
+          triangleIndices.push_back(((const uint16_t*)indexData.data())[index]);
+        }
+        else {
+          triangleIndices.push_back(((const uint32_t*)indexData.data())[index]);
+        }
+      }
+    }
+
+    commands.push_back({drawPart.triangleCount * 3, 1, firstTriangleIndex[instance.part], drawPart.vertexOffset, i});
+  }
+  if(commands.empty())
+    return;
+
+  result.width    = resolution;
+  result.height   = std::max(resolution * 9 / 16, 1u);
+  result.commands = uint32_t(commands.size());
+
+  float viewProj[16];
+  computeFitViewProj(sceneBbox, float(result.width) / float(result.height), viewProj);
+
+  auto drawCommand = [&](SoftwareRasterizer& raster, const DrawIndirectCommand& command, bool depthWrite) {
+    float matrix[16];
+    memcpy(matrix, &model->instances[command.baseInstance].transform, sizeof(matrix));
+    return raster.drawTriangles(matrix, vertexData.data() + layout.vertexSize * command.baseVertex, layout.vertexSize,
+                                triangleIndices.data() + command.firstIndex, command.count / 3, depthWrite);
+  };
+
+  double             time   = -getMicroSeconds();
+  SoftwareRasterizer raster;
+  raster.init(result.width, result.height);
+  raster.setViewProj(viewProj);
+  for(const DrawIndirectCommand& command : commands) {
+    drawCommand(raster, command, true);
+  }
+  time += getMicroSeconds();
+  result.rasterTime = time;
+
+  time = -getMicroSeconds();
+  DepthPyramid pyramid;
+  pyramid.build(raster.getDepth(), result.width, result.height);
+  time += getMicroSeconds();
+  result.pyramidTime = time;
+
+  // the complete depth buffer as pyramid, with nothing visible before, is the best case of the two pass scheme
+  Frustum frustum;
+  frustum.init(viewProj);
+
+  std::vector<DrawRange>           ranges = {{0, uint32_t(commands.size())}};
+  std::vector<uint32_t>            visibility(commands.size(), 0);
+  std::vector<DrawIndirectCommand> culledCommands;
+  std::vector<uint32_t>            counters;
+
+  time = -getMicroSeconds();
+  cullCommandsReference(CULL_OCCLUSION, frustum, viewProj, &pyramid, model, partBounds, commands, ranges, visibility,
+                        culledCommands, counters);
+  time += getMicroSeconds();
+  result.cullTime = time;
+
+  for(size_t c = 0; c < commands.size(); c++) {
+    float matrix[16];
+    memcpy(matrix, &model->instances[commands[c].baseInstance].transform, sizeof(matrix));
+    LdrBbox bbox = transformBbox(partBounds[model->instances[commands[c].baseInstance].part], matrix);
+    if(frustum.test(bbox) == FRUSTUM_OUTSIDE) {
+      result.frustumCulled++;
+      continue;
+    }
+
+    // the scene's own depth, so the visible surface passes with equal depth
+    bool hidden   = !drawCommand(raster, commands[c], false);
+    bool occluded = !visibility[c];
+    result.hidden += hidden ? 1 : 0;
+    result.occluded += occluded ? 1 : 0;
+    result.falseOccluded += occluded && !hidden ? 1 : 0;
+  }
+  result.valid = true;
+}
+
+static void runModel(ThreadPool& pool, ScenePipeline& pipeline, const BenchmarkConfig& config, BenchmarkResult& bench)
+{
+  bool renderParts = config.drawRenderPart && config.createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD;
+
+  for(uint32_t r = 0; r < config.repetitions; r++) {
+    double stages[NUM_STAGES] = {};
+    double time;
+
+    time = -getMicroSeconds();
+    if(!pipeline.resetLoader(config.createInfo, config.settings)) {
+      bench.error = "create loader failed";
+      return;
+    }
+    time += getMicroSeconds();
+    stages[STAGE_CREATE_LOADER] = time;
+
+    SceneLoadTimings timings;
+    LdrResult        result = pipeline.loadModel(bench.model, timings);
+    if(!(result == LDR_SUCCESS || result == LDR_WARNING_PART_NOT_FOUND)) {
+      bench.error = "load failed with result " + std::to_string(int(result));
+      return;
+    }
+
+    stages[STAGE_DEPENDENCY]   = timings.dependency;
+    stages[STAGE_CACHE_LOOKUP] = timings.cacheLookup;
+    stages[STAGE_SCHEDULE]     = timings.schedule;
+    stages[STAGE_LOAD]         = timings.load;
+    stages[STAGE_RESOLVE]      = timings.resolve;
+    stages[STAGE_FIX]          = timings.fix;
+    stages[STAGE_BUILD]        = timings.build;
+    stages[STAGE_RENDER_MODEL] = timings.renderModel;
+    stages[STAGE_OPTIMIZE]     = timings.optimize;
+    stages[STAGE_LODS]         = timings.lods;
+    stages[STAGE_CACHE_STORE]  = timings.cacheStore;
+
+    std::vector<DrawPart> drawParts;
+    SceneLayout           layout;
+
+    time = -getMicroSeconds();
+    pipeline.computeSceneLayout(pipeline.getModel(), renderParts, config.vertexFormat, drawParts, layout);
+    time += getMicroSeconds();
+    stages[STAGE_LAYOUT] = time;
+
+    time = -getMicroSeconds();
+    std::vector<uint8_t>       vertexData(layout.vertexSize * layout.numVertices);
+    std::vector<uint8_t>       indexData(layout.getIndexBytes());
+    std::vector<LdrMaterialID> materialData(layout.numMaterials);
+    pipeline.packSceneBuffers(drawParts, layout, renderParts, vertexData.data(), indexData.data(), materialData.data());
+    time += getMicroSeconds();
+    stages[STAGE_PACK] = time;
+
+    stages[STAGE_TOTAL] = stages[STAGE_CREATE_LOADER] + timings.total + stages[STAGE_LAYOUT] + stages[STAGE_PACK];
+
+    for(uint32_t s = 0; s < NUM_STAGES; s++) {
+      bench.samples[s].push_back(stages[s]);
+    }
+
+    // validation is not part of the timed stages, once is enough
+    if(r == 0) {
+      const std::vector<PartOptimization>& optimizations = pipeline.getPartOptimizations();
+      bench.optimizedParts                               = uint32_t(optimizations.size());
+      for(const PartOptimization& opt : optimizations) {
+        bench.vertexCache.before.add(opt.stats.before);
+        bench.vertexCache.after.add(opt.stats.after);
+        bench.vertexCache.renderBefore.add(opt.stats.renderBefore);
+        bench.vertexCache.renderAfter.add(opt.stats.renderAfter);
+      }
+
+      // a part without a level counts its previous one
+      for(const DrawPart& drawPart : drawParts) {
+        if(!drawPart.lodLevels)
+          continue;
+
+        bench.lodParts++;
+        bench.lodTriangles[0] += drawPart.triangleCount;
+        for(uint32_t l = 1; l < PART_LOD_LEVELS; l++) {
+          bench.lodTriangles[l] += drawPart.lodTriangleCount[std::min(l, drawPart.lodLevels) - 1];
+        }
+      }
+    }
+    if(config.vertexFormat.quantized && r == 0) {
+      std::vector<QuantizationError> errors;
+      pipeline.computeQuantizationErrors(drawParts, renderParts, errors);
+      for(const QuantizationError& error : errors) {
+        bench.quantizationError.position = std::max(bench.quantizationError.position, error.position);
+        bench.quantizationError.normal   = std::max(bench.quantizationError.normal, error.normal);
+      }
+    }
+    // the reference rasterizer reads float positions
+    if(config.cullReference && !config.vertexFormat.quantized && r == 0) {
+      runCullReference(pool, pipeline.getModel(), drawParts, layout, vertexData, indexData, config.cullReference,
+                       bench.cullReference);
+    }
+
+    bench.numParts     = ldrGetNumRegisteredParts(pipeline.getLoader());
+    bench.numInstances = pipeline.getModel()->numInstances;
+    bench.layout       = layout;
+
+    pipeline.unloadModel();
+  }
+}
+
+static std::string escapeJson(const std::string& str)
+{
+  std::string result;
+  for(char c : str) {
+    if(c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    }
+    else if((unsigned char)c < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned char)c);
+      result += buffer;
+    }
+    else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+static void writeJson(FILE* file, const BenchmarkConfig& config, uint32_t numWorkers, const std::vector<BenchmarkResult>& results)
+{
+  fprintf(file, "{\n");
+  fprintf(file, "  \"repetitions\": %d,\n", config.repetitions);
+  fprintf(file, "  \"threads\": %d,\n", numWorkers);
+  fprintf(file, "  \"unit\": \"ms\",\n");
+  fprintf(file, "  \"settings\": {\"threadedload\": %d, \"pipelinedload\": %d, \"partcache\": %d, \"partfix\": %d, ",
+          config.settings.threadedLoad ? 1 : 0, config.settings.pipelinedLoad ? 1 : 0, config.settings.partCache ? 1 : 0,
+          int(config.createInfo.partFixMode));
+  fprintf(file, "\"partfixtj\": %d, \"partfixov\": %d, \"renderpartbuild\": %d, \"renderpartchamfer\": %g, \"drawrenderpart\": %d, ",
+          int(config.createInfo.partFixTjunctions), int(config.createInfo.partFixOverlap),
+          int(config.createInfo.renderpartBuildMode), config.createInfo.renderpartChamfer, config.drawRenderPart ? 1 : 0);
+  fprintf(file, "\"vertexmaterials\": %d, \"quantizedvertices\": %d, \"optimizeparts\": %d, \"partlods\": %d},\n",
+          config.vertexFormat.materials ? 1 : 0, config.vertexFormat.quantized ? 1 : 0, config.settings.optimizeParts ? 1 : 0,
+          config.settings.partLods ? 1 : 0);
+  fprintf(file, "  \"models\": [\n");
+
+  for(size_t m = 0; m < results.size(); m++) {
+    const BenchmarkResult& bench = results[m];
+
+    fprintf(file, "    {\n");
+    fprintf(file, "      \"model\": \"%s\",\n", escapeJson(bench.model).c_str());
+    if(!bench.error.empty()) {
+      fprintf(file, "      \"error\": \"%s\",\n", escapeJson(bench.error).c_str());
+    }
+    fprintf(file, "      \"parts\": %d,\n", bench.numParts);
+    fprintf(file, "      \"instances\": %d,\n", bench.numInstances);
+    fprintf(file, "      \"vertices\": %d,\n", bench.layout.numVertices);
+    fprintf(file, "      \"indices\": %d,\n", bench.layout.numIndices + bench.layout.numIndices16);
+    fprintf(file, "      \"indices16\": %d,\n", bench.layout.numIndices16);
+    fprintf(file, "      \"index_bytes\": %llu,\n", (unsigned long long)bench.layout.getIndexBytes());
+    if(bench.layout.format.materials) {
+      size_t added = 0;
+      size_t saved = 0;
+      getVertexMaterialBytes(bench.layout, added, saved);
+      fprintf(file, "      \"vertex_materials\": {\"split_vertices\": %d, \"added_bytes\": %llu, \"saved_bytes\": %llu},\n",
+              bench.layout.splitVertices, (unsigned long long)added, (unsigned long long)saved);
+    }
+    if(bench.layout.format.quantized) {
+      fprintf(file, "      \"quantization\": {\"vertex_bytes\": %llu, \"max_position_error\": %g, \"max_normal_error_deg\": %g},\n",
+              (unsigned long long)(bench.layout.vertexSize * bench.layout.numVertices), bench.quantizationError.position,
+              bench.quantizationError.normal);
+    }
+    if(bench.optimizedParts) {
+      const OptimizedPart::Stats& vc = bench.vertexCache;
+      fprintf(file, "      \"vertex_cache\": {\"fifo\": %d, \"parts\": %d, ", VERTEX_CACHE_SIZE, bench.optimizedParts);
+      fprintf(file, "\"acmr\": [%.4f, %.4f], \"atvr\": [%.4f, %.4f], ", vc.before.getAcmr(), vc.after.getAcmr(), vc.before.getAtvr(),
+              vc.after.getAtvr());
+      fprintf(file, "\"render_acmr\": [%.4f, %.4f], \"render_atvr\": [%.4f, %.4f]},\n", vc.renderBefore.getAcmr(),
+              vc.renderAfter.getAcmr(), vc.renderBefore.getAtvr(), vc.renderAfter.getAtvr());
+    }
+    if(bench.lodParts) {
+      fprintf(file, "      \"lods\": {\"parts\": %d, \"triangles\": [%llu, %llu, %llu, %llu]},\n", bench.lodParts,
+              (unsigned long long)bench.lodTriangles[0], (unsigned long long)bench.lodTriangles[1],
+              (unsigned long long)bench.lodTriangles[2], (unsigned long long)bench.lodTriangles[3]);
+    }
+    fprintf(file, "      \"stages\": {");
+
+    bool valid = !bench.samples[0].empty();
+    for(uint32_t s = 0; s < NUM_STAGES && valid; s++) {
+      std::vector<double> samples = bench.samples[s];
+      std::sort(samples.begin(), samples.end());
+
+      size_t n      = samples.size();
+      double median = (n % 2) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) * 0.5;
+      // nearest rank
+      size_t p95 = std::min(size_t(std::ceil(double(n) * 0.95)), n) - 1;
+
+      fprintf(file, "%s\n        \"%s\": {\"min\": %.3f, \"median\": %.3f, \"p95\": %.3f}", s ? "," : "", s_stageNames[s],
+              samples[0] / 1000.0, median / 1000.0, samples[p95] / 1000.0);
+    }
+    fprintf(file, valid ? "\n      }" : "}");
+
+    const CullReferenceResult& cull = bench.cullReference;
+    if(cull.valid) {
+      fprintf(file, ",\n      \"cull_reference\": {\"width\": %d, \"height\": %d, \"commands\": %d, \"frustum_culled\": %d, ", cull.width,
+              cull.height, cull.commands, cull.frustumCulled);
+      fprintf(file, "\"hidden\": %d, \"occluded\": %d, \"false_occluded\": %d, ", cull.hidden, cull.occluded, cull.falseOccluded);
+      fprintf(file, "\"raster\": %.3f, \"pyramid\": %.3f, \"cull\": %.3f}", cull.rasterTime / 1000.0, cull.pyramidTime / 1000.0,
+              cull.cullTime / 1000.0);
+    }
+    fprintf(file, "\n");
+    fprintf(file, "    }%s\n", m + 1 < results.size() ? "," : "");
+  }
+
+  fprintf(file, "  ]\n");
+  fprintf(file, "}\n");
+}
+
+bool isBenchmarkCommandLine(int argc, const char** argv)
+{
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "-benchmark") == 0)
+      return true;
+  }
+  return false;
+}
+
+int runBenchmark(int argc, const char** argv)
+{
+  BenchmarkConfig config;
+  if(!parseCommandLine(argc, argv, config))
+    return EXIT_FAILURE;
+
+  uint32_t numThreads = config.threads ? config.threads : std::max(std::thread::hardware_concurrency(), 1u);
+
+  ThreadPool threadPool;
+  threadPool.init(numThreads);
+  uint32_t numWorkers = std::max(threadPool.getNumWorkers(), 1u);
+
+  // only the json goes to stdout
+  ScenePipeline pipeline;
+  pipeline.setVerbose(false);
+  pipeline.init(&threadPool, config.ldrawPath, config.partCostFile, config.partCacheFile);
+
+  std::vector<BenchmarkResult> results(config.models.size());
+
+  bool success = true;
+  for(size_t m = 0; m < config.models.size(); m++) {
+    results[m].model = config.models[m];
+    fprintf(stderr, "benchmark: %s (%d repetitions)\n", config.models[m].c_str(), config.repetitions);
+
+    runModel(threadPool, pipeline, config, results[m]);
+    if(!results[m].error.empty()) {
+      fprintf(stderr, "benchmark: %s %s\n", config.models[m].c_str(), results[m].error.c_str());
+      success = false;
+    }
+    // the json is still written, but a regression of the occlusion culling fails the run
+    if(results[m].cullReference.falseOccluded) {
+      fprintf(stderr, "benchmark: %s %d commands falsely occluded\n", config.models[m].c_str(), results[m].cullReference.falseOccluded);
+      success = false;
+    }
+  }
+
+  pipeline.deinit();
+  threadPool.deinit();
+
+  FILE* file = stdout;
+  if(!config.jsonFile.empty()) {
+    file = fopen(config.jsonFile.c_str(), "wt");
+    if(!file) {
+      fprintf(stderr, "benchmark: could not open %s\n", config.jsonFile.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  writeJson(file, config, numWorkers, results);
+
+  if(file != stdout) {
+    fclose(file);
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+}  // namespace ldrawviewer
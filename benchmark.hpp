@@ -0,0 +1,38 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#pragma once
+
+namespace ldrawviewer {
+
+// Headless benchmark, runs the load pipeline for a list of models without
+// creating a window or OpenGL context and reports min/median/p95 per stage as JSON.
+//
+//   ldrawloader_viewer -benchmark <repetitions> [-json <file>] [-threads <n>] [loader options] <model.ldr|.mpd> ...
+//
+// Loader options use the same names as the viewer's parameters
+// (ldrawpath, threadedload, pipelinedload, partcache, optimizeparts, partlods, partfix, vertexmaterials, quantizedvertices, ...).
+// With optimizeparts the json reports ACMR and ATVR before and after, as [before, after] pairs.
+// With partlods it reports the triangles of the parts with simplified levels, summed per level.
+// -cullreference <width> additionally validates hi-z occlusion culling on the CPU (float vertices only)
+// against a software rasterized depth buffer of the whole model, any falsely occluded command fails the run.
+bool isBenchmarkCommandLine(int argc, const char** argv);
+int  runBenchmark(int argc, const char** argv);
+
+}  // namespace ldrawviewer
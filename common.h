@@ -19,19 +19,51 @@
 
 #define UNI_COLORMUL         0
 #define UNI_LIGHTING         1
-#define UNI_MATERIALID       2
-#define UNI_MATERIALIDOFFSET 3
+#define UNI_PARTMATERIALS    3
+#define UNI_CULLRANGE        4
+#define UNI_CULLPLANES       5
+#define UNI_PYRAMIDPARAMS    11
+#define UNI_CULLSTATS        12
+#define UNI_QUANTIZED        13
 
 
 #define VERTEX_POS           0
 #define VERTEX_NORMAL        1
 #define VERTEX_UV            2
+#define VERTEX_MATERIALID    3
 
 #define UBO_SCENE            0
-#define UBO_OBJECT           1
 
 #define SSBO_MATERIALS       0
 #define SSBO_MATERIALIDS     1
+#define SSBO_INSTANCES       2
+#define SSBO_PARTMATERIALS   3
+#define SSBO_PARTBOUNDS      4
+#define SSBO_CULLCOMMANDS    5
+#define SSBO_CULLOUTPUT      6
+#define SSBO_CULLCOUNTERS    7
+#define SSBO_CULLVISIBILITY  8
+#define SSBO_PARTLODS        9
+
+#define TEX_SCENEDEPTH       0
+#define TEX_DEPTHPYRAMID     1
+
+#define IMG_DEPTHPYRAMID     0
+
+#define INSTANCE_ACTIVE      1
+
+#define CULL_WORKGROUP_SIZE  256
+#define PYRAMID_WORKGROUP_SIZE 16
+
+// cullRange.w, same values as CullMode in culling.hpp
+#define CULLMODE_FRUSTUM     0
+#define CULLMODE_LASTVISIBLE 1
+#define CULLMODE_OCCLUSION   2
+#define CULLMODE_MASK        3
+// count tested and occluded instances into the stats counters
+#define CULLFLAG_STATS       4
+// replace triangle ranges by the part level selected for the instance
+#define CULLFLAG_LOD         8
 
 #if defined(GL_core_profile) || defined(GL_compatibility_profile) || defined(GL_es_profile)
 
@@ -60,18 +92,41 @@ struct ViewData
   float opacity;
 
   uint useObjectColor;
+  // pixels per world unit at distance 1, and the projected error a level may have
+  float lodScale;
+  float lodPixelError;
 };
 
-struct ObjectData
+struct MaterialData
 {
-  mat4 worldMatrix;
-  mat4 worldMatrixIT;
   vec4 color;
 };
 
-struct MaterialData
+// local bounds of the geometry uploaded for a part
+struct PartBounds
 {
-  vec4 color;
+  vec4 bboxMin;
+  vec4 bboxMax;
+};
+
+// simplified levels 1..3 of a part, zero counts past the last one
+struct PartLods
+{
+  uvec4 counts;   // indices
+  uvec4 offsets;  // firstIndex
+  vec4  errors;
+};
+
+// built once per model, indexed by gl_BaseInstanceARB + gl_InstanceID
+struct InstanceData
+{
+  mat4  worldMatrix;
+  mat4  worldMatrixIT;
+  vec4  color;
+  uint  materialID;
+  uint  part;
+  float winding;  // sign of the world matrix determinant
+  uint  flags;
 };
 
 #ifdef __cplusplus
@@ -85,11 +140,6 @@ layout(std140, binding = UBO_SCENE) uniform sceneBuffer
   ViewData view;
 };
 
-layout(std140, binding = UBO_OBJECT) uniform objectBuffer
-{
-  ObjectData object;
-};
-
 layout(std430, binding = SSBO_MATERIALS) buffer materialBuffer
 {
   MaterialData materials[];
@@ -100,4 +150,56 @@ layout(std430, binding = SSBO_MATERIALIDS) buffer materialIdBuffer
   uint materialIndices[];
 };
 
+layout(std430, binding = SSBO_INSTANCES) buffer instanceBuffer
+{
+  InstanceData instances[];
+};
+
+// per part offset into materialIndices, ~0 if the part has no per-triangle materials
+layout(std430, binding = SSBO_PARTMATERIALS) buffer partMaterialBuffer
+{
+  uint partMaterialOffsets[];
+};
+
+layout(std430, binding = SSBO_PARTBOUNDS) buffer partBoundsBuffer
+{
+  PartBounds partBounds[];
+};
+
+// same layout as the GL indirect command, baseInstance is the instance index
+struct DrawIndirectCommand
+{
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  uint baseVertex;
+  uint baseInstance;
+};
+
+layout(std430, binding = SSBO_CULLCOMMANDS) buffer cullCommandBuffer
+{
+  DrawIndirectCommand cullCommands[];
+};
+
+layout(std430, binding = SSBO_CULLOUTPUT) buffer cullOutputBuffer
+{
+  DrawIndirectCommand cullOutput[];
+};
+
+layout(std430, binding = SSBO_CULLCOUNTERS) buffer cullCounterBuffer
+{
+  uint cullCounters[];
+};
+
+layout(std430, binding = SSBO_PARTLODS) buffer partLodBuffer
+{
+  PartLods partLods[];
+};
+
+// per command, non-zero if it passed the occlusion test last frame
+layout(std430, binding = SSBO_CULLVISIBILITY) buffer cullVisibilityBuffer
+{
+  uint cullVisibility[];
+};
+
 #endif
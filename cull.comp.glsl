@@ -0,0 +1,169 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#version 430
+/**/
+
+#extension GL_ARB_shading_language_include : enable
+#include "common.h"
+
+layout(local_size_x = CULL_WORKGROUP_SIZE) in;
+
+// x: first command of the range, y: commands in the range, z: counter of the range, w: CULLMODE and CULLFLAG bits
+layout(location = UNI_CULLRANGE)  uniform uvec4 cullRange;
+// inward facing, normalized
+layout(location = UNI_CULLPLANES) uniform vec4  cullPlanes[6];
+// x: counter of frustum visible instances, y: counter of occluded ones
+layout(location = UNI_CULLSTATS)  uniform uvec2 statsCounters;
+
+layout(binding = TEX_DEPTHPYRAMID) uniform sampler2D depthPyramid;
+
+// mirrors transformBbox in culling.cpp
+void getWorldBbox(vec3 bboxMin, vec3 bboxMax, mat4 worldMatrix, out vec3 wMin, out vec3 wMax)
+{
+  vec3 center = (worldMatrix * vec4((bboxMin + bboxMax) * 0.5, 1)).xyz;
+  vec3 extent = mat3(abs(worldMatrix[0].xyz), abs(worldMatrix[1].xyz), abs(worldMatrix[2].xyz)) * ((bboxMax - bboxMin) * 0.5);
+
+  wMin = center - extent;
+  wMax = center + extent;
+}
+
+// mirrors Frustum::test in culling.cpp
+bool isInFrustum(vec3 wMin, vec3 wMax)
+{
+  for(int p = 0; p < 6; p++) {
+    vec4 plane    = cullPlanes[p];
+    vec3 farthest = mix(wMin, wMax, greaterThan(plane.xyz, vec3(0)));
+    if(dot(plane.xyz, farthest) + plane.w < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// mirrors DepthPyramid::isOccluded in culling.cpp
+bool isOccluded(vec3 wMin, vec3 wMax)
+{
+  vec3 ndcMin = vec3(3.402823e38);
+  vec3 ndcMax = vec3(-3.402823e38);
+  for(int c = 0; c < 8; c++) {
+    vec3 corner = vec3((c & 1) != 0 ? wMax.x : wMin.x, (c & 2) != 0 ? wMax.y : wMin.y, (c & 4) != 0 ? wMax.z : wMin.z);
+    vec4 clip   = view.viewProjMatrix * vec4(corner, 1);
+    // crosses the camera plane
+    if(clip.w <= 0) {
+      return false;
+    }
+    ndcMin = min(ndcMin, clip.xyz / clip.w);
+    ndcMax = max(ndcMax, clip.xyz / clip.w);
+  }
+
+  vec2  viewport = vec2(textureSize(depthPyramid, 0));
+  vec2  pxMin    = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0) * viewport;
+  vec2  pxMax    = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0) * viewport;
+  float depthMin = ndcMin.z * 0.5 + 0.5;
+
+  // the level where the rectangle covers at most 2x2 texels
+  float size      = max(max(pxMax.x - pxMin.x, pxMax.y - pxMin.y), 1.0);
+  int   level     = clamp(int(ceil(log2(size))), 0, textureQueryLevels(depthPyramid) - 1);
+  ivec2 levelMax  = textureSize(depthPyramid, level) - 1;
+  ivec2 texelMin  = min(ivec2(uvec2(pxMin) >> level), levelMax);
+  ivec2 texelMax  = min(ivec2(uvec2(pxMax) >> level), levelMax);
+
+  float depthMax = 0;
+  for(int y = texelMin.y; y <= texelMax.y; y++) {
+    for(int x = texelMin.x; x <= texelMax.x; x++) {
+      depthMax = max(depthMax, texelFetch(depthPyramid, ivec2(x, y), level).r);
+    }
+  }
+
+  return depthMin > depthMax;
+}
+
+// mirrors Sample::selectLod in ldraw_viewer.cpp, the last level whose error stays below view.lodPixelError
+uint selectLod(uint part, mat4 worldMatrix)
+{
+  vec3  bboxMin = partBounds[part].bboxMin.xyz;
+  vec3  bboxMax = partBounds[part].bboxMax.xyz;
+  float scale   = max(max(length(worldMatrix[0].xyz), length(worldMatrix[1].xyz)), length(worldMatrix[2].xyz));
+  vec3  center  = (worldMatrix * vec4((bboxMin + bboxMax) * 0.5, 1)).xyz;
+  float radius  = length(bboxMax - bboxMin) * 0.5 * scale;
+  float dist    = max(length(center - view.viewMatrixI[3].xyz) - radius, 1e-4);
+  float pixels  = scale * view.lodScale / dist;
+
+  uint level = 0;
+  for(uint l = 0; l < 3; l++) {
+    if(partLods[part].counts[l] == 0 || partLods[part].errors[l] * pixels > view.lodPixelError) {
+      break;
+    }
+    level = l + 1;
+  }
+  return level;
+}
+
+void main()
+{
+  uint idx = gl_GlobalInvocationID.x;
+  if(idx >= cullRange.y) {
+    return;
+  }
+
+  uint                index   = cullRange.x + idx;
+  uint                mode    = cullRange.w & CULLMODE_MASK;
+  DrawIndirectCommand command = cullCommands[index];
+  uint                part    = instances[command.baseInstance].part;
+
+  vec3 wMin;
+  vec3 wMax;
+  getWorldBbox(partBounds[part].bboxMin.xyz, partBounds[part].bboxMax.xyz, instances[command.baseInstance].worldMatrix, wMin, wMax);
+
+  bool visible = isInFrustum(wMin, wMax);
+  bool emit    = visible;
+  if(mode == CULLMODE_LASTVISIBLE) {
+    emit = visible && cullVisibility[index] != 0;
+  }
+  else if(mode == CULLMODE_OCCLUSION) {
+    bool wasVisible = cullVisibility[index] != 0;
+    bool occluded   = visible && isOccluded(wMin, wMax);
+    if(visible && (cullRange.w & CULLFLAG_STATS) != 0) {
+      atomicAdd(cullCounters[statsCounters.x], 1);
+      if(occluded) {
+        atomicAdd(cullCounters[statsCounters.y], 1);
+      }
+    }
+
+    visible               = visible && !occluded;
+    cullVisibility[index] = visible ? 1 : 0;
+    // whatever was visible last frame has been drawn already
+    emit = visible && !wasVisible;
+  }
+
+  if(emit && (cullRange.w & CULLFLAG_LOD) != 0) {
+    uint level = selectLod(part, instances[command.baseInstance].worldMatrix);
+    if(level != 0) {
+      command.count      = partLods[part].counts[level - 1];
+      command.firstIndex = partLods[part].offsets[level - 1];
+    }
+  }
+
+  if(emit) {
+    uint slot                      = atomicAdd(cullCounters[cullRange.z], 1);
+    cullOutput[cullRange.x + slot] = command;
+  }
+}
@@ -0,0 +1,531 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace ldrawviewer {
+
+LdrBbox makeEmptyBbox()
+{
+  LdrBbox bbox;
+  bbox.min = {FLT_MAX, FLT_MAX, FLT_MAX};
+  bbox.max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  return bbox;
+}
+
+bool isEmptyBbox(const LdrBbox& bbox)
+{
+  return bbox.min.x > bbox.max.x || bbox.min.y > bbox.max.y || bbox.min.z > bbox.max.z;
+}
+
+void extendBbox(LdrBbox& bbox, const LdrBbox& other)
+{
+  bbox.min.x = std::min(bbox.min.x, other.min.x);
+  bbox.min.y = std::min(bbox.min.y, other.min.y);
+  bbox.min.z = std::min(bbox.min.z, other.min.z);
+  bbox.max.x = std::max(bbox.max.x, other.max.x);
+  bbox.max.y = std::max(bbox.max.y, other.max.y);
+  bbox.max.z = std::max(bbox.max.z, other.max.z);
+}
+
+LdrBbox computeVertexBbox(const void* vertices, size_t vertexSize, uint32_t numVertices)
+{
+  LdrBbox        bbox = makeEmptyBbox();
+  const uint8_t* data = (const uint8_t*)vertices;
+  for(uint32_t v = 0; v < numVertices; v++) {
+    LdrVector pos;
+    memcpy(&pos, data + vertexSize * v, sizeof(LdrVector));
+    extendBbox(bbox, {pos, pos});
+  }
+  return bbox;
+}
+
+LdrBbox transformBbox(const LdrBbox& bbox, const float matrix[16])
+{
+  if(isEmptyBbox(bbox))
+    return bbox;
+
+  float center[3] = {(bbox.min.x + bbox.max.x) * 0.5f, (bbox.min.y + bbox.max.y) * 0.5f, (bbox.min.z + bbox.max.z) * 0.5f};
+  float extent[3] = {(bbox.max.x - bbox.min.x) * 0.5f, (bbox.max.y - bbox.min.y) * 0.5f, (bbox.max.z - bbox.min.z) * 0.5f};
+
+  // transformed center plus the extent projected onto the absolute matrix
+  float outCenter[3];
+  float outExtent[3];
+  for(int r = 0; r < 3; r++) {
+    outCenter[r] = matrix[12 + r];
+    outExtent[r] = 0;
+    for(int c = 0; c < 3; c++) {
+      outCenter[r] += matrix[c * 4 + r] * center[c];
+      outExtent[r] += std::abs(matrix[c * 4 + r]) * extent[c];
+    }
+  }
+
+  LdrBbox result;
+  result.min = {outCenter[0] - outExtent[0], outCenter[1] - outExtent[1], outCenter[2] - outExtent[2]};
+  result.max = {outCenter[0] + outExtent[0], outCenter[1] + outExtent[1], outCenter[2] + outExtent[2]};
+  return result;
+}
+
+void computePartBounds(ThreadPool&                  pool,
+                       const std::vector<DrawPart>& drawParts,
+                       size_t                       vertexSize,
+                       const void*                  vertices,
+                       std::vector<LdrBbox>&        bounds)
+{
+  bounds.resize(drawParts.size());
+  pool.parallelItems(uint32_t(drawParts.size()), [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+      const DrawPart& drawPart = drawParts[i];
+      if(drawPart.flags & DRAWPART_ACTIVE) {
+        bounds[i] = computeVertexBbox((const uint8_t*)vertices + vertexSize * drawPart.vertexOffset, vertexSize, drawPart.vertexCount);
+      }
+      else {
+        bounds[i] = makeEmptyBbox();
+      }
+    }
+  });
+}
+
+void Frustum::init(const float viewProj[16])
+{
+  // rows of the column-major matrix
+  float rows[4][4];
+  for(int r = 0; r < 4; r++) {
+    for(int c = 0; c < 4; c++) {
+      rows[r][c] = viewProj[c * 4 + r];
+    }
+  }
+
+  for(int p = 0; p < 6; p++) {
+    int   axis = p / 2;
+    float sign = (p & 1) ? -1.0f : 1.0f;
+    float len  = 0;
+    for(int c = 0; c < 4; c++) {
+      planes[p][c] = rows[3][c] + sign * rows[axis][c];
+    }
+    len = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+    if(len > 0) {
+      for(int c = 0; c < 4; c++) {
+        planes[p][c] /= len;
+      }
+    }
+  }
+}
+
+FrustumResult Frustum::test(const LdrBbox& bbox) const
+{
+  FrustumResult result = FRUSTUM_INSIDE;
+  for(int p = 0; p < 6; p++) {
+    const float* plane = planes[p];
+
+    // corner furthest along the plane normal, and the one opposite to it
+    float farthest = plane[3] + plane[0] * (plane[0] > 0 ? bbox.max.x : bbox.min.x)
+                     + plane[1] * (plane[1] > 0 ? bbox.max.y : bbox.min.y) + plane[2] * (plane[2] > 0 ? bbox.max.z : bbox.min.z);
+    if(farthest < 0)
+      return FRUSTUM_OUTSIDE;
+
+    float nearest = plane[3] + plane[0] * (plane[0] > 0 ? bbox.min.x : bbox.max.x)
+                    + plane[1] * (plane[1] > 0 ? bbox.min.y : bbox.max.y) + plane[2] * (plane[2] > 0 ? bbox.min.z : bbox.max.z);
+    if(nearest < 0)
+      result = FRUSTUM_INTERSECT;
+  }
+  return result;
+}
+
+bool Frustum::testSphere(const float center[3], float radius) const
+{
+  for(int p = 0; p < 6; p++) {
+    const float* plane = planes[p];
+    if(plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius)
+      return false;
+  }
+  return true;
+}
+
+void DepthPyramid::build(const float* depth, uint32_t width, uint32_t height)
+{
+  m_levels.clear();
+  m_levels.push_back({width, height, std::vector<float>(depth, depth + size_t(width) * height)});
+
+  while(m_levels.back().width > 1 || m_levels.back().height > 1) {
+    const Level& src = m_levels.back();
+    Level        dst;
+    dst.width  = std::max(src.width / 2, 1u);
+    dst.height = std::max(src.height / 2, 1u);
+    dst.depth.resize(size_t(dst.width) * dst.height);
+
+    for(uint32_t y = 0; y < dst.height; y++) {
+      for(uint32_t x = 0; x < dst.width; x++) {
+        uint32_t srcMaxX = std::min(x * 2 + 1 + (x == dst.width - 1 ? (src.width & 1) : 0), src.width - 1);
+        uint32_t srcMaxY = std::min(y * 2 + 1 + (y == dst.height - 1 ? (src.height & 1) : 0), src.height - 1);
+
+        float value = 0;
+        for(uint32_t sy = y * 2; sy <= srcMaxY; sy++) {
+          for(uint32_t sx = x * 2; sx <= srcMaxX; sx++) {
+            value = std::max(value, src.depth[sy * src.width + sx]);
+          }
+        }
+        dst.depth[y * dst.width + x] = value;
+      }
+    }
+    m_levels.push_back(std::move(dst));
+  }
+}
+
+static void transformPoint(const float matrix[16], const float pos[3], float clip[4])
+{
+  for(int r = 0; r < 4; r++) {
+    clip[r] = matrix[r] * pos[0] + matrix[4 + r] * pos[1] + matrix[8 + r] * pos[2] + matrix[12 + r];
+  }
+}
+
+bool DepthPyramid::isOccluded(const float viewProj[16], const LdrBbox& bbox) const
+{
+  if(m_levels.empty())
+    return false;
+
+  float ndcMin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float ndcMax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for(int c = 0; c < 8; c++) {
+    float corner[3] = {(c & 1) ? bbox.max.x : bbox.min.x, (c & 2) ? bbox.max.y : bbox.min.y, (c & 4) ? bbox.max.z : bbox.min.z};
+    float clip[4];
+    transformPoint(viewProj, corner, clip);
+    // crosses the camera plane
+    if(clip[3] <= 0)
+      return false;
+
+    for(int i = 0; i < 3; i++) {
+      ndcMin[i] = std::min(ndcMin[i], clip[i] / clip[3]);
+      ndcMax[i] = std::max(ndcMax[i], clip[i] / clip[3]);
+    }
+  }
+
+  float viewport[2] = {float(m_levels[0].width), float(m_levels[0].height)};
+  float pxMin[2];
+  float pxMax[2];
+  for(int i = 0; i < 2; i++) {
+    pxMin[i] = std::min(std::max(ndcMin[i] * 0.5f + 0.5f, 0.0f), 1.0f) * viewport[i];
+    pxMax[i] = std::min(std::max(ndcMax[i] * 0.5f + 0.5f, 0.0f), 1.0f) * viewport[i];
+  }
+  float depthMin = ndcMin[2] * 0.5f + 0.5f;
+
+  // the level where the rectangle covers at most 2x2 texels
+  float    size  = std::max(std::max(pxMax[0] - pxMin[0], pxMax[1] - pxMin[1]), 1.0f);
+  int      level = std::min(std::max(int(std::ceil(std::log2(size))), 0), int(m_levels.size()) - 1);
+  uint32_t maxX  = m_levels[level].width - 1;
+  uint32_t maxY  = m_levels[level].height - 1;
+
+  uint32_t tMinX = std::min(uint32_t(pxMin[0]) >> level, maxX);
+  uint32_t tMinY = std::min(uint32_t(pxMin[1]) >> level, maxY);
+  uint32_t tMaxX = std::min(uint32_t(pxMax[0]) >> level, maxX);
+  uint32_t tMaxY = std::min(uint32_t(pxMax[1]) >> level, maxY);
+
+  float depthMax = 0;
+  for(uint32_t y = tMinY; y <= tMaxY; y++) {
+    for(uint32_t x = tMinX; x <= tMaxX; x++) {
+      depthMax = std::max(depthMax, getDepth(level, x, y));
+    }
+  }
+
+  return depthMin > depthMax;
+}
+
+void SoftwareRasterizer::init(uint32_t width, uint32_t height)
+{
+  m_width  = width;
+  m_height = height;
+  m_depth.assign(size_t(width) * height, 1.0f);
+}
+
+void SoftwareRasterizer::setViewProj(const float viewProj[16])
+{
+  memcpy(m_viewProj, viewProj, sizeof(m_viewProj));
+}
+
+bool SoftwareRasterizer::drawTriangles(const float     worldMatrix[16],
+                                       const void*     vertices,
+                                       size_t          vertexSize,
+                                       const uint32_t* indices,
+                                       uint32_t        numTriangles,
+                                       bool            depthWrite,
+                                       float           depthBias)
+{
+  float matrix[16];
+  for(int c = 0; c < 4; c++) {
+    for(int r = 0; r < 4; r++) {
+      matrix[c * 4 + r] = 0;
+      for(int k = 0; k < 4; k++) {
+        matrix[c * 4 + r] += m_viewProj[k * 4 + r] * worldMatrix[c * 4 + k];
+      }
+    }
+  }
+
+  bool passed = false;
+  for(uint32_t t = 0; t < numTriangles; t++) {
+    float screen[3][3];
+    bool  clipped = false;
+    for(int v = 0; v < 3; v++) {
+      LdrVector pos;
+      memcpy(&pos, (const uint8_t*)vertices + vertexSize * indices[t * 3 + v], sizeof(LdrVector));
+
+      float clip[4];
+      transformPoint(matrix, &pos.x, clip);
+      if(clip[3] <= 0) {
+        clipped = true;
+        break;
+      }
+      screen[v][0] = (clip[0] / clip[3] * 0.5f + 0.5f) * float(m_width);
+      screen[v][1] = (clip[1] / clip[3] * 0.5f + 0.5f) * float(m_height);
+      screen[v][2] = clip[2] / clip[3] * 0.5f + 0.5f;
+    }
+    if(clipped) {
+      passed = true;
+      continue;
+    }
+
+    float area = (screen[1][0] - screen[0][0]) * (screen[2][1] - screen[0][1])
+                 - (screen[2][0] - screen[0][0]) * (screen[1][1] - screen[0][1]);
+    if(area == 0)
+      continue;
+
+    float minX = std::min(std::min(screen[0][0], screen[1][0]), screen[2][0]);
+    float maxX = std::max(std::max(screen[0][0], screen[1][0]), screen[2][0]);
+    float minY = std::min(std::min(screen[0][1], screen[1][1]), screen[2][1]);
+    float maxY = std::max(std::max(screen[0][1], screen[1][1]), screen[2][1]);
+
+    int x0 = std::max(int(std::floor(minX)), 0);
+    int x1 = std::min(int(std::ceil(maxX)), int(m_width) - 1);
+    int y0 = std::max(int(std::floor(minY)), 0);
+    int y1 = std::min(int(std::ceil(maxY)), int(m_height) - 1);
+
+    for(int y = y0; y <= y1; y++) {
+      for(int x = x0; x <= x1; x++) {
+        float px = float(x) + 0.5f;
+        float py = float(y) + 0.5f;
+
+        // barycentrics, either winding
+        float w0 = ((screen[1][0] - px) * (screen[2][1] - py) - (screen[2][0] - px) * (screen[1][1] - py)) / area;
+        float w1 = ((screen[2][0] - px) * (screen[0][1] - py) - (screen[0][0] - px) * (screen[2][1] - py)) / area;
+        float w2 = 1.0f - w0 - w1;
+        if(w0 < 0 || w1 < 0 || w2 < 0)
+          continue;
+
+        float  z     = w0 * screen[0][2] + w1 * screen[1][2] + w2 * screen[2][2];
+        float& depth = m_depth[size_t(y) * m_width + x];
+        if(z < 0 || z > 1)
+          continue;
+
+        if(depthWrite && z < depth) {
+          depth  = z;
+          passed = true;
+        }
+        else if(!depthWrite && z <= depth + depthBias) {
+          passed = true;
+        }
+      }
+    }
+  }
+  return passed;
+}
+
+void cullCommandsReference(CullMode                                mode,
+                           const Frustum&                          frustum,
+                           const float                             viewProj[16],
+                           const DepthPyramid*                     pyramid,
+                           LdrModelHDL                             model,
+                           const std::vector<LdrBbox>&             partBounds,
+                           const std::vector<DrawIndirectCommand>& commands,
+                           const std::vector<DrawRange>&           ranges,
+                           std::vector<uint32_t>&                  visibility,
+                           std::vector<DrawIndirectCommand>&       culledCommands,
+                           std::vector<uint32_t>&                  counters)
+{
+  culledCommands.assign(commands.size(), DrawIndirectCommand{});
+  counters.assign(ranges.size(), 0);
+  visibility.resize(commands.size(), 0);
+
+  // one shader invocation per command, a dispatch per range
+  for(size_t r = 0; r < ranges.size(); r++) {
+    for(uint32_t c = 0; c < ranges[r].count; c++) {
+      uint32_t                   index    = ranges[r].offset + c;
+      const DrawIndirectCommand& command  = commands[index];
+      const LdrInstance&         instance = model->instances[command.baseInstance];
+
+      float matrix[16];
+      memcpy(matrix, &instance.transform, sizeof(matrix));
+      LdrBbox bbox = transformBbox(partBounds[instance.part], matrix);
+
+      bool visible = frustum.test(bbox) != FRUSTUM_OUTSIDE;
+      bool emit    = visible;
+      if(mode == CULL_LASTVISIBLE) {
+        emit = visible && visibility[index];
+      }
+      else if(mode == CULL_OCCLUSION) {
+        bool wasVisible   = visibility[index] != 0;
+        visible           = visible && !pyramid->isOccluded(viewProj, bbox);
+        visibility[index] = visible ? 1 : 0;
+        emit              = visible && !wasVisible;
+      }
+
+      if(emit) {
+        culledCommands[ranges[r].offset + counters[r]++] = command;
+      }
+    }
+  }
+}
+
+void InstanceBvh::clear()
+{
+  m_nodes.clear();
+  m_items.clear();
+  m_instanceBounds.clear();
+  m_numInstances = 0;
+}
+
+void InstanceBvh::build(ThreadPool& pool, LdrModelHDL model, const std::vector<LdrBbox>& partBounds)
+{
+  clear();
+
+  m_numInstances = model->numInstances;
+  m_instanceBounds.resize(model->numInstances);
+
+  pool.parallelItems(model->numInstances, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+      const LdrInstance& instance = model->instances[i];
+      if(instance.part == LDR_INVALID_ID || instance.part >= partBounds.size()) {
+        m_instanceBounds[i] = makeEmptyBbox();
+      }
+      else {
+        float matrix[16];
+        memcpy(matrix, &instance.transform, sizeof(matrix));
+        m_instanceBounds[i] = transformBbox(partBounds[instance.part], matrix);
+      }
+    }
+  });
+
+  for(uint32_t i = 0; i < model->numInstances; i++) {
+    if(!isEmptyBbox(m_instanceBounds[i])) {
+      m_items.push_back(i);
+    }
+  }
+  if(m_items.empty())
+    return;
+
+  std::vector<LdrVector> centers(model->numInstances);
+  for(uint32_t i : m_items) {
+    const LdrBbox& bbox = m_instanceBounds[i];
+    centers[i]          = {bbox.min.x + bbox.max.x, bbox.min.y + bbox.max.y, bbox.min.z + bbox.max.z};
+  }
+
+  // median split along the widest axis of the centers, top-down
+  m_nodes.reserve(2 * (m_items.size() / LEAF_SIZE + 1));
+  m_nodes.push_back({makeEmptyBbox(), 0, uint32_t(m_items.size()), 0});
+
+  std::vector<uint32_t> stack;
+  stack.push_back(0);
+  while(!stack.empty()) {
+    uint32_t nodeIdx = stack.back();
+    stack.pop_back();
+
+    uint32_t itemOffset = m_nodes[nodeIdx].itemOffset;
+    uint32_t itemCount  = m_nodes[nodeIdx].itemCount;
+
+    LdrBbox bbox         = makeEmptyBbox();
+    LdrBbox centerBounds = makeEmptyBbox();
+    for(uint32_t t = itemOffset; t < itemOffset + itemCount; t++) {
+      const LdrVector& center = centers[m_items[t]];
+      extendBbox(bbox, m_instanceBounds[m_items[t]]);
+      extendBbox(centerBounds, {center, center});
+    }
+    m_nodes[nodeIdx].bbox = bbox;
+
+    if(itemCount <= LEAF_SIZE)
+      continue;
+
+    float extent[3] = {centerBounds.max.x - centerBounds.min.x, centerBounds.max.y - centerBounds.min.y,
+                       centerBounds.max.z - centerBounds.min.z};
+    int   axis      = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+
+    uint32_t* items = m_items.data() + itemOffset;
+    uint32_t  half  = itemCount / 2;
+    std::nth_element(items, items + half, items + itemCount, [&](uint32_t a, uint32_t b) {
+      return (&centers[a].x)[axis] < (&centers[b].x)[axis];
+    });
+
+    uint32_t child         = uint32_t(m_nodes.size());
+    m_nodes[nodeIdx].child = child;
+    m_nodes.push_back({makeEmptyBbox(), itemOffset, half, 0});
+    m_nodes.push_back({makeEmptyBbox(), itemOffset + half, itemCount - half, 0});
+    stack.push_back(child);
+    stack.push_back(child + 1);
+  }
+}
+
+void InstanceBvh::cullFrustum(const Frustum& frustum, std::vector<uint8_t>& visible, CullStats& stats) const
+{
+  double time = -getMicroSeconds();
+
+  visible.assign(m_numInstances, 0);
+  stats = CullStats();
+
+  uint32_t numVisible = 0;
+  if(!m_nodes.empty()) {
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while(stackSize) {
+      const Node& node = m_nodes[stack[--stackSize]];
+      stats.nodesVisited++;
+
+      FrustumResult result = frustum.test(node.bbox);
+      if(result == FRUSTUM_OUTSIDE)
+        continue;
+
+      // fully inside accepts the whole subtree, leaves test their instances
+      if(result == FRUSTUM_INSIDE || !node.child) {
+        for(uint32_t t = node.itemOffset; t < node.itemOffset + node.itemCount; t++) {
+          uint32_t i = m_items[t];
+          if(result == FRUSTUM_INSIDE || frustum.test(m_instanceBounds[i]) != FRUSTUM_OUTSIDE) {
+            visible[i] = 1;
+            numVisible++;
+          }
+        }
+        continue;
+      }
+
+      stack[stackSize++] = node.child;
+      stack[stackSize++] = node.child + 1;
+    }
+  }
+
+  stats.visible = numVisible;
+  stats.culled  = uint32_t(m_items.size()) - numVisible;
+
+  time += getMicroSeconds();
+  stats.time = time;
+}
+
+}  // namespace ldrawviewer
@@ -0,0 +1,205 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "external/ldrawloader/src/ldrawloader.h"
+
+#include "scenepipeline.hpp"
+#include "threadpool.hpp"
+
+namespace ldrawviewer {
+
+// inverted (min > max) when nothing was added
+LdrBbox makeEmptyBbox();
+bool    isEmptyBbox(const LdrBbox& bbox);
+void    extendBbox(LdrBbox& bbox, const LdrBbox& other);
+// position must be the first member of the vertex, vertices are vertexSize bytes apart
+LdrBbox computeVertexBbox(const void* vertices, size_t vertexSize, uint32_t numVertices);
+// matrix is column-major like LdrMatrix
+LdrBbox transformBbox(const LdrBbox& bbox, const float matrix[16]);
+
+// part bounds from a packed scene vertex buffer, e.g. a scene blob, inactive parts stay empty
+void computePartBounds(ThreadPool&                  pool,
+                       const std::vector<DrawPart>& drawParts,
+                       size_t                       vertexSize,
+                       const void*                  vertices,
+                       std::vector<LdrBbox>&        bounds);
+
+enum FrustumResult
+{
+  FRUSTUM_OUTSIDE,
+  FRUSTUM_INTERSECT,
+  FRUSTUM_INSIDE,
+};
+
+struct Frustum
+{
+  // normals point inwards, GL clip space of a column-major viewProj matrix
+  float planes[6][4];
+
+  void          init(const float viewProj[16]);
+  FrustumResult test(const LdrBbox& bbox) const;
+  // false if the sphere is completely outside
+  bool testSphere(const float center[3], float radius) const;
+};
+
+// matches the GL indirect command layout and DrawIndirectCommand in common.h
+struct DrawIndirectCommand
+{
+  uint32_t count;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  uint32_t baseVertex;
+  uint32_t baseInstance;  // instance index
+};
+
+struct DrawRange
+{
+  uint32_t offset = 0;
+  uint32_t count  = 0;
+};
+
+// Max depth per texel of the level below, level 0 is the depth buffer itself.
+// Depth is in [0,1] like the GL depth buffer, odd sizes fold the last row/column into the last texel.
+class DepthPyramid
+{
+public:
+  void build(const float* depth, uint32_t width, uint32_t height);
+
+  uint32_t getNumLevels() const { return uint32_t(m_levels.size()); }
+  uint32_t getWidth(uint32_t level) const { return m_levels[level].width; }
+  uint32_t getHeight(uint32_t level) const { return m_levels[level].height; }
+  float    getDepth(uint32_t level, uint32_t x, uint32_t y) const { return m_levels[level].depth[y * m_levels[level].width + x]; }
+
+  // mirrors isOccluded in cull.comp.glsl, bbox in world space
+  bool isOccluded(const float viewProj[16], const LdrBbox& bbox) const;
+
+private:
+  struct Level
+  {
+    uint32_t           width;
+    uint32_t           height;
+    std::vector<float> depth;
+  };
+  std::vector<Level> m_levels;
+};
+
+// Depth-only reference rasterizer: pixel centers, no culling of back faces,
+// triangles touching the camera plane are never occluders and always count as visible.
+class SoftwareRasterizer
+{
+public:
+  void init(uint32_t width, uint32_t height);
+  void setViewProj(const float viewProj[16]);
+
+  // returns true if any fragment passes the depth test, the buffer is only written with depthWrite
+  bool drawTriangles(const float     worldMatrix[16],
+                     const void*     vertices,
+                     size_t          vertexSize,
+                     const uint32_t* indices,
+                     uint32_t        numTriangles,
+                     bool            depthWrite,
+                     float           depthBias = 0);
+
+  uint32_t     getWidth() const { return m_width; }
+  uint32_t     getHeight() const { return m_height; }
+  const float* getDepth() const { return m_depth.data(); }
+
+private:
+  uint32_t           m_width  = 0;
+  uint32_t           m_height = 0;
+  float              m_viewProj[16];
+  std::vector<float> m_depth;
+};
+
+// values match the CULLMODE defines of the shaders
+enum CullMode
+{
+  CULL_FRUSTUM = 0,
+  // commands visible last frame, drawn first to fill the depth buffer
+  CULL_LASTVISIBLE = 1,
+  // hi-z test against the pyramid, updates visibility and emits what the last-visible pass missed
+  CULL_OCCLUSION = 2,
+};
+
+// CPU version of cull.comp.glsl. Commands of each range that pass are compacted to the
+// front of the same range in culledCommands, counters get the survivors per range.
+// visibility holds one entry per command and is only used by the occlusion modes,
+// pyramid is required for CULL_OCCLUSION.
+// The GPU writes survivors in arbitrary order, here input order is kept.
+void cullCommandsReference(CullMode                                mode,
+                           const Frustum&                          frustum,
+                           const float                             viewProj[16],
+                           const DepthPyramid*                     pyramid,
+                           LdrModelHDL                             model,
+                           const std::vector<LdrBbox>&             partBounds,
+                           const std::vector<DrawIndirectCommand>& commands,
+                           const std::vector<DrawRange>&           ranges,
+                           std::vector<uint32_t>&                  visibility,
+                           std::vector<DrawIndirectCommand>&       culledCommands,
+                           std::vector<uint32_t>&                  counters);
+
+struct CullStats
+{
+  uint32_t visible      = 0;
+  uint32_t culled       = 0;
+  uint32_t nodesVisited = 0;
+  double   time         = 0;  // microseconds
+};
+
+// Bounding volume hierarchy over world-space instance bounds,
+// built once per model and traversed every frame.
+class InstanceBvh
+{
+public:
+  // instances of invalid or empty parts are left out and never visible
+  void build(ThreadPool& pool, LdrModelHDL model, const std::vector<LdrBbox>& partBounds);
+  void clear();
+
+  uint32_t getNumNodes() const { return uint32_t(m_nodes.size()); }
+  uint32_t getNumInstances() const { return m_numInstances; }
+
+  const std::vector<LdrBbox>& getInstanceBounds() const { return m_instanceBounds; }
+
+  // visible is resized to the model's instance count, 1 for instances overlapping the frustum
+  void cullFrustum(const Frustum& frustum, std::vector<uint8_t>& visible, CullStats& stats) const;
+
+private:
+  static const uint32_t LEAF_SIZE = 4;
+
+  struct Node
+  {
+    LdrBbox  bbox;
+    uint32_t itemOffset;
+    uint32_t itemCount;
+    uint32_t child;  // first of two adjacent children, 0 for leaves
+  };
+
+  std::vector<Node>     m_nodes;
+  std::vector<uint32_t> m_items;  // instance indices, every node covers a contiguous range
+  std::vector<LdrBbox>  m_instanceBounds;
+  uint32_t              m_numInstances = 0;
+};
+
+}  // namespace ldrawviewer
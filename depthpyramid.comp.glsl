@@ -0,0 +1,67 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+
+#version 430
+/**/
+
+#extension GL_ARB_shading_language_include : enable
+#include "common.h"
+
+layout(local_size_x = PYRAMID_WORKGROUP_SIZE, local_size_y = PYRAMID_WORKGROUP_SIZE) in;
+
+// x: level that is written, y: samples of the scene depth
+layout(location = UNI_PYRAMIDPARAMS) uniform ivec2 pyramidParams;
+
+layout(binding = TEX_SCENEDEPTH)   uniform sampler2DMS sceneDepth;
+layout(binding = TEX_DEPTHPYRAMID) uniform sampler2D   depthPyramid;
+
+layout(binding = IMG_DEPTHPYRAMID, r32f) uniform writeonly image2D pyramidLevel;
+
+// mirrors DepthPyramid::build in culling.cpp, level 0 takes the farthest sample
+void main()
+{
+  ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size  = imageSize(pyramidLevel);
+  if(any(greaterThanEqual(coord, size))) {
+    return;
+  }
+
+  int   level = pyramidParams.x;
+  float depth = 0;
+  if(level == 0) {
+    for(int s = 0; s < pyramidParams.y; s++) {
+      depth = max(depth, texelFetch(sceneDepth, coord, s).r);
+    }
+  }
+  else {
+    // odd sizes fold the last row/column into the last texel
+    ivec2 srcSize = textureSize(depthPyramid, level - 1);
+    ivec2 srcMin  = coord * 2;
+    ivec2 srcMax  = min(srcMin + 1 + ivec2(equal(coord, size - 1)) * (srcSize & 1), srcSize - 1);
+    for(int y = srcMin.y; y <= srcMax.y; y++) {
+      for(int x = srcMin.x; x <= srcMax.x; x++) {
+        depth = max(depth, texelFetch(depthPyramid, ivec2(x, y), level - 1).r);
+      }
+    }
+  }
+
+  imageStore(pyramidLevel, coord, vec4(depth));
+}
@@ -38,28 +38,44 @@
 
 #include "external/ldrawloader/src/ldrawloader.h"
 
+#include <algorithm>
+#include <cassert>
+#include <functional>
 #include <thread>
 
+#include "benchmark.hpp"
 #include "common.h"
+#include "culling.hpp"
+#include "sceneblob.hpp"
+#include "scenepipeline.hpp"
+#include "threadpool.hpp"
 
 namespace ldrawviewer {
 int const SAMPLE_SIZE_WIDTH(1024);
 int const SAMPLE_SIZE_HEIGHT(1024);
 int const SAMPLE_MAJOR_VERSION(4);
 int const SAMPLE_MINOR_VERSION(5);
+int const SAMPLE_MSAA(8);
 
+static GLenum getIndexType(const DrawPart& drawPart)
+{
+  return (drawPart.flags & DRAWPART_INDEX16) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
 
 class Sample : public nvgl::AppWindowProfilerGL
 {
   struct
   {
     nvgl::ProgramID draw_scene;
+    nvgl::ProgramID cull_commands;
+    nvgl::ProgramID depth_pyramid;
   } programs;
 
   struct
   {
     GLuint scene_color        = 0;
     GLuint scene_depthstencil = 0;
+    GLuint depth_pyramid      = 0;
   } textures;
 
   struct
@@ -67,75 +83,273 @@ class Sample : public nvgl::AppWindowProfilerGL
     GLuint scene = 0;
   } fbos;
 
-  struct GLMultiDrawIndirect
+  enum Renderer
+  {
+    RENDERER_CLASSIC,
+    RENDERER_MDI,
+    RENDERER_INSTANCED,
+    RENDERER_MESHLETS,
+    NUM_RENDERERS,
+  };
+
+  // triangle draws are bucketed by the state that cannot change within one multi draw
+  enum DrawStateBucket
+  {
+    BUCKET_CULL_CCW,
+    BUCKET_CULL_CW,
+    BUCKET_NOCULL_CCW,
+    BUCKET_NOCULL_CW,
+    NUM_BUCKETS,
+  };
+
+  // triangle buckets, then edges and optional lines, one counter each when culled on the gpu
+  enum CullRange
+  {
+    CULLRANGE_EDGES    = NUM_BUCKETS,
+    CULLRANGE_OPTIONAL = NUM_BUCKETS + 1,
+    NUM_CULLRANGES,
+  };
+
+  // every range exists once per index type, a multi draw has a single one
+  enum IndexType
+  {
+    INDEXTYPE_32,
+    INDEXTYPE_16,
+    NUM_INDEXTYPES,
+  };
+
+  // counters of the last-visible (or frustum) pass, of the occlusion pass, then occlusion stats,
+  // the counter of a range within a pass is indexType * NUM_CULLRANGES + range
+  enum CullCounter
+  {
+    CULLCOUNTER_OCCLUSION = NUM_CULLRANGES * NUM_INDEXTYPES,
+    CULLCOUNTER_TESTED    = NUM_CULLRANGES * NUM_INDEXTYPES * 2,
+    CULLCOUNTER_OCCLUDED,
+    NUM_CULLCOUNTERS,
+  };
+
+  struct MultiDraw
+  {
+    GLuint    indirectBuffer = 0;
+    DrawRange ranges[NUM_INDEXTYPES][NUM_CULLRANGES];
+    bool      dirty = true;
+
+    // compacted copy of indirectBuffer and the survivors per range, written by the cull shader
+    GLuint culledBuffer  = 0;
+    GLuint counterBuffer = 0;
+    // occlusion culling: commands the occlusion pass adds, and visibility per command for the next frame
+    GLuint remainderBuffer  = 0;
+    GLuint visibilityBuffer = 0;
+
+    // instances of the inspected part, highlighted with individual draws
+    std::vector<uint32_t> highlights;
+  };
+
+  // classic renderer: sort key per drawn instance, state bits first so equal state forms runs
+  static const uint64_t DRAWKEY_NOCULL     = 1ull << 63;
+  static const uint64_t DRAWKEY_CW         = 1ull << 62;
+  static const uint64_t DRAWKEY_MATERIALS  = 1ull << 61;
+  static const uint32_t DRAWKEY_PART_SHIFT = 32;
+
+  struct DrawBatch
   {
-    uint32_t count;
-    uint32_t instanceCount;
-    uint32_t firstIndex;
-    uint32_t baseVertex;
-    uint32_t baseInstance;
+    uint64_t key;
+    uint32_t part;
+    uint32_t firstInstance;
+    uint32_t numInstances;
+    uint32_t lod;
   };
 
-  struct DrawPart
+  struct DrawList
   {
-    uint32_t vertexCount;
-    uint32_t vertexOffset;
-    uint32_t triangleCount;
-    uint32_t triangleOffset;
-    uint32_t triangleCountC;
-    uint32_t triangleOffsetC;
-    uint32_t edgesCount;
-    uint32_t edgesOffset;
-    uint32_t optionalCount;
-    uint32_t optionalOffset;
-    uint32_t materialIDOffset;
-    uint32_t materialIDOffsetC;
+    // lower 32 bits are the instance index
+    std::vector<uint64_t> keys;
+    // classic: one batch per instance, indexing the instance table
+    std::vector<DrawBatch> single;
+    // instanced: one batch per part and state, indexing instanceBuffer
+    std::vector<DrawBatch> instanced;
+    GLuint                 instanceBuffer = 0;
+    bool                   dirty          = true;
   };
 
   struct Common
   {
     GLuint vao             = 0;
     GLuint viewBuffer      = 0;
-    GLuint objectBuffer    = 0;
     GLuint materialsBuffer = 0;
   };
 
-  struct Scene
+  // everything that depends on the draw mode, raw parts or render parts
+  struct SceneGeometry
   {
-    LdrModelHDL       model       = nullptr;
-    LdrRenderModelHDL renderModel = nullptr;
-
     GLuint                vertexBuffer        = 0;
     GLuint                indexBuffer         = 0;
     GLuint                materialIndexBuffer = 0;
+    SceneLayout           layout;
     std::vector<DrawPart> drawParts;
+    // per active part, only with quantized vertices and not for blobs, largest position error first
+    std::vector<QuantizationError> quantizationErrors;
+    std::vector<PartMemory>        partMemory;
+
+    // referenced by the DrawPart meshlet ranges
+    std::vector<Meshlet> meshlets;
+
+    // local bounds per part and a hierarchy over the world bounds of all instances
+    std::vector<LdrBbox> partBounds;
+    GLuint               partBoundsBuffer = 0;
+    InstanceBvh          bvh;
+
+    bool renderParts = false;
+
+    size_t getBufferBytes() const
+    {
+      return layout.vertexSize * layout.numVertices + layout.getIndexBytes() + sizeof(LdrMaterialID) * layout.numMaterials;
+    }
+  };
+
+  // the base holds the geometry of the current draw mode
+  struct Scene : SceneGeometry
+  {
+    LdrModelHDL       model       = nullptr;
+    LdrRenderModelHDL renderModel = nullptr;
+
+    // with residentGeometry the other draw mode, swapped in when drawRenderPart is toggled
+    SceneGeometry resident;
+    bool          hasResident = false;
+
+    // built once per model, transforms never change afterwards
+    std::vector<glsldata::InstanceData> instances;
+    GLuint                              instanceBuffer = 0;
+    // material-ID offset per part for the current draw mode
+    GLuint partMaterialBuffer = 0;
+
+    DrawList  drawList;
+    MultiDraw multiDraw;
+
+    // stats cover the parts of the current draw mode
+    MeshletStats meshletStats;
+    // rebuilt every frame from the meshlets that survive culling, never gpu culled
+    MultiDraw    meshletDraw;
+    uint32_t     meshletCommandCapacity = 0;
+
+    std::vector<uint8_t> visible;
+
+    // per part levels for the cull shader, hasLods if any part of the draw mode has one
+    GLuint partLodsBuffer = 0;
+    bool   hasLods        = false;
+
+    // when opened from a scene blob, model points to blobModel
+    SceneBlob                blob;
+    LdrModel                 blobModel;
+    std::vector<LdrInstance> blobInstances;
   };
 
   struct Tweak
   {
     nvmath::vec3 lightDir;
-    nvmath::vec4 inheritColor   = {1, 1, 0, 1};
-    bool         cull           = true;
-    bool         drawRenderPart = false;
-    bool         edges          = false;
-    bool         triangles      = true;
-    bool         chamfered      = false;
-    bool         wireframe      = true;
-    bool         optional       = false;
-    bool         colors         = true;
-    float        transparency   = 0;
-    int          instance       = -1;
-    int          part           = -1;
-    int          tri            = -1;
-    int          vertex         = -1;
-    int          edge           = -1;
-    bool         threadedLoad   = false;
+    nvmath::vec4 inheritColor     = {1, 1, 0, 1};
+    bool         cull             = true;
+    bool         drawRenderPart   = false;
+    bool         edges            = false;
+    bool         triangles        = true;
+    bool         chamfered        = false;
+    bool         wireframe        = true;
+    bool         optional         = false;
+    bool         colors           = true;
+    float        transparency     = 0;
+    int          instance         = -1;
+    int          part             = -1;
+    int          tri              = -1;
+    int          vertex           = -1;
+    int          edge             = -1;
+    bool         threadedLoad     = false;
+    bool         pipelinedLoad    = false;
+    bool         partCache        = false;
+    int          renderer         = RENDERER_CLASSIC;
+    bool         frustumCull      = true;
+    bool         occlusionCull    = false;
+    bool         vertexMaterials  = false;
+    bool         quantized        = false;
+    bool         optimizeParts    = false;
+    bool         meshletConeCull  = true;
+    bool         partLods         = false;
+    bool         lods             = true;
+    float        lodPixelError    = 1.0f;
+    bool         residentGeometry = false;
   };
 
   nvgl::ProgramManager m_progManager;
 
   ImGuiH::Registry m_ui;
   double           m_uiTime;
+  double           m_drawTime = 0;
+  // per frame, state changes are cull, front face and part material toggles
+  uint32_t m_drawCalls     = 0;
+  uint32_t m_drawInstances = 0;
+  uint32_t m_stateChanges  = 0;
+  uint64_t m_drawState     = 0;
+
+  CullStats m_cullStats;
+
+  struct MeshletCullStats
+  {
+    uint32_t tested        = 0;
+    uint32_t frustumCulled = 0;
+    uint32_t coneCulled    = 0;
+    uint32_t commands      = 0;  // after merging adjacent visible meshlets
+    double   time          = 0;
+  };
+  MeshletCullStats m_meshletCullStats;
+
+  // cpu renderers only, the cull shader picks levels without reporting them
+  struct LodStats
+  {
+    uint32_t instances[PART_LOD_LEVELS] = {};
+    uint64_t triangles                  = 0;
+    uint64_t fullTriangles              = 0;  // without lods
+
+    void add(const LodStats& other)
+    {
+      for(uint32_t l = 0; l < PART_LOD_LEVELS; l++) {
+        instances[l] += other.instances[l];
+      }
+      triangles += other.triangles;
+      fullTriangles += other.fullTriangles;
+    }
+  };
+  LodStats m_lodStats;
+
+  // per worker, kept across frames so the vectors keep their capacity
+  struct MeshletCullOutput
+  {
+    std::vector<DrawIndirectCommand> ranges[NUM_INDEXTYPES][NUM_CULLRANGES];
+    std::vector<uint32_t>            highlights;
+    MeshletCullStats                 stats;
+    LodStats                         lods;
+  };
+  std::vector<MeshletCullOutput>   m_meshletCullOutputs;
+  std::vector<DrawIndirectCommand> m_meshletCommands;
+
+  // occlusion stats are copied here by the gpu and read a frame later, without waiting
+  GLuint          m_occlusionStatsBuffer = 0;
+  const uint32_t* m_occlusionStats       = nullptr;
+  GLuint          m_pyramidQuery         = 0;
+  bool            m_pyramidQueryPending  = false;
+  double          m_pyramidTime          = 0;
+
+  // reused by every upload of the scene, the fence guards the copies out of it.
+  // The query times the copies on the gpu, its result is reported once available.
+  struct UploadStaging
+  {
+    GLuint   buffer       = 0;
+    size_t   size         = 0;
+    uint8_t* mapping      = nullptr;
+    GLsync   fence        = nullptr;
+    GLuint   query        = 0;
+    bool     queryPending = false;
+    size_t   copyBytes    = 0;
+  };
+  UploadStaging m_uploadStaging;
 
   Tweak m_tweak;
   Tweak m_tweakLast;
@@ -144,7 +358,6 @@ class Sample : public nvgl::AppWindowProfilerGL
 
   LdrLoaderCreateInfo m_loaderCreateInfo;
   LdrLoaderCreateInfo m_loaderCreateInfoLast;
-  LdrLoaderHDL        m_loader = nullptr;
 
   glsldata::ViewData m_viewUbo;
 
@@ -152,11 +365,18 @@ class Sample : public nvgl::AppWindowProfilerGL
   Common      m_common;
   std::string m_ldrawPath;
   std::string m_modelFilename;
+  std::string m_blobFilename;
 
   nvh::CameraControl m_control;
 
+  ThreadPool    m_threadPool;
+  ScenePipeline m_pipeline;
+  std::string   m_partCostFile;
+  std::string   m_partCacheFile;
+
   bool begin() override;
   void processUI(double time);
+  void processPartMemoryUI();
   void think(double time) override;
   void resize(int width, int height) override;
 
@@ -165,12 +385,59 @@ class Sample : public nvgl::AppWindowProfilerGL
   bool initScene();
   void deinitScene();
 
-  bool resetLoader();
-  bool resetScene();
+  SceneLoadSettings getLoadSettings() const;
+  bool              resetLoader();
+  bool              resetScene();
+  bool              updateScene();
 
   void rebuildSceneBuffers();
-  void drawDebug();
-
+  void buildSceneGeometry(bool renderParts);
+  bool updateChamferedParts(const std::vector<LdrPartID>& partIds);
+  bool updateSceneParts(const std::vector<LdrPartID>& partIds);
+  void swapResidentGeometry();
+  void deleteSceneGeometry(SceneGeometry& geometry);
+  void applyDrawMode();
+  void buildInstanceTable();
+  void buildPartMaterials();
+  void buildPartLods();
+
+  typedef std::function<void(uint8_t* vertices, uint8_t* indices, LdrMaterialID* materials)> SceneFillFunction;
+
+  void     uploadSceneBuffers(const SceneLayout& layout, const SceneFillFunction& fill);
+  uint8_t* mapUploadStaging(size_t size);
+  void     releaseUploadStaging();
+  void     reportUploadCopy();
+
+  void beginDraw(GLuint program);
+  void endDraw();
+  void applyDrawState(uint64_t key, uint64_t mask);
+  void getTriangleRange(const DrawPart& drawPart, uint32_t lod, uint32_t& offset, uint32_t& count) const;
+  void drawDebug(bool instanced);
+  void buildDrawList();
+  void buildDrawBatches(const uint8_t* visible);
+  void buildCullData();
+  void cullScene();
+
+  bool     useLods() const;
+  uint32_t selectLod(uint32_t instance) const;
+
+  bool useGpuCulling() const;
+  void cullMultiDraw(CullMode mode);
+  void drawMultiDraw(const MultiDraw& multiDraw, int culledPass, bool highlights);
+  bool useOcclusionCulling() const;
+  void buildDepthPyramid();
+  void drawOcclusionCulled();
+  void buildMultiDraw();
+  void buildMeshletStats();
+  void cullMeshlets();
+
+  SceneBlobOptions  getSceneBlobOptions() const;
+  SceneVertexFormat getVertexFormat() const;
+  void              reportQuantizationErrors();
+  void              reportPartOptimizations();
+  void              reportPartLods();
+  bool              bakeSceneBlob(const std::string& filename);
+  bool              openSceneBlob(const std::string& filename);
 
   void end() override;
 
@@ -204,16 +471,33 @@ public:
 
     m_parameterList.addFilename(".ldr", &m_modelFilename);
     m_parameterList.addFilename(".mpd", &m_modelFilename);
+    m_parameterList.addFilename(".ldrblob", &m_blobFilename);
     m_parameterList.add("threadedload", &m_tweak.threadedLoad);
+    m_parameterList.add("pipelinedload", &m_tweak.pipelinedLoad);
+    m_parameterList.add("partcache", &m_tweak.partCache);
+    m_parameterList.add("partcachefile", &m_partCacheFile);
+    m_parameterList.add("optimizeparts", &m_tweak.optimizeParts);
+    m_parameterList.add("partlods", &m_tweak.partLods);
     m_parameterList.add("renderpartbuild", (int*)&m_loaderCreateInfo.renderpartBuildMode);
     m_parameterList.add("renderpartchamfer", &m_loaderCreateInfo.renderpartChamfer);
     m_parameterList.add("partfix", (int*)&m_loaderCreateInfo.partFixMode);
     m_parameterList.add("partfixtj", (int*)&m_loaderCreateInfo.partFixTjunctions);
     m_parameterList.add("partfixov", (int*)&m_loaderCreateInfo.partFixOverlap);
     m_parameterList.add("drawrenderpart", &m_tweak.drawRenderPart);
+    m_parameterList.add("residentgeometry", &m_tweak.residentGeometry);
     m_parameterList.add("chamfered", &m_tweak.chamfered);
+    m_parameterList.add("renderer", &m_tweak.renderer);
+    m_parameterList.add("frustumcull", &m_tweak.frustumCull);
+    m_parameterList.add("occlusioncull", &m_tweak.occlusionCull);
+    m_parameterList.add("meshletconecull", &m_tweak.meshletConeCull);
+    m_parameterList.add("lods", &m_tweak.lods);
+    m_parameterList.add("lodpixelerror", &m_tweak.lodPixelError);
+    m_parameterList.add("vertexmaterials", &m_tweak.vertexMaterials);
+    m_parameterList.add("quantizedvertices", &m_tweak.quantized);
 
     m_parameterList.add("ldrawpath", &m_ldrawPath);
+    // the cost history is only persisted when a file is given
+    m_parameterList.add("partcosts", &m_partCostFile);
 
     const char* ldrawPath = getenv("LDRAWDIR");
     if(ldrawPath) {
@@ -233,6 +517,8 @@ bool Sample::initProgram()
 
   programs.draw_scene = m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, "scene.vert.glsl"),
                                                     nvgl::ProgramManager::Definition(GL_FRAGMENT_SHADER, "scene.frag.glsl"));
+  programs.cull_commands = m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, "cull.comp.glsl"));
+  programs.depth_pyramid = m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, "depthpyramid.comp.glsl"));
 
 
   validated = m_progManager.areProgramsValid();
@@ -243,10 +529,20 @@ bool Sample::initProgram()
 bool Sample::initFramebuffers(int width, int height)
 {
   nvgl::newTexture(textures.scene_color, GL_TEXTURE_2D_MULTISAMPLE);
-  glTextureStorage2DMultisample(textures.scene_color, 8, GL_RGBA8, width, height, GL_FALSE);
+  glTextureStorage2DMultisample(textures.scene_color, SAMPLE_MSAA, GL_RGBA8, width, height, GL_FALSE);
 
   nvgl::newTexture(textures.scene_depthstencil, GL_TEXTURE_2D_MULTISAMPLE);
-  glTextureStorage2DMultisample(textures.scene_depthstencil, 8, GL_DEPTH24_STENCIL8, width, height, GL_FALSE);
+  glTextureStorage2DMultisample(textures.scene_depthstencil, SAMPLE_MSAA, GL_DEPTH24_STENCIL8, width, height, GL_FALSE);
+
+  // full mip chain down to 1x1, max depth per texel
+  int levels = 1;
+  while((std::max(width, height) >> levels) > 0) {
+    levels++;
+  }
+  nvgl::newTexture(textures.depth_pyramid, GL_TEXTURE_2D);
+  glTextureStorage2D(textures.depth_pyramid, levels, GL_R32F, width, height);
+  glTextureParameteri(textures.depth_pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+  glTextureParameteri(textures.depth_pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
   nvgl::newFramebuffer(fbos.scene);
   glBindFramebuffer(GL_FRAMEBUFFER, fbos.scene);
@@ -259,128 +555,159 @@ bool Sample::initFramebuffers(int width, int height)
 
 bool Sample::initScene()
 {
+  if(!m_blobFilename.empty()) {
+    if(openSceneBlob(m_blobFilename)) {
+      buildInstanceTable();
+      return true;
+    }
+    // fall back to loading the model the blob was baked from
+  }
+
   if(m_modelFilename.empty())
     return true;
 
-  double timeLoadAll;
-  double time;
+  SceneLoadTimings timings;
+  LdrResult        result = m_pipeline.loadModel(m_modelFilename, timings);
 
-  timeLoadAll = -m_profiler.getMicroSeconds();
+  m_scene.model       = m_pipeline.getModel();
+  m_scene.renderModel = m_pipeline.getRenderModel();
 
-  LdrResult result;
-  if(m_tweak.threadedLoad) {
-    time   = -m_profiler.getMicroSeconds();
-    result = ldrCreateModel(m_loader, m_modelFilename.c_str(), LDR_FALSE, &m_scene.model);
-    assert(result == LDR_SUCCESS || result == LDR_WARNING_PART_NOT_FOUND);
-    time += m_profiler.getMicroSeconds();
-    printf("dependency time %.2f ms\n", time / 1000.0f);
+  if(m_scene.model) {
+    buildInstanceTable();
+    reportPartOptimizations();
+    reportPartLods();
+  }
 
-    if(!(result == LDR_SUCCESS || result == LDR_WARNING_PART_NOT_FOUND))
-      return false;
+  return (result == LDR_SUCCESS || result == LDR_WARNING_PART_NOT_FOUND);
+}
 
-    // threaded loaded
-    time = -m_profiler.getMicroSeconds();
-
-    uint32_t numParts   = ldrGetNumRegisteredParts(m_loader);
-    uint32_t numThreads = std::thread::hardware_concurrency();
-    uint32_t perThread  = (numParts + numThreads - 1) / numThreads;
-
-    std::vector<LdrPartID> partIds(numParts);
-    std::vector<LdrResult> errors(numThreads);
-
-    std::vector<std::thread> threads(numThreads);
-    for(uint32_t i = 0; i < numThreads; i++) {
-      threads[i] = std::thread(
-          [&](uint32_t idx) {
-            uint32_t offset   = idx * perThread;
-            uint32_t numLocal = offset > numParts ? 0 : std::min(perThread, numParts - idx * perThread);
-            if(numLocal) {
-              for(uint32_t p = 0; p < numLocal; p++) {
-                partIds[offset + p] = (LdrPartID)(offset + p);
-              }
-              errors[idx] = ldrLoadDeferredParts(m_loader, numLocal, &partIds[offset], sizeof(LdrPartID));
-            }
-          },
-          i);
-    }
-    for(uint32_t i = 0; i < numThreads; i++) {
-      threads[i].join();
-      if(!(errors[i] == LDR_SUCCESS || errors[i] == LDR_WARNING_PART_NOT_FOUND)) {
-        assert(0);
-        return false;
-      }
-    }
-    ldrResolveModel(m_loader, m_scene.model);
+void Sample::buildInstanceTable()
+{
+  double time = -m_profiler.getMicroSeconds();
 
-    time += m_profiler.getMicroSeconds();
-    printf("threaded time %.2f ms\n", time / 1000.0f);
-  }
-  else {
-    time   = -m_profiler.getMicroSeconds();
-    result = ldrCreateModel(m_loader, m_modelFilename.c_str(), LDR_TRUE, &m_scene.model);
-    assert(result == LDR_SUCCESS || result == LDR_WARNING_PART_NOT_FOUND);
-    time += m_profiler.getMicroSeconds();
-    printf("load time %.2f ms\n", time / 1000.0f);
+  LdrModelHDL                          model     = m_scene.model;
+  std::vector<glsldata::InstanceData>& instances = m_scene.instances;
+  instances.resize(model->numInstances);
 
-    if(!(result == LDR_SUCCESS || result == LDR_WARNING_PART_NOT_FOUND))
-      return false;
+  // colors are sequential to stay stable, the matrix work is spread over the pool
+  srand(1123);
+  for(uint32_t i = 0; i < model->numInstances; i++) {
+    instances[i].color = {nvh::frand(), nvh::frand(), nvh::frand(), 1.0f};
   }
 
-  timeLoadAll += m_profiler.getMicroSeconds();
-  printf("total load time %.2f ms\n", timeLoadAll / 1000.0f);
+  m_threadPool.parallelItems(model->numInstances, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+      const LdrInstance*      instance = &model->instances[i];
+      glsldata::InstanceData& obj      = instances[i];
+
+      memcpy(obj.worldMatrix.mat_array, &instance->transform, sizeof(LdrMatrix));
+      obj.worldMatrixIT = nvmath::transpose(nvmath::invert(obj.worldMatrix));
+      obj.winding       = nvmath::det(obj.worldMatrix) > 0 ? 1.0f : -1.0f;
+      obj.materialID    = instance->material;
+      obj.part          = instance->part;
+      obj.flags         = instance->part != LDR_INVALID_ID ? INSTANCE_ACTIVE : 0;
+    }
+  });
 
-  time = -m_profiler.getMicroSeconds();
-  //ldrFixParts(m_loader, ~0, nullptr, 0);
-  time += m_profiler.getMicroSeconds();
-  printf("fix time %.2f ms\n", time / 1000.0f);
+  nvgl::newBuffer(m_scene.instanceBuffer);
+  if(!instances.empty()) {
+    glNamedBufferStorage(m_scene.instanceBuffer, sizeof(glsldata::InstanceData) * instances.size(), instances.data(), 0);
+  }
 
-  time = -m_profiler.getMicroSeconds();
-  //ldrBuildRenderParts(m_loader, ~0, nullptr, 0);
   time += m_profiler.getMicroSeconds();
+  printf("instance table %.2f ms (%d instances)\n", time / 1000.0f, model->numInstances);
+}
 
-  if(m_loaderCreateInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD) {
-    result = ldrCreateRenderModel(m_loader, m_scene.model, LDR_TRUE, &m_scene.renderModel);
-    assert(result == LDR_SUCCESS || result == LDR_WARNING_PART_NOT_FOUND);
-  }
+void Sample::buildPartMaterials()
+{
+  std::vector<uint32_t> offsets(std::max(m_scene.drawParts.size(), size_t(1)), ~0u);
+  for(size_t i = 0; i < m_scene.drawParts.size(); i++) {
+    const DrawPart& drawPart   = m_scene.drawParts[i];
+    bool            useChamfer = m_tweak.drawRenderPart && m_tweak.chamfered && (drawPart.flags & DRAWPART_CAN_CHAMFER);
 
-  printf("build time %.2f ms\n", time / 1000.0f);
+    if(drawPart.flags & (useChamfer ? DRAWPART_MATERIALS_C : DRAWPART_MATERIALS)) {
+      offsets[i] = useChamfer ? drawPart.materialIDOffsetC : drawPart.materialIDOffset;
+    }
+  }
 
-  return (result == LDR_SUCCESS || result == LDR_WARNING_PART_NOT_FOUND);
+  nvgl::newBuffer(m_scene.partMaterialBuffer);
+  glNamedBufferStorage(m_scene.partMaterialBuffer, sizeof(uint32_t) * offsets.size(), offsets.data(), 0);
 }
 
+void Sample::buildPartLods()
+{
+  m_scene.hasLods = false;
+
+  std::vector<glsldata::PartLods> lods(std::max(m_scene.drawParts.size(), size_t(1)));
+  for(size_t i = 0; i < m_scene.drawParts.size(); i++) {
+    const DrawPart&     drawPart = m_scene.drawParts[i];
+    glsldata::PartLods& partLods = lods[i];
+    uint32_t            levels   = (drawPart.flags & DRAWPART_ACTIVE) ? drawPart.lodLevels : 0;
+
+    // zero counts end the level search in the shader
+    for(uint32_t l = 0; l < 4; l++) {
+      partLods.counts[l]  = l < levels ? drawPart.lodTriangleCount[l] * 3 : 0;
+      partLods.offsets[l] = l < levels ? drawPart.lodTriangleOffset[l] : 0;
+      partLods.errors[l]  = l < levels ? drawPart.lodError[l] : 0;
+    }
+    m_scene.hasLods = m_scene.hasLods || levels;
+  }
+
+  nvgl::newBuffer(m_scene.partLodsBuffer);
+  glNamedBufferStorage(m_scene.partLodsBuffer, sizeof(glsldata::PartLods) * lods.size(), lods.data(), 0);
+}
 
 void Sample::deinitScene()
 {
-  ldrDestroyModel(m_loader, m_scene.model);
-  ldrDestroyRenderModel(m_loader, m_scene.renderModel);
-
-  nvgl::deleteBuffer(m_scene.vertexBuffer);
-  nvgl::deleteBuffer(m_scene.indexBuffer);
-  nvgl::deleteBuffer(m_scene.materialIndexBuffer);
+  m_pipeline.unloadModel();
+
+  deleteSceneGeometry(m_scene);
+  deleteSceneGeometry(m_scene.resident);
+  nvgl::deleteBuffer(m_scene.instanceBuffer);
+  nvgl::deleteBuffer(m_scene.partMaterialBuffer);
+  nvgl::deleteBuffer(m_scene.partLodsBuffer);
+  nvgl::deleteBuffer(m_scene.multiDraw.indirectBuffer);
+  nvgl::deleteBuffer(m_scene.multiDraw.culledBuffer);
+  nvgl::deleteBuffer(m_scene.multiDraw.counterBuffer);
+  nvgl::deleteBuffer(m_scene.multiDraw.remainderBuffer);
+  nvgl::deleteBuffer(m_scene.multiDraw.visibilityBuffer);
+  nvgl::deleteBuffer(m_scene.meshletDraw.indirectBuffer);
+  nvgl::deleteBuffer(m_scene.drawList.instanceBuffer);
 
   glFlush();
   glFinish();
 
+  // sized for this scene's uploads
+  releaseUploadStaging();
+
   m_scene = Scene();
 }
 
-bool Sample::resetLoader()
+SceneLoadSettings Sample::getLoadSettings() const
 {
-  ldrDestroyLoader(m_loader);
-  m_loader = nullptr;
+  SceneLoadSettings settings;
+  settings.threadedLoad  = m_tweak.threadedLoad;
+  settings.pipelinedLoad = m_tweak.pipelinedLoad;
+  settings.partCache     = m_tweak.partCache;
+  settings.optimizeParts = m_tweak.optimizeParts;
+  settings.partLods      = m_tweak.partLods;
+  return settings;
+}
 
-  LdrResult result = ldrCreateLoader(&m_loaderCreateInfo, &m_loader);
-  assert(result == LDR_SUCCESS);
+bool Sample::resetLoader()
+{
+  bool result = m_pipeline.resetLoader(m_loaderCreateInfo, getLoadSettings());
 
   m_loaderCreateInfoLast = m_loaderCreateInfo;
 
-  if(m_loader) {
+  LdrLoaderHDL loader = m_pipeline.getLoader();
+  if(loader) {
     std::vector<glsldata::MaterialData> triangleMaterials;
-    uint32_t                            numMaterials = ldrGetNumRegisteredMaterials(m_loader);
+    uint32_t                            numMaterials = ldrGetNumRegisteredMaterials(loader);
     triangleMaterials.resize(numMaterials);
 
     for(uint32_t m = 0; m < numMaterials; m++) {
-      const LdrMaterial* mtl     = ldrGetMaterial(m_loader, m);
+      const LdrMaterial* mtl     = ldrGetMaterial(loader, m);
       triangleMaterials[m].color = {float(mtl->baseColor[0]) / float(255.0f), float(mtl->baseColor[1]) / float(255.0f),
                                     float(mtl->baseColor[2]) / float(255.0f), 1};
     }
@@ -391,8 +718,8 @@ bool Sample::resetLoader()
   }
 
 
-  printf("reset loader status: %d\n", result == LDR_SUCCESS ? 1 : 0);
-  return result == LDR_SUCCESS;
+  printf("reset loader status: %d\n", result ? 1 : 0);
+  return result;
 }
 
 bool Sample::resetScene()
@@ -407,6 +734,44 @@ bool Sample::resetScene()
   return result;
 }
 
+// applies loader setting changes to the loaded model, returns true if the scene buffers must be rebuilt
+bool Sample::updateScene()
+{
+  SceneLoadSettings settings = getLoadSettings();
+  SceneReloadStage  stage    = m_scene.blob.isOpen() ? RELOAD_FULL : m_pipeline.getReloadStage(m_loaderCreateInfo, settings);
+  printf("settings changed, rerun stage %s\n", getReloadStageName(stage));
+
+  if(stage == RELOAD_FULL) {
+    deinitScene();
+    resetLoader();
+    initScene();
+    return true;
+  }
+
+  SceneLoadTimings timings;
+  LdrResult        result = m_pipeline.updateModel(m_loaderCreateInfo, settings, timings);
+  if(result != LDR_SUCCESS && result != LDR_WARNING_PART_NOT_FOUND) {
+    // the pipeline is left as it was
+    printf("update failed with result %d, reloading\n", int(result));
+    deinitScene();
+    resetLoader();
+    initScene();
+    return true;
+  }
+
+  m_loaderCreateInfoLast = m_loaderCreateInfo;
+  m_scene.renderModel    = m_pipeline.getRenderModel();
+  if(stage >= RELOAD_POSTPROCESS) {
+    reportPartOptimizations();
+    reportPartLods();
+  }
+
+  const std::vector<LdrPartID>& chamferedParts = m_pipeline.getChamferedParts();
+  if(!chamferedParts.empty() && updateChamferedParts(chamferedParts))
+    return false;
+  return stage != RELOAD_NONE;
+}
+
 bool Sample::begin()
 {
   ImGuiH::Init(m_windowState.m_winSize[0], m_windowState.m_winSize[1], this);
@@ -414,10 +779,26 @@ bool Sample::begin()
 
   nvgl::newBuffer(m_common.viewBuffer);
   glNamedBufferStorage(m_common.viewBuffer, sizeof(glsldata::ViewData), NULL, GL_DYNAMIC_STORAGE_BIT);
-  nvgl::newBuffer(m_common.objectBuffer);
-  glNamedBufferStorage(m_common.objectBuffer, sizeof(glsldata::ObjectData), NULL, GL_DYNAMIC_STORAGE_BIT);
   nvgl::newVertexArray(m_common.vao);
 
+  // persistent mapped, read back a frame after the gpu wrote it
+  GLbitfield statsFlags   = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  uint32_t   statsZero[2] = {0, 0};
+  nvgl::newBuffer(m_occlusionStatsBuffer);
+  glNamedBufferStorage(m_occlusionStatsBuffer, sizeof(statsZero), statsZero, statsFlags);
+  m_occlusionStats = (const uint32_t*)glMapNamedBufferRange(m_occlusionStatsBuffer, 0, sizeof(statsZero), statsFlags);
+  glCreateQueries(GL_TIME_ELAPSED, 1, &m_pyramidQuery);
+
+  m_threadPool.init(std::thread::hardware_concurrency());
+
+  // pipelining and the part cache rely on the deferred stages of the threaded path
+  m_tweak.threadedLoad = m_tweak.threadedLoad || m_tweak.pipelinedLoad || m_tweak.partCache;
+
+  if(m_partCacheFile.empty()) {
+    m_partCacheFile = exePath() + std::string(PROJECT_NAME) + ".partcache";
+  }
+  m_pipeline.init(&m_threadPool, m_ldrawPath, m_partCostFile, m_partCacheFile);
+
   m_loaderCreateInfo.basePath = m_ldrawPath.c_str();
 
   bool validated = resetLoader();
@@ -445,11 +826,15 @@ bool Sample::begin()
 void Sample::end()
 {
   deinitScene();
-  ldrDestroyLoader(m_loader);
-  nvgl::deleteBuffer(m_common.objectBuffer);
+  m_pipeline.deinit();
   nvgl::deleteBuffer(m_common.viewBuffer);
   nvgl::deleteBuffer(m_common.materialsBuffer);
   nvgl::deleteVertexArray(m_common.vao);
+  glUnmapNamedBuffer(m_occlusionStatsBuffer);
+  nvgl::deleteBuffer(m_occlusionStatsBuffer);
+  glDeleteQueries(1, &m_pyramidQuery);
+
+  m_threadPool.deinit();
 
   ImGui::ShutdownGL();
 }
@@ -475,9 +860,12 @@ void Sample::processUI(double time)
     ImGui::PushItemWidth(200);
 
     if(ImGui::Button("LOAD")) {
-      std::string newFile = NVPWindow::openFileDialog("Pick Model", "Supported (ldr,mpd)|*.ldr;*.mpd|All (*.*)|*.*");
+      std::string newFile =
+          NVPWindow::openFileDialog("Pick Model", "Supported (ldr,mpd,ldrblob)|*.ldr;*.mpd;*.ldrblob|All (*.*)|*.*");
       if(!newFile.empty()) {
-        m_modelFilename = newFile;
+        bool isBlob     = newFile.size() > 8 && newFile.compare(newFile.size() - 8, 8, ".ldrblob") == 0;
+        m_blobFilename  = isBlob ? newFile : std::string();
+        m_modelFilename = isBlob ? std::string() : newFile;
         deinitScene();
         resetLoader();
         initScene();
@@ -488,7 +876,57 @@ void Sample::processUI(double time)
     if(ImGui::Button("RELOAD")) {
       resetScene();
     }
+    if(m_scene.model && !m_scene.blob.isOpen()) {
+      ImGui::SameLine();
+      if(ImGui::Button("BAKE")) {
+        bakeSceneBlob(m_modelFilename + ".ldrblob");
+      }
+    }
     if(m_scene.model && ImGui::CollapsingHeader("render settings", ImGuiTreeNodeFlags_DefaultOpen)) {
+      const char* renderers[NUM_RENDERERS] = {"classic", "multi draw indirect", "instanced", "meshlets (cpu cull)"};
+      ImGui::Combo("renderer", &m_tweak.renderer, renderers, NUM_RENDERERS);
+      ImGui::Text("draw cpu %.3f ms\n", m_drawTime / 1000.0);
+      ImGui::Text("draw calls %d, instances %d\n", m_drawCalls, m_drawInstances);
+      ImGui::Text("state changes %d\n", m_stateChanges);
+      ImGui::Checkbox("frustum cull", &m_tweak.frustumCull);
+      if(m_tweak.frustumCull && m_tweak.renderer == RENDERER_MDI) {
+        ImGui::Text(has_GL_ARB_indirect_parameters ? "culled by compute shader\n" : "gpu culling unsupported\n");
+        ImGui::Checkbox("occlusion cull", &m_tweak.occlusionCull);
+        if(useOcclusionCulling()) {
+          uint32_t tested   = m_occlusionStats[0];
+          uint32_t occluded = m_occlusionStats[1];
+          ImGui::Text("occluded %d of %d (%.1f%%)\n", occluded, tested, tested ? 100.0 * double(occluded) / double(tested) : 0.0);
+          ImGui::Text("depth pyramid %.3f ms\n", m_pyramidTime / 1000.0);
+        }
+      }
+      else if(m_tweak.frustumCull) {
+        ImGui::Text("visible %d, culled %d\n", m_cullStats.visible, m_cullStats.culled);
+        ImGui::Text("bvh %.3f ms, %d of %d nodes\n", m_cullStats.time / 1000.0, m_cullStats.nodesVisited, m_scene.bvh.getNumNodes());
+      }
+      if(m_tweak.renderer == RENDERER_MESHLETS) {
+        const MeshletStats&     stats = m_scene.meshletStats;
+        const MeshletCullStats& cull  = m_meshletCullStats;
+        ImGui::Checkbox("meshlet cone cull", &m_tweak.meshletConeCull);
+        ImGui::Text("meshlets %d, fill tris %.1f%%, verts %.1f%%\n", stats.meshlets, stats.getTriangleFill() * 100.0f,
+                    stats.getVertexFill() * 100.0f);
+        ImGui::Text("cones %.1f%%, avg half angle %.1f deg\n", stats.getConeRatio() * 100.0f, stats.getAverageConeAngle());
+        ImGui::Text("tested %d, frustum %d, backfacing %d\n", cull.tested, cull.frustumCulled, cull.coneCulled);
+        ImGui::Text("meshlet cull %.3f ms, %d commands\n", cull.time / 1000.0, cull.commands);
+      }
+      if(m_scene.hasLods) {
+        ImGui::Checkbox("part lods", &m_tweak.lods);
+        ImGui::SliderFloat("lod pixel error", &m_tweak.lodPixelError, 0.1f, 16.0f);
+        if(m_tweak.lods && m_tweak.renderer == RENDERER_MDI) {
+          ImGui::Text(useGpuCulling() ? "levels picked by compute shader\n" : "lods need gpu culling\n");
+        }
+        else if(m_tweak.lods) {
+          const LodStats& stats = m_lodStats;
+          ImGui::Text("instances per level %d / %d / %d / %d\n", stats.instances[0], stats.instances[1], stats.instances[2],
+                      stats.instances[3]);
+          ImGui::Text("tris %llu of %llu (%.1f%%)\n", (unsigned long long)stats.triangles, (unsigned long long)stats.fullTriangles,
+                      stats.fullTriangles ? 100.0 * double(stats.triangles) / double(stats.fullTriangles) : 0.0);
+        }
+      }
       ImGui::Checkbox("colors", &m_tweak.colors);
       ImGui::Checkbox("bf cull", &m_tweak.cull);
       ImGui::SliderFloat("x-ray transp.", &m_tweak.transparency, 0, 1);
@@ -500,138 +938,171 @@ void Sample::processUI(double time)
       if(m_scene.renderModel) {
         ImGui::Checkbox("draw render part", &m_tweak.drawRenderPart);
         ImGui::Checkbox("draw render part chamfer", &m_tweak.chamfered);
+        ImGui::Checkbox("keep both modes resident", &m_tweak.residentGeometry);
+        if(m_scene.hasResident) {
+          ImGui::Text("resident extra %.2f MB (%s)\n", double(m_scene.resident.getBufferBytes()) / (1024.0 * 1024.0),
+                      m_scene.resident.renderParts ? "render parts" : "parts");
+        }
       }
-      ImGui::InputInt("instance", &m_tweak.instance);
-      ImGui::InputInt("part", &m_tweak.part);
-      ImGui::InputInt("vertex", &m_tweak.vertex);
-      ImGui::InputInt("tri", &m_tweak.tri);
-      ImGui::InputInt("edge", &m_tweak.edge);
-
-      m_tweak.instance = std::max(-1, m_tweak.instance);
-      m_tweak.part     = std::max(-1, m_tweak.part);
-      m_tweak.vertex   = std::max(-1, m_tweak.vertex);
-      m_tweak.tri      = std::max(-1, m_tweak.tri);
-      m_tweak.edge     = std::max(-1, m_tweak.edge);
-
-      if(m_tweak.instance >= 0) {
-        m_tweak.instance = std::min((uint32_t)m_tweak.instance, m_scene.model->numInstances - 1);
-        m_tweak.part     = m_scene.model->instances[m_tweak.instance].part;
+      else if(m_scene.blob.isOpen() && m_tweak.drawRenderPart) {
+        ImGui::Checkbox("draw render part chamfer", &m_tweak.chamfered);
       }
-      else if(m_tweakLast.instance >= 0) {
-        m_tweak.part = -1;
+      if(!m_scene.blob.isOpen()) {
+        ImGui::Checkbox("vertex materials", &m_tweak.vertexMaterials);
+        ImGui::Checkbox("quantized vertices", &m_tweak.quantized);
       }
-
-      if(m_tweak.part >= 0) {
-        m_tweak.part = std::min((uint32_t)m_tweak.part, ldrGetNumRegisteredParts(m_loader) - 1);
+      if(m_scene.blob.isOpen()) {
+        ImGui::Text("scene blob: part inspection unavailable\n");
+        m_tweak.instance = -1;
+        m_tweak.part     = -1;
       }
-
-      if(m_tweak.part >= 0 && m_tweak.tri >= 0) {
-        const LdrVertexIndex* indices = nullptr;
-        if(m_scene.renderModel && m_tweak.drawRenderPart) {
-          const LdrRenderPart* rpart = ldrGetRenderPart(m_loader, m_tweak.part);
-          if(rpart) {
-            m_tweak.tri = std::min(uint32_t(m_tweak.tri), rpart->numTriangles - 1);
-            indices     = &rpart->triangles[m_tweak.tri * 3];
-          }
-        }
-        else {
-          const LdrPart* part = ldrGetPart(m_loader, m_tweak.part);
-          m_tweak.tri         = std::min(uint32_t(m_tweak.tri), part->numTriangles - 1);
-          indices             = &part->triangles[m_tweak.tri * 3];
+      else {
+        ImGui::InputInt("instance", &m_tweak.instance);
+        ImGui::InputInt("part", &m_tweak.part);
+        ImGui::InputInt("vertex", &m_tweak.vertex);
+        ImGui::InputInt("tri", &m_tweak.tri);
+        ImGui::InputInt("edge", &m_tweak.edge);
+
+        m_tweak.instance = std::max(-1, m_tweak.instance);
+        m_tweak.part     = std::max(-1, m_tweak.part);
+        m_tweak.vertex   = std::max(-1, m_tweak.vertex);
+        m_tweak.tri      = std::max(-1, m_tweak.tri);
+        m_tweak.edge     = std::max(-1, m_tweak.edge);
+
+        if(m_tweak.instance >= 0) {
+          m_tweak.instance = std::min((uint32_t)m_tweak.instance, m_scene.model->numInstances - 1);
+          m_tweak.part     = m_scene.model->instances[m_tweak.instance].part;
         }
-        if(indices) {
-          ImGui::Text("tri: %d %d %d\n", indices[0], indices[1], indices[2]);
+        else if(m_tweakLast.instance >= 0) {
+          m_tweak.part = -1;
         }
-        else {
-          ImGui::Text("tri: -\n");
+
+        if(m_tweak.part >= 0) {
+          m_tweak.part = std::min((uint32_t)m_tweak.part, ldrGetNumRegisteredParts(m_pipeline.getLoader()) - 1);
         }
-      }
 
-      if(m_tweak.part >= 0 && m_tweak.edge >= 0) {
-        const LdrVertexIndex* indices = nullptr;
-        if(m_scene.renderModel && m_tweak.drawRenderPart) {
-          const LdrRenderPart* rpart = ldrGetRenderPart(m_loader, m_tweak.part);
-          if(rpart) {
-            m_tweak.edge = std::min(uint32_t(m_tweak.edge), rpart->numLines - 1);
-            indices      = &rpart->lines[m_tweak.edge * 2];
+        if(m_tweak.part >= 0 && m_tweak.tri >= 0) {
+          const LdrVertexIndex* indices = nullptr;
+          if(m_scene.renderModel && m_tweak.drawRenderPart) {
+            const LdrRenderPart* rpart = m_pipeline.getRenderPart(m_tweak.part);
+            if(rpart) {
+              m_tweak.tri = std::min(uint32_t(m_tweak.tri), rpart->numTriangles - 1);
+              indices     = &rpart->triangles[m_tweak.tri * 3];
+            }
+          }
+          else {
+            const LdrPart* part = m_pipeline.getPart(m_tweak.part);
+            m_tweak.tri         = std::min(uint32_t(m_tweak.tri), part->numTriangles - 1);
+            indices             = &part->triangles[m_tweak.tri * 3];
+          }
+          if(indices) {
+            ImGui::Text("tri: %d %d %d\n", indices[0], indices[1], indices[2]);
+          }
+          else {
+            ImGui::Text("tri: -\n");
           }
         }
-        else {
-          const LdrPart* part = ldrGetPart(m_loader, m_tweak.part);
-          m_tweak.edge        = std::min(uint32_t(m_tweak.edge), part->numLines - 1);
-          indices             = &part->lines[m_tweak.edge * 2];
-        }
-        if(indices) {
-          ImGui::Text("line: %d %d\n", indices[0], indices[1]);
-        }
-        else {
-          ImGui::Text("line: -\n");
-        }
-      }
 
-      if(m_tweak.vertex >= 0 && m_tweak.part >= 0) {
-        const LdrPart* part = ldrGetPart(m_loader, m_tweak.part);
-
-        const float* pos = nullptr;
-        const float* nrm = nullptr;
-        if(m_scene.renderModel && m_tweak.drawRenderPart) {
-          const LdrRenderPart* rpart = ldrGetRenderPart(m_loader, m_tweak.part);
-          if(rpart) {
-            m_tweak.vertex = std::min(uint32_t(m_tweak.vertex), rpart->numVertices - 1);
-            pos            = &rpart->vertices[m_tweak.vertex].position.x;
-            nrm            = &rpart->vertices[m_tweak.vertex].normal.x;
+        if(m_tweak.part >= 0 && m_tweak.edge >= 0) {
+          const LdrVertexIndex* indices = nullptr;
+          if(m_scene.renderModel && m_tweak.drawRenderPart) {
+            const LdrRenderPart* rpart = m_pipeline.getRenderPart(m_tweak.part);
+            if(rpart) {
+              m_tweak.edge = std::min(uint32_t(m_tweak.edge), rpart->numLines - 1);
+              indices      = &rpart->lines[m_tweak.edge * 2];
+            }
+          }
+          else {
+            const LdrPart* part = m_pipeline.getPart(m_tweak.part);
+            m_tweak.edge        = std::min(uint32_t(m_tweak.edge), part->numLines - 1);
+            indices             = &part->lines[m_tweak.edge * 2];
+          }
+          if(indices) {
+            ImGui::Text("line: %d %d\n", indices[0], indices[1]);
+          }
+          else {
+            ImGui::Text("line: -\n");
           }
         }
-        else {
-          const LdrPart* part = ldrGetPart(m_loader, m_tweak.part);
-          m_tweak.vertex      = std::min(uint32_t(m_tweak.vertex), part->numPositions - 1);
-          pos                 = &part->positions[m_tweak.vertex].x;
-        }
-        if(pos) {
-          ImGui::Text("vert: %.3f %.3f %.3f\n", pos[0], pos[1], pos[2]);
-        }
-        else {
-          ImGui::Text("pos: -\n");
-        }
-        if(nrm) {
-          ImGui::Text("norm: %.3f %.3f %.3f\n", nrm[0], nrm[1], nrm[2]);
-        }
-        else {
-          ImGui::Text("norm: -\n");
-        }
-      }
 
-      if(m_tweak.part >= 0) {
-        const LdrPart* part = ldrGetPart(m_loader, m_tweak.part);
-        if(part) {
-          ImGui::Text("%s\n", part->name);
+        if(m_tweak.vertex >= 0 && m_tweak.part >= 0) {
+          const float* pos = nullptr;
+          const float* nrm = nullptr;
           if(m_scene.renderModel && m_tweak.drawRenderPart) {
-            const LdrRenderPart* rpart = ldrGetRenderPart(m_loader, m_tweak.part);
+            const LdrRenderPart* rpart = m_pipeline.getRenderPart(m_tweak.part);
             if(rpart) {
-              ImGui::Text("  instances %6d\n", 0);
-              ImGui::Text("  points    %6d\n", rpart->numVertices);
-              ImGui::Text("  tris      %6d\n", rpart->numTriangles);
-              ImGui::Text("  lines     %6d\n", rpart->numLines);
-              ImGui::Text("  olines    %6d\n", 0);
+              m_tweak.vertex = std::min(uint32_t(m_tweak.vertex), rpart->numVertices - 1);
+              pos            = &rpart->vertices[m_tweak.vertex].position.x;
+              nrm            = &rpart->vertices[m_tweak.vertex].normal.x;
             }
           }
           else {
-            ImGui::Text("  instances %6d\n", part->numInstances);
-            ImGui::Text("  points    %6d\n", part->numPositions);
-            ImGui::Text("  tris      %6d\n", part->numTriangles);
-            ImGui::Text("  lines     %6d\n", part->numLines);
-            ImGui::Text("  olines    %6d\n", part->numOptionalLines);
+            const LdrPart* part = m_pipeline.getPart(m_tweak.part);
+            m_tweak.vertex      = std::min(uint32_t(m_tweak.vertex), part->numPositions - 1);
+            pos                 = &part->positions[m_tweak.vertex].x;
+          }
+          if(pos) {
+            ImGui::Text("vert: %.3f %.3f %.3f\n", pos[0], pos[1], pos[2]);
+          }
+          else {
+            ImGui::Text("pos: -\n");
+          }
+          if(nrm) {
+            ImGui::Text("norm: %.3f %.3f %.3f\n", nrm[0], nrm[1], nrm[2]);
+          }
+          else {
+            ImGui::Text("norm: -\n");
+          }
+        }
+
+        if(m_tweak.part >= 0) {
+          const LdrPart* part = m_pipeline.getPart(m_tweak.part);
+          if(part) {
+            ImGui::Text("%s\n", part->name);
+            if(m_scene.renderModel && m_tweak.drawRenderPart) {
+              const LdrRenderPart* rpart = m_pipeline.getRenderPart(m_tweak.part);
+              if(rpart) {
+                ImGui::Text("  instances %6d\n", 0);
+                ImGui::Text("  points    %6d\n", rpart->numVertices);
+                ImGui::Text("  tris      %6d\n", rpart->numTriangles);
+                ImGui::Text("  lines     %6d\n", rpart->numLines);
+                ImGui::Text("  olines    %6d\n", 0);
+              }
+            }
+            else {
+              ImGui::Text("  instances %6d\n", part->numInstances);
+              ImGui::Text("  points    %6d\n", part->numPositions);
+              ImGui::Text("  tris      %6d\n", part->numTriangles);
+              ImGui::Text("  lines     %6d\n", part->numLines);
+              ImGui::Text("  olines    %6d\n", part->numOptionalLines);
+            }
+            for(const PartOptimization& opt : m_pipeline.getPartOptimizations()) {
+              if(opt.part != LdrPartID(m_tweak.part))
+                continue;
+
+              bool                    render = m_scene.renderModel && m_tweak.drawRenderPart;
+              const VertexCacheStats& before = render ? opt.stats.renderBefore : opt.stats.before;
+              const VertexCacheStats& after  = render ? opt.stats.renderAfter : opt.stats.after;
+              ImGui::Text("  acmr      %.3f -> %.3f\n", before.getAcmr(), after.getAcmr());
+              ImGui::Text("  atvr      %.3f -> %.3f\n", before.getAtvr(), after.getAtvr());
+            }
           }
         }
       }
     }
 
+    if(m_scene.model && ImGui::CollapsingHeader("memory per part")) {
+      processPartMemoryUI();
+    }
+
     if(ImGui::CollapsingHeader("loader settings", ImGuiTreeNodeFlags_DefaultOpen)) {
       ImGui::Checkbox("build renderparts", (bool*)&m_loaderCreateInfo.renderpartBuildMode);
       ImGui::Checkbox("fix parts", (bool*)&m_loaderCreateInfo.partFixMode);
       ImGui::Checkbox("fix coplanar overlap", (bool*)&m_loaderCreateInfo.partFixOverlap);
       ImGui::Checkbox("fix t junctions", (bool*)&m_loaderCreateInfo.partFixTjunctions);
       ImGui::Checkbox("hi-res primitives", (bool*)&m_loaderCreateInfo.partHiResPrimitives);
+      ImGui::Checkbox("optimize vertex cache", &m_tweak.optimizeParts);
+      ImGui::Checkbox("part lods", &m_tweak.partLods);
       ImGui::InputFloat("render chamfer", &m_loaderCreateInfo.renderpartChamfer, 0, 0, "%.3f", ImGuiInputTextFlags_EnterReturnsTrue);
     }
     ImGui::PopItemWidth();
@@ -639,6 +1110,91 @@ void Sample::processUI(double time)
   ImGui::End();
 }
 
+void Sample::processPartMemoryUI()
+{
+  size_t total[8] = {};
+  for(const PartMemory& mem : m_scene.partMemory) {
+    total[0] += mem.vertexBytes;
+    total[1] += mem.triangleBytes;
+    total[2] += mem.edgeBytes;
+    total[3] += mem.optionalBytes;
+    total[4] += mem.chamferBytes;
+    total[5] += mem.materialBytes;
+    total[6] += mem.lodBytes;
+    total[7] += mem.getTotal();
+  }
+  ImGui::Text("%d parts, %.2f MB total\n", uint32_t(m_scene.partMemory.size()), double(total[7]) / (1024.0 * 1024.0));
+  if(m_scene.layout.format.materials) {
+    size_t added = 0;
+    size_t saved = 0;
+    getVertexMaterialBytes(m_scene.layout, added, saved);
+    ImGui::Text("vertex materials: +%d vertices, +%.1f KB vertices, -%.1f KB material ids\n", m_scene.layout.splitVertices,
+                double(added) / 1024.0, double(saved) / 1024.0);
+  }
+  if(!m_scene.quantizationErrors.empty()) {
+    const QuantizationError& worst  = m_scene.quantizationErrors[0];
+    float                    normal = 0;
+    for(const QuantizationError& error : m_scene.quantizationErrors) {
+      normal = std::max(normal, error.normal);
+    }
+    ImGui::Text("quantization: max position error %.4f LDU (part %d), max normal error %.3f deg\n", worst.position, worst.part, normal);
+  }
+
+  if(ImGui::Button("dump CSV")) {
+    std::string filename = (m_modelFilename.empty() ? m_blobFilename : m_modelFilename) + ".parts.csv";
+    bool        success  = savePartMemoryCsv(filename, m_scene.partMemory, m_scene.blob.isOpen() ? nullptr : &m_pipeline);
+    printf("part memory csv %s: %d\n", filename.c_str(), success ? 1 : 0);
+  }
+
+  // sizes in KB, largest parts first
+  const char*     columns[]  = {"part", "inst", "vtx", "tri", "edge", "opt", "chamf", "mtl", "lod", "total"};
+  ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_SizingFixedFit;
+  if(ImGui::BeginTable("partmemory", 10, tableFlags, ImVec2(0, 300))) {
+    ImGui::TableSetupScrollFreeze(0, 1);
+    for(const char* column : columns) {
+      ImGui::TableSetupColumn(column);
+    }
+    ImGui::TableHeadersRow();
+
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::Text("all");
+    ImGui::TableNextColumn();
+    ImGui::Text("%d", m_scene.model->numInstances);
+    for(size_t t = 0; t < 8; t++) {
+      ImGui::TableNextColumn();
+      ImGui::Text("%.1f", double(total[t]) / 1024.0);
+    }
+
+    ImGuiListClipper clipper;
+    clipper.Begin(int(m_scene.partMemory.size()));
+    while(clipper.Step()) {
+      for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+        const PartMemory& mem      = m_scene.partMemory[i];
+        const LdrPart*    part     = m_scene.blob.isOpen() ? nullptr : m_pipeline.getPart(mem.part);
+        size_t            sizes[8] = {mem.vertexBytes,  mem.triangleBytes, mem.edgeBytes, mem.optionalBytes,
+                                      mem.chamferBytes, mem.materialBytes, mem.lodBytes,  mem.getTotal()};
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        if(part && part->name) {
+          ImGui::Text("%s", part->name);
+        }
+        else {
+          ImGui::Text("%d", mem.part);
+        }
+        ImGui::TableNextColumn();
+        ImGui::Text("%d", mem.instances);
+        for(size_t t = 0; t < 8; t++) {
+          ImGui::TableNextColumn();
+          ImGui::Text("%.1f", double(sizes[t]) / 1024.0);
+        }
+      }
+    }
+    ImGui::EndTable();
+  }
+}
+
 void Sample::think(double time)
 {
   NV_PROFILE_GL_SECTION("Frame");
@@ -677,6 +1233,8 @@ void Sample::think(double time)
     m_viewUbo.opacity         = 1.0f - m_tweak.transparency;
     m_viewUbo.useObjectColor  = m_tweak.colors ? 1 : 0;
     m_viewUbo.inheritColor    = m_tweak.inheritColor;
+    m_viewUbo.lodScale        = projection.mat_array[5] * float(height) * 0.5f;
+    m_viewUbo.lodPixelError   = m_tweak.lodPixelError;
 
     glNamedBufferSubData(m_common.viewBuffer, 0, sizeof(glsldata::ViewData), &m_viewUbo);
 
@@ -690,23 +1248,74 @@ void Sample::think(double time)
   }
 
   bool doRebuild = false;
-  if(memcmp(&m_loaderCreateInfoLast, &m_loaderCreateInfo, sizeof(m_loaderCreateInfo)) != 0 || tweakChanged(m_tweak.threadedLoad)) {
-    deinitScene();
-    resetLoader();
-    initScene();
-    doRebuild = true;
+  if(memcmp(&m_loaderCreateInfoLast, &m_loaderCreateInfo, sizeof(m_loaderCreateInfo)) != 0 || tweakChanged(m_tweak.threadedLoad)
+     || tweakChanged(m_tweak.pipelinedLoad) || tweakChanged(m_tweak.optimizeParts) || tweakChanged(m_tweak.partLods)) {
+    doRebuild = updateScene();
   }
 
-  if(!m_scene.renderModel)
+  if(!m_scene.renderModel && !m_scene.blob.isOpen())
     m_tweak.drawRenderPart = false;
 
-  if(doRebuild || tweakChanged(m_tweak.chamfered) || tweakChanged(m_tweak.drawRenderPart)) {
+  // the resident other draw mode makes the toggle a swap, chamfering only selects other ranges
+  bool swapDrawMode = tweakChanged(m_tweak.drawRenderPart) && m_scene.hasResident && m_scene.resident.renderParts == m_tweak.drawRenderPart;
+  if(doRebuild || (tweakChanged(m_tweak.drawRenderPart) && !swapDrawMode) || tweakChanged(m_tweak.vertexMaterials)
+     || tweakChanged(m_tweak.quantized) || tweakChanged(m_tweak.residentGeometry)) {
     rebuildSceneBuffers();
   }
+  else if(swapDrawMode) {
+    swapResidentGeometry();
+    applyDrawMode();
+  }
+  else if(tweakChanged(m_tweak.chamfered)) {
+    applyDrawMode();
+  }
+  reportUploadCopy();
+
+  if(tweakChanged(m_tweak.cull) || tweakChanged(m_tweak.instance) || tweakChanged(m_tweak.part)) {
+    m_scene.drawList.dirty  = true;
+    m_scene.multiDraw.dirty = true;
+  }
+  if(tweakChanged(m_tweak.frustumCull) || tweakChanged(m_tweak.lods)) {
+    m_scene.drawList.dirty = true;
+  }
+
+  // occlusion culling interleaves its cull passes with drawing
+  if(m_tweak.renderer == RENDERER_MDI && useGpuCulling() && !useOcclusionCulling()) {
+    NV_PROFILE_GL_SECTION("Cull");
+    cullMultiDraw(CULL_FRUSTUM);
+  }
+  else if(m_tweak.renderer == RENDERER_MESHLETS) {
+    NV_PROFILE_GL_SECTION("Cull");
+    cullMeshlets();
+  }
+  else if(m_tweak.renderer != RENDERER_MDI && (m_tweak.frustumCull || useLods())) {
+    NV_PROFILE_GL_SECTION("Cull");
+    cullScene();
+  }
+  else if(m_tweak.renderer == RENDERER_MDI && m_scene.model && m_scene.multiDraw.dirty) {
+    buildMultiDraw();
+  }
 
   {
     NV_PROFILE_GL_SECTION("Draw");
-    drawDebug();
+    double drawTime = -m_profiler.getMicroSeconds();
+    m_drawCalls     = 0;
+    m_drawInstances = 0;
+    m_stateChanges  = 0;
+    if(m_tweak.renderer == RENDERER_MDI && useOcclusionCulling()) {
+      drawOcclusionCulled();
+    }
+    else if(m_tweak.renderer == RENDERER_MDI) {
+      drawMultiDraw(m_scene.multiDraw, useGpuCulling() ? 0 : -1, true);
+    }
+    else if(m_tweak.renderer == RENDERER_MESHLETS) {
+      drawMultiDraw(m_scene.meshletDraw, -1, true);
+    }
+    else {
+      drawDebug(m_tweak.renderer == RENDERER_INSTANCED);
+    }
+    drawTime += m_profiler.getMicroSeconds();
+    m_drawTime = drawTime;
   }
 
   {
@@ -732,175 +1341,664 @@ void Sample::resize(int width, int height)
   initFramebuffers(width, height);
 }
 
-void Sample::rebuildSceneBuffers()
+// all three buffers are filled through one staging buffer, vertices first, returns its size
+static size_t getStagingOffsets(const SceneLayout& layout, size_t& indexOffset, size_t& materialOffset)
 {
-  LdrModelHDL model = m_scene.model;
-  if(!model)
-    return;
-
-  uint32_t numParts = ldrGetNumRegisteredParts(m_loader);
-  m_scene.drawParts.resize(numParts);
+  indexOffset    = (layout.vertexSize * layout.numVertices + 255) & ~size_t(255);
+  materialOffset = (indexOffset + layout.getIndexBytes() + 255) & ~size_t(255);
+  return materialOffset + sizeof(LdrMaterialID) * layout.numMaterials;
+}
 
-  std::vector<bool> activeParts(numParts, false);
+void Sample::uploadSceneBuffers(const SceneLayout& layout, const SceneFillFunction& fill)
+{
+  nvgl::newBuffer(m_scene.vertexBuffer);
+  nvgl::newBuffer(m_scene.indexBuffer);
+  nvgl::newBuffer(m_scene.materialIndexBuffer);
 
-  for(uint32_t i = 0; i < model->numInstances; i++) {
-    const LdrInstance* instance = &model->instances[i];
-    if(instance->part != LDR_INVALID_ID)
-      activeParts[instance->part] = true;
-  }
+  size_t vertexSize   = layout.vertexSize * layout.numVertices;
+  size_t indexSize    = layout.getIndexBytes();
+  size_t materialSize = sizeof(LdrMaterialID) * layout.numMaterials;
 
-  uint32_t vboOffset = 0;
-  uint32_t iboOffset = 0;
-  uint32_t mtlOffset = 0;
+  size_t vertexOffset = 0;
+  size_t indexOffset;
+  size_t materialOffset;
+  size_t stagingSize = getStagingOffsets(layout, indexOffset, materialOffset);
 
-  for(uint32_t i = 0; i < numParts; i++) {
-    if(!activeParts[i])
-      continue;
+  if(!(vertexSize + indexSize + materialSize))
+    return;
 
-    const LdrPart* part = ldrGetPart(m_loader, i);
+  if(vertexSize) {
+    printf("vbo size: %9d - %9d KB\n", layout.numVertices, (uint32_t)((vertexSize + 1023) / 1024));
+  }
+  if(layout.format.materials) {
+    size_t added = 0;
+    size_t saved = 0;
+    getVertexMaterialBytes(layout, added, saved);
+    printf("vtx mtl:  %9d split vertices, +%d KB vertices, -%d KB material ids\n", layout.splitVertices,
+           (uint32_t)((added + 1023) / 1024), (uint32_t)((saved + 1023) / 1024));
+  }
+  if(indexSize) {
+    size_t indexSize32 = sizeof(uint32_t) * layout.numIndices;
+    size_t indexSize16 = sizeof(uint16_t) * layout.numIndices16;
+    printf("ibo size: %9d - %9d KB (32-bit: %d - %d KB, 16-bit: %d - %d KB)\n", layout.numIndices + layout.numIndices16,
+           (uint32_t)((indexSize + 1023) / 1024), layout.numIndices, (uint32_t)((indexSize32 + 1023) / 1024), layout.numIndices16,
+           (uint32_t)((indexSize16 + 1023) / 1024));
+  }
+  if(materialSize) {
+    printf("mtl size: %9d - %9d KB\n", layout.numMaterials, (uint32_t)((materialSize + 1023) / 1024));
+  }
 
-    DrawPart& drawPart = m_scene.drawParts[i];
+  double timeMap = -m_profiler.getMicroSeconds();
 
-    uint32_t materialIndexCount  = 0;
-    uint32_t materialIndexCountC = 0;
+  uint8_t* mapping = mapUploadStaging(stagingSize);
+  // a failed mapping falls back to creating the buffers from client memory
+  std::vector<uint8_t> fallback;
+  if(!mapping) {
+    printf("upload: staging buffer could not be mapped, uploading from client memory\n");
+    fallback.resize(stagingSize);
+    mapping = fallback.data();
+  }
 
-    if(!m_tweak.drawRenderPart) {
-      drawPart.vertexCount    = part->numPositions;
-      drawPart.triangleCount  = part->numTriangles;
-      drawPart.edgesCount     = part->numLines;
-      drawPart.optionalCount  = part->numOptionalLines;
-      drawPart.triangleCountC = 0;
-      if(part->triangleMaterials && part->flags.hasComplexMaterial) {
-        materialIndexCount = part->numTriangles;
-      }
-    }
-    else {
-      const LdrRenderPart* rpart = ldrGetRenderPart(m_loader, i);
-      if(rpart) {
-        drawPart.vertexCount    = rpart->numVertices;
-        drawPart.triangleCount  = rpart->numTriangles;
-        drawPart.edgesCount     = rpart->numLines;
-        drawPart.optionalCount  = 0;
-        drawPart.triangleCountC = rpart->numTrianglesC;
-        if(rpart->triangleMaterials && rpart->flags.hasComplexMaterial)
-          materialIndexCount = rpart->numTriangles;
-        if(rpart->materialsC && rpart->flags.hasComplexMaterial)
-          materialIndexCountC = rpart->numTrianglesC;
-      }
-      else {
-        drawPart.vertexCount    = 0;
-        drawPart.triangleCount  = 0;
-        drawPart.edgesCount     = 0;
-        drawPart.optionalCount  = 0;
-        drawPart.triangleCountC = 0;
-      }
-    }
+  timeMap += m_profiler.getMicroSeconds();
 
-    drawPart.vertexOffset     = vboOffset;
-    drawPart.triangleOffset   = iboOffset;
-    drawPart.materialIDOffset = mtlOffset;
-    mtlOffset += materialIndexCount;
-    drawPart.materialIDOffsetC = mtlOffset;
-    mtlOffset += materialIndexCountC;
+  double timeFill = -m_profiler.getMicroSeconds();
+  fill(mapping + vertexOffset, mapping + indexOffset, (LdrMaterialID*)(mapping + materialOffset));
+  timeFill += m_profiler.getMicroSeconds();
 
-    vboOffset += drawPart.vertexCount;
-    iboOffset += drawPart.triangleCount * 3;
-    mtlOffset += materialIndexCount;
+  auto upload = [&](GLuint buffer, size_t offset, size_t size) {
+    glNamedBufferStorage(buffer, size, fallback.empty() ? nullptr : mapping + offset, 0);
+    if(fallback.empty()) {
+      glCopyNamedBufferSubData(m_uploadStaging.buffer, buffer, offset, 0, size);
+    }
+  };
 
-    drawPart.edgesOffset = iboOffset;
-    iboOffset += drawPart.edgesCount * 2;
-    drawPart.optionalOffset = iboOffset;
-    iboOffset += drawPart.optionalCount * 2;
-    drawPart.triangleOffsetC = iboOffset;
-    iboOffset += drawPart.triangleCountC * 3;
+  // the copies run asynchronously, timed on the gpu and reported by reportUploadCopy
+  if(fallback.empty()) {
+    if(!m_uploadStaging.query) {
+      glCreateQueries(GL_TIME_ELAPSED, 1, &m_uploadStaging.query);
+    }
+    glBeginQuery(GL_TIME_ELAPSED, m_uploadStaging.query);
+  }
+  if(vertexSize) {
+    upload(m_scene.vertexBuffer, vertexOffset, vertexSize);
+  }
+  if(indexSize) {
+    upload(m_scene.indexBuffer, indexOffset, indexSize);
+  }
+  if(materialSize) {
+    upload(m_scene.materialIndexBuffer, materialOffset, materialSize);
   }
 
-  glFlush();
-  glFinish();
+  // no wait, the next upload waits on the fence before it overwrites the staging memory
+  if(fallback.empty()) {
+    glEndQuery(GL_TIME_ELAPSED);
+    m_uploadStaging.queryPending = true;
+    m_uploadStaging.copyBytes    = vertexSize + indexSize + materialSize;
+    m_uploadStaging.fence        = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
 
-  nvgl::newBuffer(m_scene.vertexBuffer);
-  nvgl::newBuffer(m_scene.indexBuffer);
-  nvgl::newBuffer(m_scene.materialIndexBuffer);
+  double megaBytes = double(vertexSize + indexSize + materialSize) / (1024.0 * 1024.0);
+  printf("upload %.2f MB: map %.2f ms, fill %.2f ms (%.0f MB/s)\n", megaBytes, timeMap / 1000.0f, timeFill / 1000.0f,
+         megaBytes / std::max(timeFill / 1000000.0, 1e-6));
+}
 
-  glFlush();
-  glFinish();
+// polled every frame without waiting, and after the fence wait of the next upload
+void Sample::reportUploadCopy()
+{
+  if(!m_uploadStaging.queryPending)
+    return;
+
+  GLint available = 0;
+  glGetQueryObjectiv(m_uploadStaging.query, GL_QUERY_RESULT_AVAILABLE, &available);
+  if(!available)
+    return;
+
+  GLuint64 elapsed = 0;
+  glGetQueryObjectui64v(m_uploadStaging.query, GL_QUERY_RESULT, &elapsed);
+  m_uploadStaging.queryPending = false;
 
-  size_t vertexSize = (m_tweak.drawRenderPart ? sizeof(LdrRenderVertex) : sizeof(LdrVector));
+  double megaBytes = double(m_uploadStaging.copyBytes) / (1024.0 * 1024.0);
+  double seconds   = double(elapsed) / 1000000000.0;
+  printf("upload copy %.2f MB: %.2f ms gpu (%.0f MB/s)\n", megaBytes, seconds * 1000.0, megaBytes / std::max(seconds, 1e-9));
+}
 
-  if(vboOffset) {
-    printf("vbo size: %9d - %9d KB\n", vboOffset, (uint32_t)(vertexSize * vboOffset + 1023) & ~1023);
-    glNamedBufferStorage(m_scene.vertexBuffer, vertexSize * vboOffset, nullptr, GL_DYNAMIC_STORAGE_BIT);
+uint8_t* Sample::mapUploadStaging(size_t size)
+{
+  if(m_uploadStaging.fence) {
+    GLenum status;
+    do {
+      status = glClientWaitSync(m_uploadStaging.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    } while(status == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(m_uploadStaging.fence);
+    m_uploadStaging.fence = nullptr;
   }
-  if(iboOffset) {
-    printf("ibo size: %9d - %9d KB\n", iboOffset, (uint32_t)(sizeof(uint32_t) * iboOffset + 1023) & ~1023);
-    glNamedBufferStorage(m_scene.indexBuffer, sizeof(uint32_t) * iboOffset, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  // the copies are done, the query is reused by this upload
+  reportUploadCopy();
+
+  if(size > m_uploadStaging.size) {
+    releaseUploadStaging();
+
+    GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &m_uploadStaging.buffer);
+    glNamedBufferStorage(m_uploadStaging.buffer, size, nullptr, mapFlags);
+    m_uploadStaging.mapping = (uint8_t*)glMapNamedBufferRange(m_uploadStaging.buffer, 0, size, mapFlags);
+    m_uploadStaging.size    = m_uploadStaging.mapping ? size : 0;
   }
-  if(mtlOffset) {
-    printf("mtl size: %9d - %9d KB\n", mtlOffset, (uint32_t)(sizeof(LdrMaterialID) * mtlOffset + 1023) & ~1023);
-    glNamedBufferStorage(m_scene.materialIndexBuffer, sizeof(LdrMaterialID) * mtlOffset, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+  return m_uploadStaging.mapping;
+}
+
+void Sample::releaseUploadStaging()
+{
+  if(m_uploadStaging.fence) {
+    glDeleteSync(m_uploadStaging.fence);
+  }
+  if(m_uploadStaging.mapping) {
+    glUnmapNamedBuffer(m_uploadStaging.buffer);
+  }
+  if(m_uploadStaging.query) {
+    glDeleteQueries(1, &m_uploadStaging.query);
   }
+  nvgl::deleteBuffer(m_uploadStaging.buffer);
+  m_uploadStaging = UploadStaging();
+}
 
-  for(uint32_t i = 0; i < numParts; i++) {
-    if(!activeParts[i])
-      continue;
+void Sample::rebuildSceneBuffers()
+{
+  if(!m_scene.model)
+    return;
 
-    const DrawPart& drawPart = m_scene.drawParts[i];
+  deleteSceneGeometry(m_scene.resident);
+  m_scene.hasResident = false;
+
+  if(m_scene.blob.isOpen()) {
+    const SceneBlobHeader& header = m_scene.blob.getHeader();
+
+    SceneLayout layout;
+    layout.vertexSize       = header.vertexSize;
+    layout.numVertices      = header.numVertices;
+    layout.numIndices       = header.numIndices;
+    layout.numIndices16     = header.numIndices16;
+    layout.numMaterials     = header.numMaterials;
+    layout.format.materials = header.options.vertexMaterials != 0;
+    layout.format.quantized = header.options.quantizedVertices != 0;
+    layout.splitVertices    = header.numSplitVertices;
+    layout.splitMaterials   = header.numSplitMaterials;
+    m_scene.layout          = layout;
+    m_scene.quantizationErrors.clear();
+
+    const DrawPart* drawParts = m_scene.blob.getSection<DrawPart>(header.drawPartsOffset);
+    m_scene.drawParts.assign(drawParts, drawParts + header.numDrawParts);
+    computePartMemory(m_scene.drawParts, layout, m_scene.model, m_scene.partMemory);
+    // stored, quantized vertices cannot reproduce them
+    const LdrBbox* partBounds = m_scene.blob.getSection<LdrBbox>(header.partBoundsOffset);
+    m_scene.partBounds.assign(partBounds, partBounds + header.numDrawParts);
+    const Meshlet* meshlets = m_scene.blob.getSection<Meshlet>(header.meshletsOffset);
+    m_scene.meshlets.assign(meshlets, meshlets + header.numMeshlets);
+    m_scene.renderParts = header.options.drawRenderPart != 0;
+    buildCullData();
+    applyDrawMode();
+
+    // copy straight from the file mapping into the staging mapping
+    uploadSceneBuffers(layout, [&](uint8_t* vertices, uint8_t* indices, LdrMaterialID* materials) {
+      struct Section
+      {
+        void*       dst;
+        const void* src;
+        size_t      size;
+      };
+      Section sections[3] = {
+          {vertices, m_scene.blob.getSection<uint8_t>(header.verticesOffset), layout.vertexSize * layout.numVertices},
+          {indices, m_scene.blob.getSection<uint8_t>(header.indicesOffset), layout.getIndexBytes()},
+          {materials, m_scene.blob.getSection<LdrMaterialID>(header.materialsOffset), sizeof(LdrMaterialID) * layout.numMaterials},
+      };
+
+      const size_t chunkSize = 1024 * 1024;
+      for(const Section& section : sections) {
+        uint32_t numChunks = uint32_t((section.size + chunkSize - 1) / chunkSize);
+        m_threadPool.parallelItems(numChunks, [&](uint32_t, uint32_t begin, uint32_t end) {
+          size_t offset = chunkSize * begin;
+          size_t size   = std::min(chunkSize * end, section.size) - offset;
+          memcpy((uint8_t*)section.dst + offset, (const uint8_t*)section.src + offset, size);
+        });
+      }
+    });
+    return;
+  }
 
-    if(!m_tweak.drawRenderPart) {
-      const LdrPart* part = ldrGetPart(m_loader, i);
+  buildSceneGeometry(m_tweak.drawRenderPart);
 
-      glNamedBufferSubData(m_scene.vertexBuffer, vertexSize * drawPart.vertexOffset, vertexSize * drawPart.vertexCount,
-                           part->positions);
-      glNamedBufferSubData(m_scene.indexBuffer, sizeof(uint32_t) * drawPart.triangleOffset,
-                           sizeof(uint32_t) * drawPart.triangleCount * 3, part->triangles);
-      glNamedBufferSubData(m_scene.indexBuffer, sizeof(uint32_t) * drawPart.edgesOffset,
-                           sizeof(uint32_t) * drawPart.edgesCount * 2, part->lines);
-      glNamedBufferSubData(m_scene.indexBuffer, sizeof(uint32_t) * drawPart.optionalOffset,
-                           sizeof(uint32_t) * drawPart.optionalCount * 2, part->optional_lines);
+  // the other draw mode is built the same way and parked until drawRenderPart is toggled
+  if(m_tweak.residentGeometry && m_scene.renderModel) {
+    swapResidentGeometry();
+    buildSceneGeometry(!m_tweak.drawRenderPart);
+    swapResidentGeometry();
+    m_scene.hasResident = true;
+    printf("resident %s geometry: %.2f MB\n", m_scene.resident.renderParts ? "render part" : "part",
+           double(m_scene.resident.getBufferBytes()) / (1024.0 * 1024.0));
+  }
 
-      if(part->triangleMaterials && part->flags.hasComplexMaterial) {
-        glNamedBufferSubData(m_scene.materialIndexBuffer, sizeof(LdrMaterialID) * drawPart.materialIDOffset,
-                             sizeof(LdrMaterialID) * drawPart.triangleCount, part->triangleMaterials);
-      }
+  applyDrawMode();
+}
+
+void Sample::buildSceneGeometry(bool renderParts)
+{
+  SceneLayout layout;
+  m_pipeline.computeSceneLayout(m_scene.model, renderParts, getVertexFormat(), m_scene.drawParts, layout);
+  m_scene.layout      = layout;
+  m_scene.renderParts = renderParts;
+  computePartMemory(m_scene.drawParts, layout, m_scene.model, m_scene.partMemory);
+  m_pipeline.computePartBounds(m_scene.drawParts, renderParts, m_scene.partBounds);
+  m_pipeline.buildMeshlets(m_scene.drawParts, renderParts, m_scene.meshlets);
+  reportQuantizationErrors();
+  buildCullData();
+
+  // pack on the cpu in parallel over parts, directly into the staging mapping
+  uploadSceneBuffers(layout, [&](uint8_t* vertices, uint8_t* indices, LdrMaterialID* materials) {
+    m_pipeline.packSceneBuffers(m_scene.drawParts, layout, renderParts, vertices, indices, materials);
+  });
+}
+
+// a chamfer change rebuilds the render parts that can chamfer and leaves every other part as it was. The rebuilt
+// parts are repacked into the existing buffers of the render part geometry, the part geometry does not depend on
+// the chamfer. Returns false if a full rebuild is needed.
+bool Sample::updateChamferedParts(const std::vector<LdrPartID>& partIds)
+{
+  if(m_scene.blob.isOpen())
+    return false;
+
+  double time    = -m_profiler.getMicroSeconds();
+  bool   updated = true;
+  if(m_scene.renderParts) {
+    updated = updateSceneParts(partIds);
+  }
+  if(updated && m_scene.hasResident && m_scene.resident.renderParts) {
+    swapResidentGeometry();
+    updated = updateSceneParts(partIds);
+    swapResidentGeometry();
+  }
+  if(!updated)
+    return false;
+
+  applyDrawMode();
+  time += m_profiler.getMicroSeconds();
+  printf("chamfer update: %d parts repacked in %.2f ms\n", uint32_t(partIds.size()), time / 1000.0f);
+  return true;
+}
+
+// the rebuilt parts may change their vertices as well as their chamfered triangles, so their whole vertex, index
+// and material ranges are repacked. That only works while every part keeps its counts, and so every offset.
+bool Sample::updateSceneParts(const std::vector<LdrPartID>& partIds)
+{
+  SceneLayout           layout;
+  std::vector<DrawPart> drawParts;
+  m_pipeline.computeSceneLayout(m_scene.model, true, m_scene.layout.format, drawParts, layout);
+
+  bool sameLayout = drawParts.size() == m_scene.drawParts.size() && layout.vertexSize == m_scene.layout.vertexSize
+                    && layout.numVertices == m_scene.layout.numVertices && layout.numIndices == m_scene.layout.numIndices
+                    && layout.numIndices16 == m_scene.layout.numIndices16 && layout.numMaterials == m_scene.layout.numMaterials;
+  for(size_t i = 0; i < drawParts.size() && sameLayout; i++) {
+    // meshlet ranges are compared below, level errors may change freely
+    DrawPart&       drawPart = drawParts[i];
+    const DrawPart& current  = m_scene.drawParts[i];
+    drawPart.meshletOffset   = current.meshletOffset;
+    drawPart.meshletCount    = current.meshletCount;
+    drawPart.meshletOffsetC  = current.meshletOffsetC;
+    drawPart.meshletCountC   = current.meshletCountC;
+
+    DrawPart compare = drawPart;
+    memcpy(compare.lodError, current.lodError, sizeof(compare.lodError));
+    sameLayout = memcmp(&compare, &current, sizeof(DrawPart)) == 0;
+  }
+  if(!sameLayout) {
+    printf("chamfer update: part counts changed, rebuilding the scene buffers\n");
+    return false;
+  }
+
+  std::vector<LdrBbox>              partBounds(partIds.size());
+  std::vector<std::vector<Meshlet>> partMeshlets(partIds.size());
+  std::vector<std::vector<Meshlet>> partMeshletsC(partIds.size());
+  m_threadPool.parallelItems(uint32_t(partIds.size()), [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+      LdrPartID id  = partIds[i];
+      partBounds[i] = m_pipeline.computePartBounds(id, drawParts[id], true);
+      m_pipeline.buildPartMeshlets(id, drawParts[id], true, partMeshlets[i], partMeshletsC[i]);
     }
-    else {
-      const LdrRenderPart* rpart = ldrGetRenderPart(m_loader, i);
+  });
 
-      if(!rpart)
-        continue;
+  bool sameBounds = true;
+  for(size_t i = 0; i < partIds.size(); i++) {
+    const DrawPart& drawPart = drawParts[partIds[i]];
+    if(partMeshlets[i].size() != drawPart.meshletCount || partMeshletsC[i].size() != drawPart.meshletCountC) {
+      printf("chamfer update: meshlet counts changed, rebuilding the scene buffers\n");
+      return false;
+    }
+    sameBounds = sameBounds && memcmp(&partBounds[i], &m_scene.partBounds[partIds[i]], sizeof(LdrBbox)) == 0;
+  }
 
-      glNamedBufferSubData(m_scene.vertexBuffer, vertexSize * drawPart.vertexOffset, vertexSize * drawPart.vertexCount,
-                           rpart->vertices);
-      glNamedBufferSubData(m_scene.indexBuffer, sizeof(uint32_t) * drawPart.triangleOffset,
-                           sizeof(uint32_t) * drawPart.triangleCount * 3, rpart->triangles);
-      glNamedBufferSubData(m_scene.indexBuffer, sizeof(uint32_t) * drawPart.edgesOffset,
-                           sizeof(uint32_t) * drawPart.edgesCount * 2, rpart->lines);
+  size_t   indexOffset;
+  size_t   materialOffset;
+  size_t   stagingSize = getStagingOffsets(layout, indexOffset, materialOffset);
+  uint8_t* mapping     = mapUploadStaging(stagingSize);
+  if(!mapping)
+    return false;
+
+  // everything else keeps its data, inactive parts are skipped by the packing
+  std::vector<DrawPart> packParts(drawParts.size(), DrawPart());
+  for(LdrPartID id : partIds) {
+    packParts[id] = drawParts[id];
+  }
+  m_pipeline.packSceneBuffers(packParts, layout, true, mapping, mapping + indexOffset, (LdrMaterialID*)(mapping + materialOffset));
 
-      glNamedBufferSubData(m_scene.indexBuffer, sizeof(uint32_t) * drawPart.triangleOffsetC,
-                           sizeof(uint32_t) * drawPart.triangleCountC * 3, rpart->trianglesC);
+  size_t copyBytes = 0;
 
-      if(rpart->triangleMaterials && rpart->flags.hasComplexMaterial) {
-        glNamedBufferSubData(m_scene.materialIndexBuffer, sizeof(LdrMaterialID) * drawPart.materialIDOffset,
-                             sizeof(LdrMaterialID) * drawPart.triangleCount, rpart->triangleMaterials);
-      }
-      if(rpart->materialsC && rpart->flags.hasComplexMaterial) {
-        glNamedBufferSubData(m_scene.materialIndexBuffer, sizeof(LdrMaterialID) * drawPart.materialIDOffsetC,
-                             sizeof(LdrMaterialID) * drawPart.triangleCountC, rpart->materialsC);
-      }
+  auto copy = [&](GLuint buffer, size_t stagingOffset, size_t offset, size_t size) {
+    if(size) {
+      glCopyNamedBufferSubData(m_uploadStaging.buffer, buffer, stagingOffset + offset, offset, size);
+      copyBytes += size;
     }
+  };
+
+  if(!m_uploadStaging.query) {
+    glCreateQueries(GL_TIME_ELAPSED, 1, &m_uploadStaging.query);
   }
+  glBeginQuery(GL_TIME_ELAPSED, m_uploadStaging.query);
+  for(LdrPartID id : partIds) {
+    const DrawPart& drawPart = drawParts[id];
+
+    // the index ranges of a part are contiguous from its triangles up to its last level
+    size_t   indexSize  = (drawPart.flags & DRAWPART_INDEX16) ? sizeof(uint16_t) : sizeof(uint32_t);
+    uint32_t numIndices = drawPart.triangleCount * 3 + drawPart.edgesCount * 2 + drawPart.optionalCount * 2 + drawPart.triangleCountC * 3;
+    for(uint32_t l = 0; l < drawPart.lodLevels; l++) {
+      numIndices += drawPart.lodTriangleCount[l] * 3;
+    }
+    uint32_t numMaterials = ((drawPart.flags & DRAWPART_MATERIALS) ? drawPart.triangleCount : 0)
+                            + ((drawPart.flags & DRAWPART_MATERIALS_C) ? drawPart.triangleCountC : 0);
+
+    copy(m_scene.vertexBuffer, 0, layout.vertexSize * drawPart.vertexOffset, layout.vertexSize * drawPart.vertexCount);
+    copy(m_scene.indexBuffer, indexOffset, indexSize * drawPart.triangleOffset, indexSize * numIndices);
+    copy(m_scene.materialIndexBuffer, materialOffset, sizeof(LdrMaterialID) * drawPart.materialIDOffset,
+         sizeof(LdrMaterialID) * numMaterials);
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  m_uploadStaging.queryPending = true;
+  m_uploadStaging.copyBytes    = copyBytes;
+  m_uploadStaging.fence        = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  for(size_t i = 0; i < partIds.size(); i++) {
+    const DrawPart& drawPart = drawParts[partIds[i]];
+    std::copy(partMeshlets[i].begin(), partMeshlets[i].end(), m_scene.meshlets.begin() + drawPart.meshletOffset);
+    std::copy(partMeshletsC[i].begin(), partMeshletsC[i].end(), m_scene.meshlets.begin() + drawPart.meshletOffsetC);
+    m_scene.partBounds[partIds[i]] = partBounds[i];
+  }
+  m_scene.layout = layout;
+  m_scene.drawParts.swap(drawParts);
+  reportQuantizationErrors();
+  // the chamfer rarely moves the outer bounds, the hierarchy only follows if it does
+  if(!sameBounds) {
+    buildCullData();
+  }
+  return true;
 }
 
-void Sample::drawDebug()
+void Sample::swapResidentGeometry()
 {
-  if(!m_scene.model)
+  std::swap(static_cast<SceneGeometry&>(m_scene), m_scene.resident);
+}
+
+void Sample::deleteSceneGeometry(SceneGeometry& geometry)
+{
+  nvgl::deleteBuffer(geometry.vertexBuffer);
+  nvgl::deleteBuffer(geometry.indexBuffer);
+  nvgl::deleteBuffer(geometry.materialIndexBuffer);
+  nvgl::deleteBuffer(geometry.partBoundsBuffer);
+  geometry = SceneGeometry();
+}
+
+// the small per part data that follows drawRenderPart and chamfered, the geometry stays
+void Sample::applyDrawMode()
+{
+  m_scene.drawList.dirty  = true;
+  m_scene.multiDraw.dirty = true;
+
+  buildMeshletStats();
+  buildPartMaterials();
+  buildPartLods();
+}
+
+bool Sample::bakeSceneBlob(const std::string& filename)
+{
+  if(!m_scene.model || m_scene.blob.isOpen())
+    return false;
+
+  // the live scene keeps its own draw parts
+  SceneLayout           layout;
+  std::vector<DrawPart> drawParts;
+  m_pipeline.computeSceneLayout(m_scene.model, m_tweak.drawRenderPart, getVertexFormat(), drawParts, layout);
+
+  std::vector<LdrBbox> partBounds;
+  m_pipeline.computePartBounds(drawParts, m_tweak.drawRenderPart, partBounds);
+  std::vector<Meshlet> meshlets;
+  m_pipeline.buildMeshlets(drawParts, m_tweak.drawRenderPart, meshlets);
+
+  std::vector<uint8_t>       vertexData(layout.vertexSize * layout.numVertices);
+  std::vector<uint8_t>       indexData(layout.getIndexBytes());
+  std::vector<LdrMaterialID> materialData(layout.numMaterials);
+
+  m_pipeline.packSceneBuffers(drawParts, layout, m_tweak.drawRenderPart, vertexData.data(), indexData.data(), materialData.data());
+
+  LdrModelHDL                    model = m_scene.model;
+  std::vector<SceneBlobInstance> instances(model->numInstances);
+  for(uint32_t i = 0; i < model->numInstances; i++) {
+    instances[i].transform = model->instances[i].transform;
+    instances[i].part      = model->instances[i].part;
+    instances[i].material  = model->instances[i].material;
+  }
+
+  SceneBlobContent content;
+  content.options      = getSceneBlobOptions();
+  content.modelPath    = m_modelFilename;
+  content.drawPartSize = sizeof(DrawPart);
+  content.numDrawParts = uint32_t(drawParts.size());
+  content.drawParts    = drawParts.data();
+  content.numInstances = uint32_t(instances.size());
+  content.instances    = instances.data();
+  content.vertexSize   = uint32_t(layout.vertexSize);
+  content.numVertices  = layout.numVertices;
+  content.vertices     = vertexData.data();
+  content.numIndices   = layout.numIndices;
+  content.numIndices16 = layout.numIndices16;
+  content.indices      = indexData.data();
+  content.numMaterials = layout.numMaterials;
+  content.materials    = materialData.data();
+
+  content.numSplitVertices  = layout.splitVertices;
+  content.numSplitMaterials = layout.splitMaterials;
+  content.partBounds        = partBounds.data();
+  content.meshletSize       = sizeof(Meshlet);
+  content.numMeshlets       = uint32_t(meshlets.size());
+  content.meshlets          = meshlets.data();
+
+  bool success = SceneBlob::save(filename, content);
+  printf("bake scene blob %s: %d\n", filename.c_str(), success ? 1 : 0);
+  return success;
+}
+
+SceneVertexFormat Sample::getVertexFormat() const
+{
+  SceneVertexFormat format;
+  format.materials = m_tweak.vertexMaterials;
+  format.quantized = m_tweak.quantized;
+  return format;
+}
+
+void Sample::reportQuantizationErrors()
+{
+  m_scene.quantizationErrors.clear();
+  if(!m_scene.layout.format.quantized)
+    return;
+
+  std::vector<QuantizationError>& errors = m_scene.quantizationErrors;
+  m_pipeline.computeQuantizationErrors(m_scene.drawParts, m_scene.renderParts, errors);
+  std::sort(errors.begin(), errors.end(),
+            [](const QuantizationError& a, const QuantizationError& b) { return a.position > b.position; });
+
+  float normal = 0;
+  for(const QuantizationError& error : errors) {
+    normal = std::max(normal, error.normal);
+  }
+  printf("quantization: %d parts, max position error %.4f LDU, max normal error %.3f deg\n", uint32_t(errors.size()),
+         errors.empty() ? 0.0f : errors[0].position, normal);
+  for(size_t i = 0; i < std::min(errors.size(), size_t(5)); i++) {
+    const LdrPart* part = m_pipeline.getPart(errors[i].part);
+    printf("  %-24s position %.4f, normal %.3f\n", part && part->name ? part->name : "", errors[i].position, errors[i].normal);
+  }
+}
+
+void Sample::reportPartOptimizations()
+{
+  std::vector<PartOptimization> parts = m_pipeline.getPartOptimizations();
+  if(parts.empty())
     return;
 
+  OptimizedPart::Stats total;
+  for(const PartOptimization& opt : parts) {
+    total.before.add(opt.stats.before);
+    total.after.add(opt.stats.after);
+    total.renderBefore.add(opt.stats.renderBefore);
+    total.renderAfter.add(opt.stats.renderAfter);
+  }
+  printf("vertex cache (fifo %d): %d parts optimized\n", VERTEX_CACHE_SIZE, uint32_t(parts.size()));
+  printf("  part        ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", total.before.getAcmr(), total.after.getAcmr(), total.before.getAtvr(),
+         total.after.getAtvr());
+  printf("  render part ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", total.renderBefore.getAcmr(), total.renderAfter.getAcmr(),
+         total.renderBefore.getAtvr(), total.renderAfter.getAtvr());
+
+  // the parts that gained the most, by vertex transforms saved per draw
+  auto getSaved = [](const PartOptimization& opt) {
+    return int64_t(opt.stats.before.transformed) - int64_t(opt.stats.after.transformed) + int64_t(opt.stats.renderBefore.transformed)
+           - int64_t(opt.stats.renderAfter.transformed);
+  };
+  std::sort(parts.begin(), parts.end(), [&](const PartOptimization& a, const PartOptimization& b) { return getSaved(a) > getSaved(b); });
+  for(size_t i = 0; i < std::min(parts.size(), size_t(5)); i++) {
+    const PartOptimization& opt  = parts[i];
+    const LdrPart*          part = m_pipeline.getPart(opt.part);
+    printf("  %-24s ACMR %.3f -> %.3f, render ACMR %.3f -> %.3f\n", part && part->name ? part->name : "", opt.stats.before.getAcmr(),
+           opt.stats.after.getAcmr(), opt.stats.renderBefore.getAcmr(), opt.stats.renderAfter.getAcmr());
+  }
+}
+
+void Sample::reportPartLods()
+{
+  if(!m_tweak.partLods)
+    return;
+
+  // triangles of the instanced parts per level, a part without a level counts its previous one
+  LdrLoaderHDL loader   = m_pipeline.getLoader();
+  uint32_t     numParts = ldrGetNumRegisteredParts(loader);
+  for(int render = 0; render < 2; render++) {
+    uint64_t triangles[PART_LOD_LEVELS] = {};
+    uint32_t withLods                   = 0;
+    for(uint32_t p = 0; p < numParts; p++) {
+      const PartLodChain* lods = m_pipeline.getPartLods(p, render != 0);
+      if(!lods)
+        continue;
+
+      triangles[0] += render ? m_pipeline.getRenderPart(p)->numTriangles : m_pipeline.getPart(p)->numTriangles;
+      for(uint32_t l = 1; l < PART_LOD_LEVELS; l++) {
+        triangles[l] += lods->triangles[std::min(l, lods->numLevels) - 1].size() / 3;
+      }
+      withLods++;
+    }
+    printf("%s lods: %d parts, triangles %llu / %llu / %llu / %llu\n", render ? "render part" : "part", withLods,
+           (unsigned long long)triangles[0], (unsigned long long)triangles[1], (unsigned long long)triangles[2],
+           (unsigned long long)triangles[3]);
+  }
+}
+
+SceneBlobOptions Sample::getSceneBlobOptions() const
+{
+  SceneBlobOptions options;
+  options.partFixMode         = uint32_t(m_loaderCreateInfo.partFixMode);
+  options.partFixTjunctions   = uint32_t(m_loaderCreateInfo.partFixTjunctions);
+  options.partFixOverlap      = uint32_t(m_loaderCreateInfo.partFixOverlap);
+  options.partHiResPrimitives = uint32_t(m_loaderCreateInfo.partHiResPrimitives);
+  options.renderpartBuildMode = uint32_t(m_loaderCreateInfo.renderpartBuildMode);
+  options.renderpartChamfer   = m_loaderCreateInfo.renderpartChamfer;
+  options.drawRenderPart      = m_tweak.drawRenderPart ? 1 : 0;
+  options.vertexMaterials     = m_tweak.vertexMaterials ? 1 : 0;
+  options.quantizedVertices   = m_tweak.quantized ? 1 : 0;
+  options.optimizedParts      = m_tweak.optimizeParts ? 1 : 0;
+  options.partLods            = m_tweak.partLods ? 1 : 0;
+  return options;
+}
+
+bool Sample::openSceneBlob(const std::string& filename)
+{
+  double time = -m_profiler.getMicroSeconds();
+
+  if(!m_scene.blob.open(filename))
+    return false;
+
+  const SceneBlobHeader& header = m_scene.blob.getHeader();
+
+  // a rejected blob falls back to loading its model
+  m_modelFilename = m_scene.blob.getModelPath();
+
+  // the draw mode is taken from the blob, everything else must match the current settings
+  SceneBlobOptions options  = getSceneBlobOptions();
+  options.drawRenderPart    = header.options.drawRenderPart;
+  options.vertexMaterials   = header.options.vertexMaterials;
+  options.quantizedVertices = header.options.quantizedVertices;
+  options.optimizedParts    = header.options.optimizedParts;
+  options.partLods          = header.options.partLods;
+
+  std::string reason;
+  if(!m_scene.blob.isCompatible(options, reason)) {
+    printf("scene blob %s rejected: %s\n", filename.c_str(), reason.c_str());
+    m_scene.blob.close();
+    return false;
+  }
+
+  m_tweak.drawRenderPart      = header.options.drawRenderPart != 0;
+  m_tweakLast.drawRenderPart  = m_tweak.drawRenderPart;
+  m_tweak.vertexMaterials     = header.options.vertexMaterials != 0;
+  m_tweakLast.vertexMaterials = m_tweak.vertexMaterials;
+  m_tweak.quantized           = header.options.quantizedVertices != 0;
+  m_tweakLast.quantized       = m_tweak.quantized;
+  m_tweak.optimizeParts       = header.options.optimizedParts != 0;
+  m_tweakLast.optimizeParts   = m_tweak.optimizeParts;
+  m_tweak.partLods            = header.options.partLods != 0;
+  m_tweakLast.partLods        = m_tweak.partLods;
+
+  const SceneBlobInstance* instances = m_scene.blob.getSection<SceneBlobInstance>(header.instancesOffset);
+  m_scene.blobInstances.resize(header.numInstances);
+  for(uint32_t i = 0; i < header.numInstances; i++) {
+    LdrInstance& instance = m_scene.blobInstances[i];
+    memset(&instance, 0, sizeof(instance));
+    instance.transform = instances[i].transform;
+    instance.part      = instances[i].part;
+    instance.material  = instances[i].material;
+  }
+
+  memset(&m_scene.blobModel, 0, sizeof(m_scene.blobModel));
+  m_scene.blobModel.instances    = m_scene.blobInstances.data();
+  m_scene.blobModel.numInstances = header.numInstances;
+  m_scene.model                  = &m_scene.blobModel;
+
+  time += m_profiler.getMicroSeconds();
+  printf("scene blob open %.2f ms (%d instances, %d parts)\n", time / 1000.0f, header.numInstances, header.numDrawParts);
+
+  return true;
+}
+
+void Sample::beginDraw(GLuint program)
+{
   glBindVertexArray(m_common.vao);
 
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_CULL_FACE);
-  glUseProgram(m_progManager.get(programs.draw_scene));
+  glUseProgram(program);
 
   glEnableVertexAttribArray(VERTEX_POS);
   if(m_tweak.drawRenderPart)
@@ -912,20 +2010,14 @@ void Sample::drawDebug()
   glLineStipple(2, 0xAAAA);
 
   glBindBufferBase(GL_UNIFORM_BUFFER, UBO_SCENE, m_common.viewBuffer);
-  glBindBufferBase(GL_UNIFORM_BUFFER, UBO_OBJECT, m_common.objectBuffer);
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_MATERIALS, m_common.materialsBuffer);
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_MATERIALIDS, m_scene.materialIndexBuffer);
-
-  bool cullFace = true;
-  bool ccw      = true;
-
-  float lineWidthScale = 2.0f;
-  float lineWidthBase  = 1.0f;
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_INSTANCES, m_scene.instanceBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_PARTMATERIALS, m_scene.partMaterialBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_PARTBOUNDS, m_scene.partBoundsBuffer);
 
   glFrontFace(GL_CCW);
-  glLineWidth(lineWidthBase);
-
-  srand(1123);
+  glLineWidth(1.0f);
 
   if(m_tweak.transparency) {
     glEnable(GL_BLEND);
@@ -936,196 +2028,982 @@ void Sample::drawDebug()
     glDisable(GL_BLEND);
   }
 
-  float wireColor = 0.5f;
-
   glBindBuffer(GL_ARRAY_BUFFER, m_scene.vertexBuffer);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_scene.indexBuffer);
 
-  if(!m_tweak.drawRenderPart) {
+  GLsizei stride = GLsizei(m_scene.layout.vertexSize);
+  if(m_scene.layout.format.quantized) {
+    // the shader decodes against the part bounds
+    glVertexAttribPointer(VERTEX_POS, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (const void*)offsetof(QuantizedRenderVertex, position));
+    if(m_tweak.drawRenderPart) {
+      glVertexAttribPointer(VERTEX_NORMAL, 2, GL_SHORT, GL_TRUE, stride, (const void*)offsetof(QuantizedRenderVertex, normal));
+    }
+  }
+  else if(!m_tweak.drawRenderPart) {
 
-    glVertexAttribPointer(VERTEX_POS, 3, GL_FLOAT, GL_FALSE, sizeof(LdrVector), 0);
+    glVertexAttribPointer(VERTEX_POS, 3, GL_FLOAT, GL_FALSE, stride, 0);
   }
   else {
-    glVertexAttribPointer(VERTEX_POS, 3, GL_FLOAT, GL_FALSE, sizeof(LdrRenderVertex),
-                          (const void*)offsetof(LdrRenderVertex, position));
-    glVertexAttribPointer(VERTEX_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(LdrRenderVertex),
-                          (const void*)offsetof(LdrRenderVertex, normal));
+    glVertexAttribPointer(VERTEX_POS, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(LdrRenderVertex, position));
+    glVertexAttribPointer(VERTEX_NORMAL, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(LdrRenderVertex, normal));
   }
 
-  glBindBuffer(GL_UNIFORM_BUFFER, m_common.objectBuffer);
+  // the material is the last member of the vertex, without it the shader sees the inherit material
+  if(m_scene.layout.format.materials) {
+    glEnableVertexAttribArray(VERTEX_MATERIALID);
+    glVertexAttribIPointer(VERTEX_MATERIALID, 1, GL_UNSIGNED_INT, stride, (const void*)(size_t(stride) - sizeof(LdrMaterialID)));
+  }
+  else {
+    glVertexAttribI4ui(VERTEX_MATERIALID, LDR_MATERIALID_INHERIT, 0, 0, 0);
+  }
 
   glUniform1f(UNI_COLORMUL, 1.0f);
   glUniform1i(UNI_LIGHTING, 0);
-  glUniform1ui(UNI_MATERIALID, LDR_MATERIALID_INHERIT);
-  glUniform1ui(UNI_MATERIALIDOFFSET, ~0);
+  glUniform1i(UNI_PARTMATERIALS, 0);
+  glUniform1i(UNI_QUANTIZED, m_scene.layout.format.quantized ? 1 : 0);
+  m_drawState = 0;
+}
+
+void Sample::endDraw()
+{
+  glDisableVertexAttribArray(VERTEX_POS);
+  glDisableVertexAttribArray(VERTEX_NORMAL);
+  glDisableVertexAttribArray(VERTEX_MATERIALID);
+
+  glBindBufferBase(GL_UNIFORM_BUFFER, UBO_SCENE, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_MATERIALIDS, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_MATERIALS, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_INSTANCES, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_PARTMATERIALS, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_PARTBOUNDS, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  glLineWidth(1);
+  glPointSize(1);
+  glDisable(GL_LINE_STIPPLE);
+  glUseProgram(0);
+
+  glBindVertexArray(0);
+}
+
+void Sample::buildDrawList()
+{
+  DrawList& drawList = m_scene.drawList;
+  drawList.keys.clear();
+  drawList.dirty = false;
 
   LdrModelHDL model = m_scene.model;
   for(uint32_t i = 0; i < model->numInstances; i++) {
-    const LdrInstance*   instance = &model->instances[i];
-    const LdrPart*       part     = ldrGetPart(m_loader, instance->part);
-    const LdrRenderPart* rpart    = ldrGetRenderPart(m_loader, instance->part);
-    const DrawPart&      drawPart = m_scene.drawParts[instance->part];
+    const LdrInstance* instance = &model->instances[i];
+    if(instance->part == LDR_INVALID_ID)
+      continue;
+
+    const DrawPart& drawPart = m_scene.drawParts[instance->part];
 
     if(m_tweak.instance >= 0 && i != (uint32_t)m_tweak.instance)
       continue;
 
-    if(!part || m_tweak.part >= 0 && instance->part != m_tweak.part)
+    if(!(drawPart.flags & DRAWPART_ACTIVE) || (m_tweak.part >= 0 && instance->part != LdrPartID(m_tweak.part)))
       continue;
 
-    glsldata::ObjectData obj;
-    obj.color = {nvh::frand(), nvh::frand(), nvh::frand(), 1.0f};
+    if(m_tweak.drawRenderPart && !(drawPart.flags & DRAWPART_RENDERPART))
+      continue;
 
-    memcpy(obj.worldMatrix.mat_array, &instance->transform, sizeof(LdrMatrix));
-    obj.worldMatrixIT = nvmath::transpose(nvmath::invert(obj.worldMatrix));
-    float det         = nvmath::det(obj.worldMatrix);
+    bool useChamfer = m_tweak.drawRenderPart && m_tweak.chamfered && (drawPart.flags & DRAWPART_CAN_CHAMFER);
+    bool noCull     = !m_tweak.cull || (drawPart.flags & DRAWPART_NO_BACKFACE_CULLING);
+    bool materials  = (drawPart.flags & (useChamfer ? DRAWPART_MATERIALS_C : DRAWPART_MATERIALS)) != 0;
 
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glsldata::ObjectData), &obj);
+    uint64_t key = uint64_t(i) | (uint64_t(instance->part) << DRAWKEY_PART_SHIFT);
+    key |= noCull ? DRAWKEY_NOCULL : 0;
+    key |= m_scene.instances[i].winding > 0 ? 0 : DRAWKEY_CW;
+    key |= materials ? DRAWKEY_MATERIALS : 0;
+    drawList.keys.push_back(key);
+  }
 
-    glUniform1ui(UNI_MATERIALID, instance->material);
+  // instance index in the low bits keeps file order within a part
+  std::sort(drawList.keys.begin(), drawList.keys.end());
 
-    if(cullFace != !(bool(part->flags.hasNoBackFaceCulling) || !m_tweak.cull)) {
-      if(cullFace) {
-        glDisable(GL_CULL_FACE);
-      }
-      else {
-        glEnable(GL_CULL_FACE);
-      }
-      cullFace = !(bool(part->flags.hasNoBackFaceCulling) || !m_tweak.cull);
+  // the sorted copy of the instance table lets each run of a part be drawn instanced
+  std::vector<glsldata::InstanceData> instances(drawList.keys.size());
+  for(size_t k = 0; k < drawList.keys.size(); k++) {
+    instances[k] = m_scene.instances[uint32_t(drawList.keys[k])];
+  }
+
+  nvgl::newBuffer(drawList.instanceBuffer);
+  if(!instances.empty()) {
+    glNamedBufferStorage(drawList.instanceBuffer, sizeof(glsldata::InstanceData) * instances.size(), instances.data(), 0);
+  }
+
+  buildDrawBatches(nullptr);
+}
+
+void Sample::buildDrawBatches(const uint8_t* visible)
+{
+  DrawList& drawList = m_scene.drawList;
+  drawList.single.clear();
+  drawList.instanced.clear();
+  m_lodStats = LodStats();
+
+  bool lods = useLods();
+
+  // instances of one part with equal state and level are adjacent, each visible run becomes one instanced draw
+  size_t lastK = ~size_t(0);
+  for(size_t k = 0; k < drawList.keys.size(); k++) {
+    uint64_t key = drawList.keys[k];
+    uint32_t i   = uint32_t(key);
+    uint32_t run = uint32_t(key >> DRAWKEY_PART_SHIFT);
+    if(visible && !visible[i])
+      continue;
+
+    uint32_t part = m_scene.instances[i].part;
+    uint32_t lod  = lods ? selectLod(i) : 0;
+    drawList.single.push_back({key, part, i, 1, lod});
+
+    if(lods) {
+      uint32_t offset;
+      uint32_t full;
+      uint32_t count;
+      getTriangleRange(m_scene.drawParts[part], 0, offset, full);
+      getTriangleRange(m_scene.drawParts[part], lod, offset, count);
+      m_lodStats.instances[lod]++;
+      m_lodStats.triangles += count;
+      m_lodStats.fullTriangles += full;
     }
 
-    if(ccw != det > 0) {
-      glFrontFace(det > 0 ? GL_CCW : GL_CW);
-      ccw = det > 0;
+    const DrawBatch* last = drawList.instanced.empty() ? nullptr : &drawList.instanced.back();
+    if(!last || lastK + 1 != k || uint32_t(last->key >> DRAWKEY_PART_SHIFT) != run || last->lod != lod) {
+      drawList.instanced.push_back({key, part, uint32_t(k), 0, lod});
     }
+    drawList.instanced.back().numInstances++;
+    lastK = k;
+  }
+}
 
-    if(!m_tweak.drawRenderPart) {
-      glUniform1i(UNI_LIGHTING, 0);
-      glUniform1f(UNI_COLORMUL, 1.0f);
+void Sample::buildCullData()
+{
+  double time = -m_profiler.getMicroSeconds();
+  m_scene.bvh.build(m_threadPool, m_scene.model, m_scene.partBounds);
+  time += m_profiler.getMicroSeconds();
+  printf("instance bvh %.2f ms (%d nodes)\n", time / 1000.0f, m_scene.bvh.getNumNodes());
+
+  // same bounds for the cull shader
+  std::vector<glsldata::PartBounds> bounds(std::max(m_scene.partBounds.size(), size_t(1)));
+  for(size_t i = 0; i < m_scene.partBounds.size(); i++) {
+    const LdrBbox& bbox = m_scene.partBounds[i];
+    bounds[i].bboxMin   = {bbox.min.x, bbox.min.y, bbox.min.z, 1.0f};
+    bounds[i].bboxMax   = {bbox.max.x, bbox.max.y, bbox.max.z, 1.0f};
+  }
 
-      if(m_tweak.triangles) {
-        if(part->triangleMaterials && part->flags.hasComplexMaterial)
-          glUniform1ui(UNI_MATERIALIDOFFSET, drawPart.materialIDOffset);
+  nvgl::newBuffer(m_scene.partBoundsBuffer);
+  glNamedBufferStorage(m_scene.partBoundsBuffer, sizeof(glsldata::PartBounds) * bounds.size(), bounds.data(), 0);
+}
 
-        glDrawElementsBaseVertex(GL_TRIANGLES, part->numTriangles * 3, GL_UNSIGNED_INT,
-                                 (const void*)(sizeof(uint32_t) * drawPart.triangleOffset), drawPart.vertexOffset);
-        if(part->triangleMaterials && part->flags.hasComplexMaterial)
-          glUniform1ui(UNI_MATERIALIDOFFSET, ~0);
-      }
-      glUniform1f(UNI_COLORMUL, 0.2f);
-      if(m_tweak.edges) {
-        glLineWidth(lineWidthBase * lineWidthScale);
-        glDrawElementsBaseVertex(GL_LINES, part->numLines * 2, GL_UNSIGNED_INT,
-                                 (const void*)(sizeof(uint32_t) * drawPart.edgesOffset), drawPart.vertexOffset);
-      }
+void Sample::cullScene()
+{
+  if(!m_scene.model)
+    return;
 
-      if(m_tweak.optional) {
-        glLineWidth(lineWidthBase * lineWidthScale);
-        glLineStipple(4, 0xAAAA);
-        glEnable(GL_LINE_STIPPLE);
-        glDrawElementsBaseVertex(GL_LINES, part->numOptionalLines * 2, GL_UNSIGNED_INT,
-                                 (const void*)(sizeof(uint32_t) * drawPart.optionalOffset), drawPart.vertexOffset);
-        glDisable(GL_LINE_STIPPLE);
-      }
+  if(m_scene.drawList.dirty) {
+    buildDrawList();
+  }
+
+  // also runs every frame for lods alone, their levels follow the camera
+  if(m_tweak.frustumCull) {
+    Frustum frustum;
+    frustum.init(m_viewUbo.viewProjMatrix.mat_array);
+    m_scene.bvh.cullFrustum(frustum, m_scene.visible, m_cullStats);
+  }
+
+  buildDrawBatches(m_tweak.frustumCull ? m_scene.visible.data() : nullptr);
+}
+
+bool Sample::useLods() const
+{
+  return m_tweak.lods && m_scene.hasLods;
+}
+
+// mirrors selectLod in cull.comp.glsl, the last level whose error projected to the part's
+// nearest bounding sphere point stays below lodPixelError
+uint32_t Sample::selectLod(uint32_t instance) const
+{
+  const glsldata::InstanceData& obj      = m_scene.instances[instance];
+  const DrawPart&               drawPart = m_scene.drawParts[obj.part];
+  if(!drawPart.lodLevels)
+    return 0;
+
+  const float*   world     = obj.worldMatrix.mat_array;
+  const float*   cameraPos = &m_viewUbo.viewMatrixI.mat_array[12];
+  const LdrBbox& bbox      = m_scene.partBounds[obj.part];
+
+  float local[3]  = {(bbox.min.x + bbox.max.x) * 0.5f, (bbox.min.y + bbox.max.y) * 0.5f, (bbox.min.z + bbox.max.z) * 0.5f};
+  float extent[3] = {bbox.max.x - bbox.min.x, bbox.max.y - bbox.min.y, bbox.max.z - bbox.min.z};
+
+  float scale = 0;
+  float dist  = 0;
+  for(int c = 0; c < 3; c++) {
+    scale = std::max(scale, std::sqrt(world[c * 4 + 0] * world[c * 4 + 0] + world[c * 4 + 1] * world[c * 4 + 1]
+                                      + world[c * 4 + 2] * world[c * 4 + 2]));
+    float center = world[0 * 4 + c] * local[0] + world[1 * 4 + c] * local[1] + world[2 * 4 + c] * local[2] + world[3 * 4 + c];
+    dist += (center - cameraPos[c]) * (center - cameraPos[c]);
+  }
+  float radius = std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]) * 0.5f * scale;
+  dist         = std::max(std::sqrt(dist) - radius, 1e-4f);
+  float pixels = scale * m_viewUbo.lodScale / dist;
+
+  uint32_t level = 0;
+  while(level < drawPart.lodLevels && drawPart.lodError[level] * pixels <= m_viewUbo.lodPixelError) {
+    level++;
+  }
+  return level;
+}
+
+void Sample::applyDrawState(uint64_t key, uint64_t mask)
+{
+  uint64_t changed = (m_drawState ^ key) & mask;
+  if(changed & DRAWKEY_NOCULL) {
+    if(key & DRAWKEY_NOCULL) {
+      glDisable(GL_CULL_FACE);
+    }
+    else {
+      glEnable(GL_CULL_FACE);
+    }
+    m_stateChanges++;
+  }
+  if(changed & DRAWKEY_CW) {
+    glFrontFace(key & DRAWKEY_CW ? GL_CW : GL_CCW);
+    m_stateChanges++;
+  }
+  if(changed & DRAWKEY_MATERIALS) {
+    glUniform1i(UNI_PARTMATERIALS, key & DRAWKEY_MATERIALS ? 1 : 0);
+    m_stateChanges++;
+  }
+  m_drawState = (m_drawState & ~changed) | (key & changed);
+}
+
+// level 0 is the full range of the draw mode, simplified levels replace the chamfered triangles as well
+void Sample::getTriangleRange(const DrawPart& drawPart, uint32_t lod, uint32_t& offset, uint32_t& count) const
+{
+  bool useChamfer = m_tweak.drawRenderPart && m_tweak.chamfered && (drawPart.flags & DRAWPART_CAN_CHAMFER);
+  if(lod) {
+    offset = drawPart.lodTriangleOffset[lod - 1];
+    count  = drawPart.lodTriangleCount[lod - 1];
+  }
+  else {
+    offset = useChamfer ? drawPart.triangleOffsetC : drawPart.triangleOffset;
+    count  = useChamfer ? drawPart.triangleCountC : drawPart.triangleCount;
+  }
+}
 
-      if(m_tweak.wireframe) {
-        glLineWidth(lineWidthBase);
-        glUniform1f(UNI_COLORMUL, wireColor);
-        glLineStipple(2, 0xAAAA);
-        glEnable(GL_LINE_STIPPLE);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDrawElementsBaseVertex(GL_TRIANGLES, part->numTriangles * 3, GL_UNSIGNED_INT,
-                                 (const void*)(sizeof(uint32_t) * drawPart.triangleOffset), drawPart.vertexOffset);
-        glDisable(GL_LINE_STIPPLE);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+void Sample::drawDebug(bool instanced)
+{
+  if(!m_scene.model)
+    return;
+
+  if(m_scene.drawList.dirty) {
+    buildDrawList();
+  }
+
+  const DrawList&               drawList = m_scene.drawList;
+  const std::vector<DrawBatch>& batches  = instanced ? drawList.instanced : drawList.single;
+
+  beginDraw(m_progManager.get(programs.draw_scene));
+
+  // instanced batches index the part-grouped copy of the instance table
+  if(instanced) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_INSTANCES, drawList.instanceBuffer);
+  }
+
+  float lineWidthScale = 2.0f;
+  float lineWidthBase  = 1.0f;
+  float wireColor      = 0.5f;
+
+  auto drawTriangles = [&](uint64_t mask) {
+    for(const DrawBatch& batch : batches) {
+      const DrawPart& drawPart = m_scene.drawParts[batch.part];
+
+      uint32_t triangles;
+      uint32_t numTriangles;
+      getTriangleRange(drawPart, batch.lod, triangles, numTriangles);
+      if(!numTriangles)
+        continue;
+
+      applyDrawState(batch.key, mask);
+      glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, numTriangles * 3, getIndexType(drawPart),
+                                                    (const void*)(getIndexSize(drawPart) * triangles), batch.numInstances,
+                                                    drawPart.vertexOffset, batch.firstInstance);
+      m_drawCalls++;
+      m_drawInstances += batch.numInstances;
+    }
+  };
+  auto drawLines = [&](bool optional) {
+    for(const DrawBatch& batch : batches) {
+      const DrawPart& drawPart = m_scene.drawParts[batch.part];
+
+      uint32_t lines    = optional ? drawPart.optionalOffset : drawPart.edgesOffset;
+      uint32_t numLines = optional ? drawPart.optionalCount : drawPart.edgesCount;
+      if(!numLines)
+        continue;
+
+      glDrawElementsInstancedBaseVertexBaseInstance(GL_LINES, numLines * 2, getIndexType(drawPart),
+                                                    (const void*)(getIndexSize(drawPart) * lines), batch.numInstances,
+                                                    drawPart.vertexOffset, batch.firstInstance);
+      m_drawCalls++;
+      m_drawInstances += batch.numInstances;
+    }
+  };
+
+  // pass after pass over the sorted list, state only changes between runs
+  glUniform1i(UNI_LIGHTING, m_tweak.drawRenderPart ? 1 : 0);
+  glUniform1f(UNI_COLORMUL, 1.0f);
+  if(m_tweak.triangles) {
+    drawTriangles(DRAWKEY_NOCULL | DRAWKEY_CW | DRAWKEY_MATERIALS);
+    applyDrawState(0, DRAWKEY_MATERIALS);
+  }
+
+  glUniform1i(UNI_LIGHTING, 0);
+  glUniform1f(UNI_COLORMUL, 0.2f);
+  if(m_tweak.edges) {
+    glLineWidth(lineWidthBase * lineWidthScale);
+    drawLines(false);
+  }
+
+  if(m_tweak.optional && !m_tweak.drawRenderPart) {
+    glLineWidth(lineWidthBase * lineWidthScale);
+    glLineStipple(4, 0xAAAA);
+    glEnable(GL_LINE_STIPPLE);
+    drawLines(true);
+    glDisable(GL_LINE_STIPPLE);
+  }
+
+  if(m_tweak.wireframe) {
+    glLineWidth(lineWidthBase);
+    glUniform1f(UNI_COLORMUL, wireColor);
+    glLineStipple(2, 0xAAAA);
+    glEnable(GL_LINE_STIPPLE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    drawTriangles(DRAWKEY_NOCULL | DRAWKEY_CW);
+    glDisable(GL_LINE_STIPPLE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  }
+
+  for(const DrawBatch& batch : batches) {
+    if(batch.part != uint32_t(m_tweak.part))
+      continue;
+
+    const DrawPart& drawPart = m_scene.drawParts[batch.part];
+    applyDrawState(batch.key, DRAWKEY_NOCULL | DRAWKEY_CW);
+
+    if(m_tweak.vertex >= 0) {
+      glUniform1f(UNI_COLORMUL, 2.0f);
+      glDrawArraysInstancedBaseInstance(GL_POINTS, m_tweak.vertex + drawPart.vertexOffset, 1, batch.numInstances, batch.firstInstance);
+    }
+    if(m_tweak.tri >= 0) {
+      glUniform1f(UNI_COLORMUL, 1.7f);
+      glLineWidth(lineWidthBase * 3 * lineWidthScale);
+      glEnable(GL_LINE_STIPPLE);
+      glLineStipple(3, 0xAAAA);
+      glDrawElementsInstancedBaseVertexBaseInstance(GL_LINE_LOOP, 3, getIndexType(drawPart),
+                                                    (const void*)(getIndexSize(drawPart) * (drawPart.triangleOffset + (m_tweak.tri * 3))),
+                                                    batch.numInstances, drawPart.vertexOffset, batch.firstInstance);
+      glDisable(GL_LINE_STIPPLE);
+    }
+    if(m_tweak.edge >= 0) {
+      glUniform1f(UNI_COLORMUL, 2.0f);
+      glLineWidth(lineWidthBase * 2 * lineWidthScale);
+      glDrawElementsInstancedBaseVertexBaseInstance(GL_LINES, 2, getIndexType(drawPart),
+                                                    (const void*)(getIndexSize(drawPart) * (drawPart.edgesOffset + (m_tweak.edge * 2))),
+                                                    batch.numInstances, drawPart.vertexOffset, batch.firstInstance);
+    }
+  }
+
+  endDraw();
+}
+
+void Sample::buildMultiDraw()
+{
+  MultiDraw& multiDraw = m_scene.multiDraw;
+  multiDraw.highlights.clear();
+  multiDraw.dirty = false;
+
+  LdrModelHDL model = m_scene.model;
+
+  std::vector<DrawIndirectCommand> ranges[NUM_INDEXTYPES][NUM_CULLRANGES];
+
+  for(uint32_t i = 0; i < model->numInstances; i++) {
+    const LdrInstance* instance = &model->instances[i];
+    if(instance->part == LDR_INVALID_ID)
+      continue;
+
+    const DrawPart& drawPart = m_scene.drawParts[instance->part];
+
+    if(m_tweak.instance >= 0 && i != (uint32_t)m_tweak.instance)
+      continue;
+
+    if(!(drawPart.flags & DRAWPART_ACTIVE) || (m_tweak.part >= 0 && instance->part != LdrPartID(m_tweak.part)))
+      continue;
+
+    if(m_tweak.drawRenderPart && !(drawPart.flags & DRAWPART_RENDERPART))
+      continue;
+
+    bool     useChamfer   = m_tweak.drawRenderPart && m_tweak.chamfered && (drawPart.flags & DRAWPART_CAN_CHAMFER);
+    uint32_t triOffset    = useChamfer ? drawPart.triangleOffsetC : drawPart.triangleOffset;
+    uint32_t numTriangles = useChamfer ? drawPart.triangleCountC : drawPart.triangleCount;
+
+    bool cull   = m_tweak.cull && !(drawPart.flags & DRAWPART_NO_BACKFACE_CULLING);
+    int  bucket = (cull ? 0 : 2) + (m_scene.instances[i].winding > 0 ? 0 : 1);
+
+    // firstIndex counts in the part's index type, which the DrawPart offsets already do
+    std::vector<DrawIndirectCommand>* typeRanges = ranges[(drawPart.flags & DRAWPART_INDEX16) ? INDEXTYPE_16 : INDEXTYPE_32];
+
+    if(numTriangles) {
+      typeRanges[bucket].push_back({numTriangles * 3, 1, triOffset, drawPart.vertexOffset, i});
+    }
+    if(drawPart.edgesCount) {
+      typeRanges[CULLRANGE_EDGES].push_back({drawPart.edgesCount * 2, 1, drawPart.edgesOffset, drawPart.vertexOffset, i});
+    }
+    if(!m_tweak.drawRenderPart && drawPart.optionalCount) {
+      typeRanges[CULLRANGE_OPTIONAL].push_back({drawPart.optionalCount * 2, 1, drawPart.optionalOffset, drawPart.vertexOffset, i});
+    }
+    if(instance->part == LdrPartID(m_tweak.part)) {
+      multiDraw.highlights.push_back(i);
+    }
+  }
+
+  std::vector<DrawIndirectCommand> commands;
+  for(uint32_t t = 0; t < NUM_INDEXTYPES; t++) {
+    for(uint32_t r = 0; r < NUM_CULLRANGES; r++) {
+      multiDraw.ranges[t][r] = {uint32_t(commands.size()), uint32_t(ranges[t][r].size())};
+      commands.insert(commands.end(), ranges[t][r].begin(), ranges[t][r].end());
+    }
+  }
+
+  nvgl::newBuffer(multiDraw.indirectBuffer);
+  nvgl::newBuffer(multiDraw.culledBuffer);
+  nvgl::newBuffer(multiDraw.counterBuffer);
+  nvgl::newBuffer(multiDraw.remainderBuffer);
+  nvgl::newBuffer(multiDraw.visibilityBuffer);
+  if(!commands.empty()) {
+    // nothing counts as visible until the first occlusion pass
+    std::vector<uint32_t> visibility(commands.size(), 0);
+    glNamedBufferStorage(multiDraw.indirectBuffer, sizeof(DrawIndirectCommand) * commands.size(), commands.data(), 0);
+    glNamedBufferStorage(multiDraw.culledBuffer, sizeof(DrawIndirectCommand) * commands.size(), nullptr, 0);
+    glNamedBufferStorage(multiDraw.remainderBuffer, sizeof(DrawIndirectCommand) * commands.size(), nullptr, 0);
+    glNamedBufferStorage(multiDraw.visibilityBuffer, sizeof(uint32_t) * commands.size(), visibility.data(), 0);
+  }
+  glNamedBufferStorage(multiDraw.counterBuffer, sizeof(uint32_t) * NUM_CULLCOUNTERS, nullptr, 0);
+}
+
+void Sample::buildMeshletStats()
+{
+  MeshletStats& stats = m_scene.meshletStats;
+  stats               = MeshletStats();
+  for(const DrawPart& drawPart : m_scene.drawParts) {
+    if(!(drawPart.flags & DRAWPART_ACTIVE))
+      continue;
+
+    bool useChamfer = m_tweak.drawRenderPart && m_tweak.chamfered && (drawPart.flags & DRAWPART_CAN_CHAMFER);
+    if(useChamfer) {
+      stats.add(m_scene.meshlets.data() + drawPart.meshletOffsetC, drawPart.meshletCountC);
+    }
+    else {
+      stats.add(m_scene.meshlets.data() + drawPart.meshletOffset, drawPart.meshletCount);
+    }
+  }
+}
+
+void Sample::cullMeshlets()
+{
+  if(!m_scene.model)
+    return;
+
+  double time = -m_profiler.getMicroSeconds();
+
+  LdrModelHDL model = m_scene.model;
+
+  // instances first, through the same hierarchy as the classic renderer
+  Frustum frustum;
+  frustum.init(m_viewUbo.viewProjMatrix.mat_array);
+  if(m_tweak.frustumCull) {
+    m_scene.bvh.cullFrustum(frustum, m_scene.visible, m_cullStats);
+  }
+  const float* cameraPos = &m_viewUbo.viewMatrixI.mat_array[12];
+
+  m_meshletCullOutputs.resize(std::max(m_threadPool.getNumWorkers(), 1u));
+  for(MeshletCullOutput& output : m_meshletCullOutputs) {
+    for(uint32_t t = 0; t < NUM_INDEXTYPES; t++) {
+      for(uint32_t r = 0; r < NUM_CULLRANGES; r++) {
+        output.ranges[t][r].clear();
       }
     }
-    else if(rpart) {
+    output.highlights.clear();
+    output.stats = MeshletCullStats();
+    output.lods  = LodStats();
+  }
+  bool lods = useLods();
 
-      uint32_t triangles = m_tweak.chamfered && rpart->flags.canChamfer ? drawPart.triangleOffsetC : drawPart.triangleOffset;
-      uint32_t numTriangles = m_tweak.chamfered && rpart->flags.canChamfer ? rpart->numTrianglesC : rpart->numTriangles;
-      const LdrMaterialID* triangleMaterials =
-          m_tweak.chamfered && rpart->flags.canChamfer ? rpart->materialsC : rpart->triangleMaterials;
-      uint32_t material_offset = m_tweak.chamfered && rpart->flags.canChamfer ? drawPart.materialIDOffsetC : drawPart.materialIDOffset;
+  m_threadPool.parallelItems(model->numInstances, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+    MeshletCullOutput& output = m_meshletCullOutputs[worker];
+
+    for(uint32_t i = begin; i < end; i++) {
+      const LdrInstance* instance = &model->instances[i];
+      if(instance->part == LDR_INVALID_ID || (m_tweak.frustumCull && !m_scene.visible[i]))
+        continue;
+
+      const DrawPart& drawPart = m_scene.drawParts[instance->part];
+
+      // same selection as buildMultiDraw
+      if(m_tweak.instance >= 0 && i != (uint32_t)m_tweak.instance)
+        continue;
+
+      if(!(drawPart.flags & DRAWPART_ACTIVE) || (m_tweak.part >= 0 && instance->part != LdrPartID(m_tweak.part)))
+        continue;
+
+      if(m_tweak.drawRenderPart && !(drawPart.flags & DRAWPART_RENDERPART))
+        continue;
 
-      glUniform1i(UNI_LIGHTING, 1);
-      glUniform1f(UNI_COLORMUL, 1.0f);
+      bool     useChamfer    = m_tweak.drawRenderPart && m_tweak.chamfered && (drawPart.flags & DRAWPART_CAN_CHAMFER);
+      uint32_t triOffset     = useChamfer ? drawPart.triangleOffsetC : drawPart.triangleOffset;
+      uint32_t meshletOffset = useChamfer ? drawPart.meshletOffsetC : drawPart.meshletOffset;
+      uint32_t meshletCount  = useChamfer ? drawPart.meshletCountC : drawPart.meshletCount;
 
-      if(m_tweak.triangles) {
-        if(triangleMaterials && rpart->flags.hasComplexMaterial)
-          glUniform1ui(UNI_MATERIALIDOFFSET, material_offset);
+      bool cull   = m_tweak.cull && !(drawPart.flags & DRAWPART_NO_BACKFACE_CULLING);
+      int  bucket = (cull ? 0 : 2) + (m_scene.instances[i].winding > 0 ? 0 : 1);
 
-        glDrawElementsBaseVertex(GL_TRIANGLES, numTriangles * 3, GL_UNSIGNED_INT,
-                                 (const void*)(sizeof(uint32_t) * triangles), drawPart.vertexOffset);
+      std::vector<DrawIndirectCommand>* typeRanges = output.ranges[(drawPart.flags & DRAWPART_INDEX16) ? INDEXTYPE_16 : INDEXTYPE_32];
 
-        if(triangleMaterials && rpart->flags.hasComplexMaterial)
-          glUniform1ui(UNI_MATERIALIDOFFSET, ~0);
+      const float* world   = m_scene.instances[i].worldMatrix.mat_array;
+      const float* worldIT = m_scene.instances[i].worldMatrixIT.mat_array;
+
+      // cones are tested in part space, where front faces stay counter-clockwise for mirrored instances,
+      // the inverse world matrix is the transpose of worldMatrixIT
+      float localCamera[3];
+      for(int r = 0; r < 3; r++) {
+        localCamera[r] = worldIT[r * 4 + 0] * cameraPos[0] + worldIT[r * 4 + 1] * cameraPos[1] + worldIT[r * 4 + 2] * cameraPos[2]
+                         + worldIT[r * 4 + 3];
+      }
+      // spheres are tested in world space, with the radius scaled by the longest axis
+      float scale = 0;
+      for(int c = 0; c < 3; c++) {
+        scale = std::max(scale, std::sqrt(world[c * 4 + 0] * world[c * 4 + 0] + world[c * 4 + 1] * world[c * 4 + 1]
+                                          + world[c * 4 + 2] * world[c * 4 + 2]));
       }
 
-      glUniform1f(UNI_COLORMUL, 0.2f);
-      glUniform1i(UNI_LIGHTING, 0);
-      if(m_tweak.edges) {
-        glLineWidth(lineWidthBase * lineWidthScale);
-        glDrawElementsBaseVertex(GL_LINES, rpart->numLines * 2, GL_UNSIGNED_INT,
-                                 (const void*)(sizeof(uint32_t) * drawPart.edgesOffset), drawPart.vertexOffset);
+      // meshlets cover the full geometry, a simplified level is drawn whole
+      uint32_t lod = lods ? selectLod(i) : 0;
+      if(lods) {
+        uint32_t lodOffset;
+        uint32_t lodCount;
+        getTriangleRange(drawPart, lod, lodOffset, lodCount);
+        output.lods.instances[lod]++;
+        output.lods.triangles += lodCount;
+        output.lods.fullTriangles += useChamfer ? drawPart.triangleCountC : drawPart.triangleCount;
+        if(lod) {
+          typeRanges[bucket].push_back({lodCount * 3, 1, lodOffset, drawPart.vertexOffset, i});
+          meshletCount = 0;
+        }
       }
 
-      if(m_tweak.wireframe) {
-        glLineWidth(lineWidthBase);
-        glUniform1f(UNI_COLORMUL, wireColor);
-        glEnable(GL_LINE_STIPPLE);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDrawElementsBaseVertex(GL_TRIANGLES, numTriangles * 3, GL_UNSIGNED_INT,
-                                 (const void*)(sizeof(uint32_t) * triangles), drawPart.vertexOffset);
-        glDisable(GL_LINE_STIPPLE);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+      // gl_PrimitiveID restarts with every command, per-triangle materials are only found with the full range
+      if(meshletCount && (drawPart.flags & (useChamfer ? DRAWPART_MATERIALS_C : DRAWPART_MATERIALS))) {
+        uint32_t triCount = useChamfer ? drawPart.triangleCountC : drawPart.triangleCount;
+        typeRanges[bucket].push_back({triCount * 3, 1, triOffset, drawPart.vertexOffset, i});
+        meshletCount = 0;
+      }
+
+      // visible meshlets are consecutive index ranges, neighbours merge into one command
+      bool extend = false;
+      for(uint32_t m = 0; m < meshletCount; m++) {
+        const Meshlet& meshlet = m_scene.meshlets[meshletOffset + m];
+        output.stats.tested++;
+
+        bool visible = true;
+        if(m_tweak.frustumCull) {
+          float center[3];
+          for(int r = 0; r < 3; r++) {
+            center[r] = world[0 * 4 + r] * meshlet.center[0] + world[1 * 4 + r] * meshlet.center[1]
+                        + world[2 * 4 + r] * meshlet.center[2] + world[3 * 4 + r];
+          }
+          if(!frustum.testSphere(center, meshlet.radius * scale)) {
+            output.stats.frustumCulled++;
+            visible = false;
+          }
+        }
+        if(visible && cull && m_tweak.meshletConeCull && isMeshletBackfacing(meshlet, localCamera)) {
+          output.stats.coneCulled++;
+          visible = false;
+        }
+
+        if(!visible) {
+          extend = false;
+        }
+        else if(extend) {
+          typeRanges[bucket].back().count += meshlet.triangleCount * 3;
+        }
+        else {
+          typeRanges[bucket].push_back({meshlet.triangleCount * 3u, 1, triOffset + meshlet.triangleOffset * 3, drawPart.vertexOffset, i});
+          extend = true;
+        }
       }
-    }
 
-    if(instance->part == m_tweak.part) {
-      if(m_tweak.vertex >= 0) {
-        glUniform1f(UNI_COLORMUL, 2.0f);
-        glDrawArrays(GL_POINTS, m_tweak.vertex + drawPart.vertexOffset, 1);
+      // lines stay per instance, silhouettes of backfacing meshlets are still visible
+      if(drawPart.edgesCount) {
+        typeRanges[CULLRANGE_EDGES].push_back({drawPart.edgesCount * 2, 1, drawPart.edgesOffset, drawPart.vertexOffset, i});
+      }
+      if(!m_tweak.drawRenderPart && drawPart.optionalCount) {
+        typeRanges[CULLRANGE_OPTIONAL].push_back({drawPart.optionalCount * 2, 1, drawPart.optionalOffset, drawPart.vertexOffset, i});
       }
-      if(m_tweak.tri >= 0) {
-        glUniform1f(UNI_COLORMUL, 1.7f);
-        glLineWidth(lineWidthBase * 3 * lineWidthScale);
-        glEnable(GL_LINE_STIPPLE);
-        glLineStipple(3, 0xAAAA);
-        glDrawElementsBaseVertex(GL_LINE_LOOP, 3, GL_UNSIGNED_INT,
-                                 (const void*)(sizeof(uint32_t) * (drawPart.triangleOffset + (m_tweak.tri * 3))),
-                                 drawPart.vertexOffset);
-        glDisable(GL_LINE_STIPPLE);
+      if(instance->part == LdrPartID(m_tweak.part)) {
+        output.highlights.push_back(i);
+      }
+    }
+  });
+
+  MultiDraw& meshletDraw = m_scene.meshletDraw;
+  meshletDraw.highlights.clear();
+  meshletDraw.dirty  = false;
+  m_meshletCullStats = MeshletCullStats();
+  m_lodStats         = LodStats();
+
+  std::vector<DrawIndirectCommand>& commands = m_meshletCommands;
+  commands.clear();
+  for(uint32_t t = 0; t < NUM_INDEXTYPES; t++) {
+    for(uint32_t r = 0; r < NUM_CULLRANGES; r++) {
+      uint32_t offset = uint32_t(commands.size());
+      for(const MeshletCullOutput& output : m_meshletCullOutputs) {
+        commands.insert(commands.end(), output.ranges[t][r].begin(), output.ranges[t][r].end());
       }
-      if(m_tweak.edge >= 0) {
-        glUniform1f(UNI_COLORMUL, 2.0f);
-        glLineWidth(lineWidthBase * 2 * lineWidthScale);
-        glDrawElementsBaseVertex(GL_LINES, 2, GL_UNSIGNED_INT,
-                                 (const void*)(sizeof(uint32_t) * (drawPart.edgesOffset + (m_tweak.edge * 2))),
-                                 drawPart.vertexOffset);
+      meshletDraw.ranges[t][r] = {offset, uint32_t(commands.size()) - offset};
+    }
+  }
+  for(const MeshletCullOutput& output : m_meshletCullOutputs) {
+    meshletDraw.highlights.insert(meshletDraw.highlights.end(), output.highlights.begin(), output.highlights.end());
+    m_meshletCullStats.tested += output.stats.tested;
+    m_meshletCullStats.frustumCulled += output.stats.frustumCulled;
+    m_meshletCullStats.coneCulled += output.stats.coneCulled;
+    m_lodStats.add(output.lods);
+  }
+  m_meshletCullStats.commands = uint32_t(commands.size());
+
+#ifndef NDEBUG
+  // parts with per-triangle materials must draw as with meshlet culling off, one command of the full range
+  for(uint32_t t = 0; t < NUM_INDEXTYPES; t++) {
+    for(uint32_t r = 0; r < NUM_BUCKETS; r++) {
+      const DrawRange& range = meshletDraw.ranges[t][r];
+      for(uint32_t c = range.offset; c < range.offset + range.count; c++) {
+        const DrawIndirectCommand& command  = commands[c];
+        const DrawPart&            drawPart = m_scene.drawParts[model->instances[command.baseInstance].part];
+
+        bool useChamfer = m_tweak.drawRenderPart && m_tweak.chamfered && (drawPart.flags & DRAWPART_CAN_CHAMFER);
+        if(!(drawPart.flags & (useChamfer ? DRAWPART_MATERIALS_C : DRAWPART_MATERIALS)))
+          continue;
+
+        uint32_t offset;
+        uint32_t count;
+        getTriangleRange(drawPart, 0, offset, count);
+        assert(command.firstIndex == offset && command.count == count * 3);
       }
     }
   }
+#endif
+
+  // grows with headroom, so moving the camera does not recreate the buffer every frame
+  if(commands.size() > m_scene.meshletCommandCapacity) {
+    m_scene.meshletCommandCapacity = uint32_t(commands.size() + commands.size() / 2);
+    nvgl::newBuffer(meshletDraw.indirectBuffer);
+    glNamedBufferStorage(meshletDraw.indirectBuffer, sizeof(DrawIndirectCommand) * m_scene.meshletCommandCapacity, nullptr,
+                         GL_DYNAMIC_STORAGE_BIT);
+  }
+  if(!commands.empty()) {
+    glNamedBufferSubData(meshletDraw.indirectBuffer, 0, sizeof(DrawIndirectCommand) * commands.size(), commands.data());
+  }
 
-  glDisableVertexAttribArray(VERTEX_POS);
-  glDisableVertexAttribArray(VERTEX_NORMAL);
+  time += m_profiler.getMicroSeconds();
+  m_meshletCullStats.time = time;
+}
+
+bool Sample::useGpuCulling() const
+{
+  return m_tweak.frustumCull && has_GL_ARB_indirect_parameters;
+}
+
+bool Sample::useOcclusionCulling() const
+{
+  // without depth testing nothing occludes
+  return useGpuCulling() && m_tweak.occlusionCull && !m_tweak.transparency;
+}
+
+void Sample::cullMultiDraw(CullMode mode)
+{
+  if(!m_scene.model)
+    return;
+
+  if(m_scene.multiDraw.dirty) {
+    buildMultiDraw();
+  }
+
+  const MultiDraw& multiDraw = m_scene.multiDraw;
+
+  Frustum frustum;
+  frustum.init(m_viewUbo.viewProjMatrix.mat_array);
+
+  // the occlusion pass has its own counters at CULLCOUNTER_OCCLUSION, the first pass clears both sets
+  bool occlusion = mode == CULL_OCCLUSION;
+  if(!occlusion) {
+    uint32_t zero = 0;
+    glClearNamedBufferData(multiDraw.counterBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+  }
+
+  glUseProgram(m_progManager.get(programs.cull_commands));
+  glUniform4fv(UNI_CULLPLANES, 6, &frustum.planes[0][0]);
+  glUniform2ui(UNI_CULLSTATS, CULLCOUNTER_TESTED, CULLCOUNTER_OCCLUDED);
+
+  glBindBufferBase(GL_UNIFORM_BUFFER, UBO_SCENE, m_common.viewBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_INSTANCES, m_scene.instanceBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_PARTBOUNDS, m_scene.partBoundsBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CULLCOMMANDS, multiDraw.indirectBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CULLOUTPUT, occlusion ? multiDraw.remainderBuffer : multiDraw.culledBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CULLCOUNTERS, multiDraw.counterBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CULLVISIBILITY, multiDraw.visibilityBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_PARTLODS, m_scene.partLodsBuffer);
+  glBindTextureUnit(TEX_DEPTHPYRAMID, textures.depth_pyramid);
+
+  // one dispatch per range, survivors are compacted to the front of the range
+  for(uint32_t t = 0; t < NUM_INDEXTYPES; t++) {
+    for(uint32_t r = 0; r < NUM_CULLRANGES; r++) {
+      const DrawRange& range = multiDraw.ranges[t][r];
+      if(!range.count)
+        continue;
+
+      // stats count instances and lines have no levels, so only the triangle ranges
+      uint32_t flags   = (occlusion && r < NUM_BUCKETS ? CULLFLAG_STATS : 0) | (useLods() && r < NUM_BUCKETS ? CULLFLAG_LOD : 0);
+      uint32_t counter = t * NUM_CULLRANGES + r + (occlusion ? CULLCOUNTER_OCCLUSION : 0);
+      glUniform4ui(UNI_CULLRANGE, range.offset, range.count, counter, mode | flags);
+      glDispatchCompute((range.count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+    }
+  }
+
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+  if(occlusion) {
+    glCopyNamedBufferSubData(multiDraw.counterBuffer, m_occlusionStatsBuffer, sizeof(uint32_t) * CULLCOUNTER_TESTED, 0,
+                             sizeof(uint32_t) * 2);
+  }
 
-  glBindBufferBase(GL_UNIFORM_BUFFER, UBO_OBJECT, 0);
   glBindBufferBase(GL_UNIFORM_BUFFER, UBO_SCENE, 0);
-  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_MATERIALIDS, 0);
-  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_MATERIALS, 0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_INSTANCES, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_PARTBOUNDS, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CULLCOMMANDS, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CULLOUTPUT, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CULLCOUNTERS, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_CULLVISIBILITY, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_PARTLODS, 0);
+  glBindTextureUnit(TEX_DEPTHPYRAMID, 0);
+  glUseProgram(0);
+}
 
-  glDisable(GL_DEPTH_TEST);
-  glDisable(GL_CULL_FACE);
-  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-  glDisable(GL_POLYGON_OFFSET_FILL);
-  glLineWidth(1);
-  glPointSize(1);
-  glDisable(GL_LINE_STIPPLE);
+void Sample::buildDepthPyramid()
+{
+  if(m_pyramidQueryPending) {
+    GLint available = 0;
+    glGetQueryObjectiv(m_pyramidQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if(available) {
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(m_pyramidQuery, GL_QUERY_RESULT, &elapsed);
+      m_pyramidTime         = double(elapsed) / 1000.0;
+      m_pyramidQueryPending = false;
+    }
+  }
+  if(!m_pyramidQueryPending) {
+    glBeginQuery(GL_TIME_ELAPSED, m_pyramidQuery);
+  }
+
+  GLint width  = 0;
+  GLint height = 0;
+  GLint levels = 0;
+  glGetTextureLevelParameteriv(textures.depth_pyramid, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTextureLevelParameteriv(textures.depth_pyramid, 0, GL_TEXTURE_HEIGHT, &height);
+  glGetTextureParameteriv(textures.depth_pyramid, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+
+  glUseProgram(m_progManager.get(programs.depth_pyramid));
+  glBindTextureUnit(TEX_SCENEDEPTH, textures.scene_depthstencil);
+  glBindTextureUnit(TEX_DEPTHPYRAMID, textures.depth_pyramid);
+
+  // level 0 resolves the farthest sample, every other level reads the one below
+  for(GLint level = 0; level < levels; level++) {
+    GLint levelWidth  = std::max(width >> level, 1);
+    GLint levelHeight = std::max(height >> level, 1);
+
+    glBindImageTexture(IMG_DEPTHPYRAMID, textures.depth_pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glUniform2i(UNI_PYRAMIDPARAMS, level, SAMPLE_MSAA);
+    glDispatchCompute((levelWidth + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE,
+                      (levelHeight + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+  }
+
+  glBindImageTexture(IMG_DEPTHPYRAMID, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+  glBindTextureUnit(TEX_SCENEDEPTH, 0);
+  glBindTextureUnit(TEX_DEPTHPYRAMID, 0);
   glUseProgram(0);
 
-  glBindVertexArray(0);
+  if(!m_pyramidQueryPending) {
+    glEndQuery(GL_TIME_ELAPSED);
+    m_pyramidQueryPending = true;
+  }
+}
+
+void Sample::drawOcclusionCulled()
+{
+  // what was visible last frame fills the depth buffer, the rest is tested against it
+  {
+    NV_PROFILE_GL_SECTION("Cull");
+    cullMultiDraw(CULL_LASTVISIBLE);
+  }
+  drawMultiDraw(m_scene.multiDraw, 0, false);
+  {
+    NV_PROFILE_GL_SECTION("Pyramid");
+    buildDepthPyramid();
+  }
+  {
+    NV_PROFILE_GL_SECTION("Occlusion");
+    cullMultiDraw(CULL_OCCLUSION);
+  }
+  drawMultiDraw(m_scene.multiDraw, 1, true);
+}
+
+// culledPass -1 draws all commands, 0 the frustum or last-visible pass, 1 the occlusion pass,
+// multiDraw must be built, gpu culled passes only exist for m_scene.multiDraw
+void Sample::drawMultiDraw(const MultiDraw& multiDraw, int culledPass, bool highlights)
+{
+  if(!m_scene.model)
+    return;
+
+  beginDraw(m_progManager.get(programs.draw_scene));
+
+  float lineWidthScale = 2.0f;
+  float lineWidthBase  = 1.0f;
+  float wireColor      = 0.5f;
+
+  // when culled, the draw count of each range comes from the counters the cull shader wrote
+  bool     culled        = culledPass >= 0;
+  uint32_t counterOffset = culledPass == 1 ? CULLCOUNTER_OCCLUSION : 0;
+  GLuint   commands      = culledPass == 1 ? multiDraw.remainderBuffer : multiDraw.culledBuffer;
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culled ? commands : multiDraw.indirectBuffer);
+  if(culled) {
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, multiDraw.counterBuffer);
+  }
+
+  // one multi draw per index type
+  auto drawRange = [&](GLenum mode, uint32_t r) {
+    for(uint32_t t = 0; t < NUM_INDEXTYPES; t++) {
+      const DrawRange& range = multiDraw.ranges[t][r];
+      if(!range.count)
+        continue;
+
+      GLenum      type     = t == INDEXTYPE_16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+      const void* indirect = (const void*)(sizeof(DrawIndirectCommand) * range.offset);
+      uint32_t    counter  = t * NUM_CULLRANGES + r + counterOffset;
+      if(culled) {
+        glMultiDrawElementsIndirectCountARB(mode, type, indirect, sizeof(uint32_t) * counter, range.count, 0);
+      }
+      else {
+        glMultiDrawElementsIndirect(mode, type, indirect, range.count, 0);
+        m_drawInstances += range.count;
+      }
+      m_drawCalls++;
+    }
+  };
+  auto drawTriangles = [&]() {
+    for(uint32_t b = 0; b < NUM_BUCKETS; b++) {
+      if(!multiDraw.ranges[INDEXTYPE_32][b].count && !multiDraw.ranges[INDEXTYPE_16][b].count)
+        continue;
+
+      if(b == BUCKET_CULL_CCW || b == BUCKET_CULL_CW) {
+        glEnable(GL_CULL_FACE);
+      }
+      else {
+        glDisable(GL_CULL_FACE);
+      }
+      glFrontFace(b == BUCKET_CULL_CCW || b == BUCKET_NOCULL_CCW ? GL_CCW : GL_CW);
+      m_stateChanges += 2;
+      drawRange(GL_TRIANGLES, b);
+    }
+    glEnable(GL_CULL_FACE);
+    glFrontFace(GL_CCW);
+  };
+
+  // same passes as drawDebug, but each one is a single multi draw per state bucket
+  glUniform1i(UNI_LIGHTING, m_tweak.drawRenderPart ? 1 : 0);
+  glUniform1f(UNI_COLORMUL, 1.0f);
+  if(m_tweak.triangles) {
+    glUniform1i(UNI_PARTMATERIALS, 1);
+    drawTriangles();
+    glUniform1i(UNI_PARTMATERIALS, 0);
+  }
+
+  glUniform1i(UNI_LIGHTING, 0);
+  glUniform1f(UNI_COLORMUL, 0.2f);
+  if(m_tweak.edges) {
+    glLineWidth(lineWidthBase * lineWidthScale);
+    drawRange(GL_LINES, CULLRANGE_EDGES);
+  }
+
+  if(m_tweak.optional && !m_tweak.drawRenderPart) {
+    glLineWidth(lineWidthBase * lineWidthScale);
+    glLineStipple(4, 0xAAAA);
+    glEnable(GL_LINE_STIPPLE);
+    drawRange(GL_LINES, CULLRANGE_OPTIONAL);
+    glDisable(GL_LINE_STIPPLE);
+  }
+
+  if(m_tweak.wireframe) {
+    glLineWidth(lineWidthBase);
+    glUniform1f(UNI_COLORMUL, wireColor);
+    glLineStipple(2, 0xAAAA);
+    glEnable(GL_LINE_STIPPLE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    drawTriangles();
+    glDisable(GL_LINE_STIPPLE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  }
+
+  for(uint32_t i : multiDraw.highlights) {
+    if(!highlights)
+      break;
+
+    const DrawPart& drawPart = m_scene.drawParts[m_tweak.part];
+
+    if(m_tweak.vertex >= 0) {
+      glUniform1f(UNI_COLORMUL, 2.0f);
+      glDrawArraysInstancedBaseInstance(GL_POINTS, m_tweak.vertex + drawPart.vertexOffset, 1, 1, i);
+    }
+    if(m_tweak.tri >= 0) {
+      glUniform1f(UNI_COLORMUL, 1.7f);
+      glLineWidth(lineWidthBase * 3 * lineWidthScale);
+      glEnable(GL_LINE_STIPPLE);
+      glLineStipple(3, 0xAAAA);
+      glDrawElementsInstancedBaseVertexBaseInstance(GL_LINE_LOOP, 3, getIndexType(drawPart),
+                                                    (const void*)(getIndexSize(drawPart) * (drawPart.triangleOffset + (m_tweak.tri * 3))),
+                                                    1, drawPart.vertexOffset, i);
+      glDisable(GL_LINE_STIPPLE);
+    }
+    if(m_tweak.edge >= 0) {
+      glUniform1f(UNI_COLORMUL, 2.0f);
+      glLineWidth(lineWidthBase * 2 * lineWidthScale);
+      glDrawElementsInstancedBaseVertexBaseInstance(GL_LINES, 2, getIndexType(drawPart),
+                                                    (const void*)(getIndexSize(drawPart) * (drawPart.edgesOffset + (m_tweak.edge * 2))), 1,
+                                                    drawPart.vertexOffset, i);
+    }
+  }
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+
+  endDraw();
 }
 }  // namespace ldrawviewer
 
@@ -1133,6 +3011,11 @@ using namespace ldrawviewer;
 
 int main(int argc, const char** argv)
 {
+  // no window or GL context, runs on machines without a GPU
+  if(isBenchmarkCommandLine(argc, argv)) {
+    return runBenchmark(argc, argv);
+  }
+
   NVPSystem system(PROJECT_NAME);
 
   Sample sample;
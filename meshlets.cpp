@@ -0,0 +1,188 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include "meshlets.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace ldrawviewer {
+
+static const float* getMeshletPosition(const void* vertices, size_t vertexSize, uint32_t vertex)
+{
+  return (const float*)((const uint8_t*)vertices + vertexSize * vertex);
+}
+
+static void finishMeshlet(const uint32_t*           indices,
+                          const std::vector<float>& normals,
+                          uint32_t                  begin,
+                          uint32_t                  end,
+                          uint32_t                  vertexCount,
+                          const void*               vertices,
+                          size_t                    vertexSize,
+                          uint32_t                  numVertices,
+                          std::vector<Meshlet>&     meshlets)
+{
+  Meshlet meshlet;
+  meshlet.triangleOffset = begin;
+  meshlet.triangleCount  = uint16_t(end - begin);
+  meshlet.vertexCount    = uint16_t(vertexCount);
+
+  // sphere around the bbox center, not minimal but cheap and stable
+  float bmin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float bmax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for(uint32_t i = begin * 3; i < end * 3; i++) {
+    if(indices[i] >= numVertices)
+      continue;
+    const float* pos = getMeshletPosition(vertices, vertexSize, indices[i]);
+    for(int c = 0; c < 3; c++) {
+      bmin[c] = std::min(bmin[c], pos[c]);
+      bmax[c] = std::max(bmax[c], pos[c]);
+    }
+  }
+  float radiusSq = 0;
+  for(int c = 0; c < 3; c++) {
+    meshlet.center[c] = bmin[c] <= bmax[c] ? (bmin[c] + bmax[c]) * 0.5f : 0.0f;
+  }
+  for(uint32_t i = begin * 3; i < end * 3; i++) {
+    if(indices[i] >= numVertices)
+      continue;
+    const float* pos = getMeshletPosition(vertices, vertexSize, indices[i]);
+    float        dx  = pos[0] - meshlet.center[0];
+    float        dy  = pos[1] - meshlet.center[1];
+    float        dz  = pos[2] - meshlet.center[2];
+    radiusSq         = std::max(radiusSq, dx * dx + dy * dy + dz * dz);
+  }
+  meshlet.radius = std::sqrt(radiusSq);
+
+  // average of the unit normals, the cone must contain every non-degenerate one
+  float axis[3] = {0, 0, 0};
+  for(uint32_t t = begin; t < end; t++) {
+    for(int c = 0; c < 3; c++) {
+      axis[c] += normals[t * 3 + c];
+    }
+  }
+  float len    = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  float minDot = len > 0 ? 1.0f : -1.0f;
+  for(int c = 0; c < 3; c++) {
+    meshlet.coneAxis[c] = len > 0 ? axis[c] / len : 0.0f;
+  }
+  for(uint32_t t = begin; t < end && minDot > 0; t++) {
+    const float* normal = &normals[t * 3];
+    if(normal[0] == 0 && normal[1] == 0 && normal[2] == 0)
+      continue;
+    minDot = std::min(minDot, normal[0] * meshlet.coneAxis[0] + normal[1] * meshlet.coneAxis[1] + normal[2] * meshlet.coneAxis[2]);
+  }
+  meshlet.coneCutoff = minDot > 0 ? std::sqrt(std::max(0.0f, 1.0f - minDot * minDot)) : 1.0f;
+
+  meshlets.push_back(meshlet);
+}
+
+void buildMeshlets(const uint32_t*       indices,
+                   uint32_t              numTriangles,
+                   const void*           vertices,
+                   size_t                vertexSize,
+                   uint32_t              numVertices,
+                   std::vector<Meshlet>& meshlets)
+{
+  // unit normals of counter-clockwise front faces, zero for degenerate triangles
+  std::vector<float> normals(size_t(numTriangles) * 3, 0.0f);
+  for(uint32_t t = 0; t < numTriangles; t++) {
+    const uint32_t* tri = &indices[t * 3];
+    if(tri[0] >= numVertices || tri[1] >= numVertices || tri[2] >= numVertices)
+      continue;
+
+    const float* a     = getMeshletPosition(vertices, vertexSize, tri[0]);
+    const float* b     = getMeshletPosition(vertices, vertexSize, tri[1]);
+    const float* c     = getMeshletPosition(vertices, vertexSize, tri[2]);
+    float        e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    float        e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    float        n[3]  = {e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0]};
+    float        len   = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if(len > 0) {
+      for(int i = 0; i < 3; i++) {
+        normals[t * 3 + i] = n[i] / len;
+      }
+    }
+  }
+
+  // stamp of the meshlet that last referenced a vertex
+  std::vector<uint32_t> stamps(numVertices, 0);
+  uint32_t              stamp = 1;
+
+  auto countNewVertices = [&](const uint32_t* tri) {
+    uint32_t count = 0;
+    for(int i = 0; i < 3; i++) {
+      bool repeated = (i > 0 && tri[i] == tri[0]) || (i > 1 && tri[i] == tri[1]);
+      if(tri[i] < numVertices && stamps[tri[i]] != stamp && !repeated) {
+        count++;
+      }
+    }
+    return count;
+  };
+
+  uint32_t begin        = 0;
+  uint32_t vertexCount  = 0;
+  float    normalSum[3] = {0, 0, 0};
+  for(uint32_t t = 0; t < numTriangles; t++) {
+    const uint32_t* tri         = &indices[t * 3];
+    const float*    normal      = &normals[t * 3];
+    uint32_t        count       = t - begin;
+    uint32_t        newVertices = countNewVertices(tri);
+
+    bool full     = count == MESHLET_MAX_TRIANGLES || vertexCount + newVertices > MESHLET_MAX_VERTICES;
+    bool diverges = count >= MESHLET_MAX_TRIANGLES / 4
+                    && normal[0] * normalSum[0] + normal[1] * normalSum[1] + normal[2] * normalSum[2] < 0;
+    if(count && (full || diverges)) {
+      finishMeshlet(indices, normals, begin, t, vertexCount, vertices, vertexSize, numVertices, meshlets);
+      begin        = t;
+      vertexCount  = 0;
+      normalSum[0] = normalSum[1] = normalSum[2] = 0;
+      stamp++;
+      newVertices = countNewVertices(tri);
+    }
+
+    for(int i = 0; i < 3; i++) {
+      if(tri[i] < numVertices) {
+        stamps[tri[i]] = stamp;
+      }
+      normalSum[i] += normal[i];
+    }
+    vertexCount += newVertices;
+  }
+  if(numTriangles > begin) {
+    finishMeshlet(indices, normals, begin, numTriangles, vertexCount, vertices, vertexSize, numVertices, meshlets);
+  }
+}
+
+void MeshletStats::add(const Meshlet* meshletArray, uint32_t numMeshlets)
+{
+  for(uint32_t i = 0; i < numMeshlets; i++) {
+    const Meshlet& meshlet = meshletArray[i];
+    meshlets++;
+    triangles += meshlet.triangleCount;
+    vertices += meshlet.vertexCount;
+    if(meshlet.coneCutoff < 1.0f) {
+      cones++;
+      coneAngle += std::asin(meshlet.coneCutoff) * 180.0 / 3.14159265358979;
+    }
+  }
+}
+
+}  // namespace ldrawviewer
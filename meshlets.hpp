@@ -0,0 +1,88 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace ldrawviewer {
+
+// Meshlets are runs of consecutive triangles of a part's triangle list, so they are drawn
+// as plain index ranges of the existing index buffer. Bounds and normal cones are in the
+// part's local space.
+
+static const uint32_t MESHLET_MAX_VERTICES  = 64;
+static const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+struct Meshlet
+{
+  uint32_t triangleOffset;  // in triangles, relative to the part's triangle list
+  uint16_t triangleCount;
+  uint16_t vertexCount;
+  float    center[3];
+  float    radius;
+  // all triangle normals are within the cone, coneCutoff is the sine of its half angle,
+  // 1 when the cone is wider than a hemisphere and the meshlet can never be backfacing
+  float coneAxis[3];
+  float coneCutoff;
+};
+
+// Appends the meshlets of a triangle list. position must be the first member of the vertex.
+// A meshlet is closed when it is full, or once it is a quarter full and the next triangle
+// faces away from its average normal, which keeps cones tight around studs and undersides.
+void buildMeshlets(const uint32_t*       indices,
+                   uint32_t              numTriangles,
+                   const void*           vertices,
+                   size_t                vertexSize,
+                   uint32_t              numVertices,
+                   std::vector<Meshlet>& meshlets);
+
+// cameraPos in the meshlet's space, only valid for triangles whose front faces are
+// counter-clockwise in that space, mirrored instances are handled by the local space
+inline bool isMeshletBackfacing(const Meshlet& meshlet, const float cameraPos[3])
+{
+  if(meshlet.coneCutoff >= 1.0f)
+    return false;
+
+  float dir[3] = {meshlet.center[0] - cameraPos[0], meshlet.center[1] - cameraPos[1], meshlet.center[2] - cameraPos[2]};
+  float dist   = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+  float dot    = dir[0] * meshlet.coneAxis[0] + dir[1] * meshlet.coneAxis[1] + dir[2] * meshlet.coneAxis[2];
+  return dot >= meshlet.coneCutoff * dist + meshlet.radius;
+}
+
+struct MeshletStats
+{
+  uint32_t meshlets  = 0;
+  uint64_t triangles = 0;
+  uint64_t vertices  = 0;
+  uint32_t cones     = 0;  // meshlets that can be backfacing
+  double   coneAngle = 0;  // sum of their half angles in degrees
+
+  // average occupancy of the meshlet limits
+  float getTriangleFill() const { return meshlets ? float(double(triangles) / (double(meshlets) * MESHLET_MAX_TRIANGLES)) : 0.0f; }
+  float getVertexFill() const { return meshlets ? float(double(vertices) / (double(meshlets) * MESHLET_MAX_VERTICES)) : 0.0f; }
+  float getConeRatio() const { return meshlets ? float(cones) / float(meshlets) : 0.0f; }
+  float getAverageConeAngle() const { return cones ? float(coneAngle / cones) : 0.0f; }
+
+  void add(const Meshlet* meshletArray, uint32_t numMeshlets);
+};
+
+}  // namespace ldrawviewer
@@ -0,0 +1,445 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include "partcache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace ldrawviewer {
+
+static const char CACHE_MAGIC[8] = {'L', 'D', 'R', 'P', 'C', 'A', 'C', 'H'};
+
+struct CacheWriter
+{
+  std::vector<uint8_t> data;
+
+  void write(const void* src, size_t size)
+  {
+    size_t offset = data.size();
+    data.resize(offset + size);
+    if(size) {
+      memcpy(&data[offset], src, size);
+    }
+  }
+  void write(uint32_t value) { write(&value, sizeof(value)); }
+  void write(const std::string& str)
+  {
+    write(uint32_t(str.size()));
+    write(str.data(), str.size());
+  }
+  template <typename T>
+  void write(const std::vector<T>& vec)
+  {
+    write(uint32_t(vec.size()));
+    write(vec.data(), sizeof(T) * vec.size());
+  }
+};
+
+struct CacheReader
+{
+  const uint8_t* data;
+  size_t         size;
+  size_t         offset = 0;
+  bool           valid  = true;
+
+  void read(void* dst, size_t readSize)
+  {
+    if(!valid || offset + readSize > size) {
+      valid = false;
+      return;
+    }
+    if(readSize) {
+      memcpy(dst, data + offset, readSize);
+    }
+    offset += readSize;
+  }
+  uint32_t readU32()
+  {
+    uint32_t value = 0;
+    read(&value, sizeof(value));
+    return value;
+  }
+  void read(std::string& str)
+  {
+    uint32_t length = readU32();
+    if(!valid || offset + length > size) {
+      valid = false;
+      return;
+    }
+    str.assign((const char*)(data + offset), length);
+    offset += length;
+  }
+  template <typename T>
+  void read(std::vector<T>& vec)
+  {
+    uint32_t count = readU32();
+    if(!valid || offset + sizeof(T) * size_t(count) > size) {
+      valid = false;
+      return;
+    }
+    vec.resize(count);
+    read(vec.data(), sizeof(T) * vec.size());
+  }
+};
+
+template <typename T>
+static void copyArray(std::vector<T>& vec, const T* src, uint32_t count)
+{
+  if(src && count) {
+    vec.assign(src, src + count);
+  }
+  else {
+    vec.clear();
+  }
+}
+
+template <typename T>
+static T* getArray(std::vector<T>& vec)
+{
+  return vec.empty() ? nullptr : vec.data();
+}
+
+// the fields of the loader's structs that are cached, the file stores them one by one so
+// it does not depend on the struct layout
+static void copyPartFields(LdrPart& dst, const LdrPart& src)
+{
+  dst.flags.hasComplexMaterial   = src.flags.hasComplexMaterial;
+  dst.flags.hasNoBackFaceCulling = src.flags.hasNoBackFaceCulling;
+  dst.numPositions               = src.numPositions;
+  dst.numTriangles               = src.numTriangles;
+  dst.numLines                   = src.numLines;
+  dst.numOptionalLines           = src.numOptionalLines;
+}
+
+static void copyPartFields(LdrRenderPart& dst, const LdrRenderPart& src)
+{
+  dst.flags.hasComplexMaterial = src.flags.hasComplexMaterial;
+  dst.flags.canChamfer         = src.flags.canChamfer;
+  dst.numVertices              = src.numVertices;
+  dst.numTriangles             = src.numTriangles;
+  dst.numLines                 = src.numLines;
+  dst.numTrianglesC            = src.numTrianglesC;
+}
+
+static void writePartFields(CacheWriter& writer, const LdrPart& part)
+{
+  writer.write(uint32_t(part.flags.hasComplexMaterial) | (uint32_t(part.flags.hasNoBackFaceCulling) << 1));
+  writer.write(part.numPositions);
+  writer.write(part.numTriangles);
+  writer.write(part.numLines);
+  writer.write(part.numOptionalLines);
+}
+
+static void writePartFields(CacheWriter& writer, const LdrRenderPart& renderPart)
+{
+  writer.write(uint32_t(renderPart.flags.hasComplexMaterial) | (uint32_t(renderPart.flags.canChamfer) << 1));
+  writer.write(renderPart.numVertices);
+  writer.write(renderPart.numTriangles);
+  writer.write(renderPart.numLines);
+  writer.write(renderPart.numTrianglesC);
+}
+
+static void readPartFields(CacheReader& reader, LdrPart& part)
+{
+  uint32_t flags                  = reader.readU32();
+  part.flags.hasComplexMaterial   = flags & 1;
+  part.flags.hasNoBackFaceCulling = (flags >> 1) & 1;
+  part.numPositions               = reader.readU32();
+  part.numTriangles               = reader.readU32();
+  part.numLines                   = reader.readU32();
+  part.numOptionalLines           = reader.readU32();
+}
+
+static void readPartFields(CacheReader& reader, LdrRenderPart& renderPart)
+{
+  uint32_t flags                      = reader.readU32();
+  renderPart.flags.hasComplexMaterial = flags & 1;
+  renderPart.flags.canChamfer         = (flags >> 1) & 1;
+  renderPart.numVertices              = reader.readU32();
+  renderPart.numTriangles             = reader.readU32();
+  renderPart.numLines                 = reader.readU32();
+  renderPart.numTrianglesC            = reader.readU32();
+}
+
+void PartCache::Entry::setupViews()
+{
+  part.name              = name.c_str();
+  part.numInstances      = 0;
+  part.positions         = getArray(positions);
+  part.triangles         = getArray(triangles);
+  part.lines             = getArray(lines);
+  part.optional_lines    = getArray(optionalLines);
+  part.triangleMaterials = getArray(triangleMaterials);
+
+  if(!hasRenderPart) {
+    renderPart = LdrRenderPart();
+  }
+  renderPart.vertices          = getArray(renderVertices);
+  renderPart.triangles         = getArray(renderTriangles);
+  renderPart.lines             = getArray(renderLines);
+  renderPart.trianglesC        = getArray(renderTrianglesC);
+  renderPart.triangleMaterials = getArray(renderTriangleMaterials);
+  renderPart.materialsC        = getArray(renderMaterialsC);
+}
+
+// the copied counts must match the arrays, material arrays are optional
+bool PartCache::Entry::isConsistent() const
+{
+  bool valid = positions.size() == part.numPositions && triangles.size() == size_t(part.numTriangles) * 3
+               && lines.size() == size_t(part.numLines) * 2 && optionalLines.size() == size_t(part.numOptionalLines) * 2
+               && (triangleMaterials.empty() || triangleMaterials.size() == part.numTriangles);
+  if(valid && hasRenderPart) {
+    valid = renderVertices.size() == renderPart.numVertices && renderTriangles.size() == size_t(renderPart.numTriangles) * 3
+            && renderLines.size() == size_t(renderPart.numLines) * 2 && renderTrianglesC.size() == size_t(renderPart.numTrianglesC) * 3
+            && (renderTriangleMaterials.empty() || renderTriangleMaterials.size() == renderPart.numTriangles)
+            && (renderMaterialsC.empty() || renderMaterialsC.size() == renderPart.numTrianglesC);
+  }
+  return valid;
+}
+
+size_t PartCache::Entry::getBytes() const
+{
+  size_t indices   = triangles.size() + lines.size() + optionalLines.size() + renderTriangles.size() + renderLines.size()
+                     + renderTrianglesC.size();
+  size_t materials = triangleMaterials.size() + renderTriangleMaterials.size() + renderMaterialsC.size();
+  return sizeof(Entry) + key.size() + name.size() + sizeof(LdrVector) * positions.size() + sizeof(LdrRenderVertex) * renderVertices.size()
+         + sizeof(LdrVertexIndex) * indices + sizeof(LdrMaterialID) * materials;
+}
+
+std::string PartCache::makeKey(const std::string& filename, const LdrLoaderCreateInfo& info, bool optimized)
+{
+  uint64_t fileSize = 0;
+  uint64_t fileTime = 0;
+  if(!filename.empty()) {
+    std::error_code ec;
+    fileSize = uint64_t(std::filesystem::file_size(filename, ec));
+    fileTime = uint64_t(std::filesystem::last_write_time(filename, ec).time_since_epoch().count());
+  }
+
+  char key[256];
+  snprintf(key, sizeof(key), "%llu|%llu|%d|%d|%d|%d|%d|%.6f|%d", (unsigned long long)fileSize, (unsigned long long)fileTime,
+           int(info.partFixMode), int(info.partFixTjunctions), int(info.partFixOverlap), int(info.partHiResPrimitives),
+           int(info.renderpartBuildMode), info.renderpartChamfer, optimized ? 1 : 0);
+
+  return std::string(key);
+}
+
+void PartCache::beginLoad()
+{
+  m_generation++;
+  m_stats = Stats();
+}
+
+bool PartCache::lookup(const char* partName, const std::string& key, const LdrPart*& part, const LdrRenderPart*& renderPart)
+{
+  auto it = m_entries.find(partName ? partName : "");
+  if(it == m_entries.end() || it->second.key != key) {
+    m_stats.misses++;
+    return false;
+  }
+
+  // not worth rewriting the file for, saved along with the next store
+  Entry& entry  = it->second;
+  entry.lastUse = m_generation;
+
+  m_stats.hits++;
+  part       = &entry.part;
+  renderPart = entry.hasRenderPart ? &entry.renderPart : nullptr;
+  return true;
+}
+
+void PartCache::store(const char* partName, const std::string& key, const LdrPart* part, const LdrRenderPart* renderPart)
+{
+  if(!part || !partName)
+    return;
+
+  // a stale entry of the part, other file stamp or settings, is replaced
+  Entry& entry  = m_entries[partName];
+  entry         = Entry();
+  entry.key     = key;
+  entry.lastUse = m_generation;
+  entry.name    = partName;
+
+  copyPartFields(entry.part, *part);
+  copyArray(entry.positions, part->positions, part->numPositions);
+  copyArray(entry.triangles, part->triangles, part->numTriangles * 3);
+  copyArray(entry.lines, part->lines, part->numLines * 2);
+  copyArray(entry.optionalLines, part->optional_lines, part->numOptionalLines * 2);
+  copyArray(entry.triangleMaterials, part->triangleMaterials, part->numTriangles);
+
+  entry.hasRenderPart = renderPart != nullptr;
+  if(renderPart) {
+    copyPartFields(entry.renderPart, *renderPart);
+    copyArray(entry.renderVertices, renderPart->vertices, renderPart->numVertices);
+    copyArray(entry.renderTriangles, renderPart->triangles, renderPart->numTriangles * 3);
+    copyArray(entry.renderLines, renderPart->lines, renderPart->numLines * 2);
+    copyArray(entry.renderTrianglesC, renderPart->trianglesC, renderPart->numTrianglesC * 3);
+    copyArray(entry.renderTriangleMaterials, renderPart->triangleMaterials, renderPart->numTriangles);
+    copyArray(entry.renderMaterialsC, renderPart->materialsC, renderPart->numTrianglesC);
+  }
+
+  entry.setupViews();
+
+  m_stats.stored++;
+  m_dirty = true;
+}
+
+void PartCache::trim(uint64_t maxBytes)
+{
+  uint64_t                                       totalBytes = 0;
+  std::vector<std::pair<uint64_t, const Entry*>> candidates;
+  for(const auto& it : m_entries) {
+    totalBytes += it.second.getBytes();
+    if(it.second.lastUse != m_generation) {
+      candidates.push_back({it.second.lastUse, &it.second});
+    }
+  }
+  if(totalBytes <= maxBytes)
+    return;
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const std::pair<uint64_t, const Entry*>& a, const std::pair<uint64_t, const Entry*>& b) { return a.first < b.first; });
+
+  for(size_t i = 0; i < candidates.size() && totalBytes > maxBytes; i++) {
+    std::string name = candidates[i].second->name;
+    totalBytes -= candidates[i].second->getBytes();
+    m_entries.erase(name);
+    m_stats.evicted++;
+    m_dirty = true;
+  }
+}
+
+bool PartCache::save(const std::string& filename) const
+{
+  CacheWriter writer;
+  writer.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  writer.write(VERSION);
+  writer.write(uint32_t(m_entries.size()));
+
+  for(const auto& it : m_entries) {
+    const Entry& entry = it.second;
+    writer.write(entry.key);
+    writer.write(&entry.lastUse, sizeof(entry.lastUse));
+    writer.write(entry.name);
+    writePartFields(writer, entry.part);
+    writer.write(entry.positions);
+    writer.write(entry.triangles);
+    writer.write(entry.lines);
+    writer.write(entry.optionalLines);
+    writer.write(entry.triangleMaterials);
+
+    writer.write(entry.hasRenderPart ? 1u : 0u);
+    writePartFields(writer, entry.renderPart);
+    writer.write(entry.renderVertices);
+    writer.write(entry.renderTriangles);
+    writer.write(entry.renderLines);
+    writer.write(entry.renderTrianglesC);
+    writer.write(entry.renderTriangleMaterials);
+    writer.write(entry.renderMaterialsC);
+  }
+
+  FILE* file = fopen(filename.c_str(), "wb");
+  if(!file)
+    return false;
+
+  bool success = fwrite(writer.data.data(), writer.data.size(), 1, file) == 1;
+  fclose(file);
+
+  return success;
+}
+
+bool PartCache::load(const std::string& filename)
+{
+  m_entries.clear();
+  m_generation = 0;
+  m_dirty      = false;
+
+  FILE* file = fopen(filename.c_str(), "rb");
+  if(!file)
+    return false;
+
+  std::vector<uint8_t> data;
+  fseek(file, 0, SEEK_END);
+  long fileSize = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if(fileSize > 0) {
+    data.resize(size_t(fileSize));
+    if(fread(data.data(), data.size(), 1, file) != 1) {
+      data.clear();
+    }
+  }
+  fclose(file);
+
+  CacheReader reader = {data.data(), data.size()};
+
+  char magic[sizeof(CACHE_MAGIC)];
+  reader.read(magic, sizeof(magic));
+  uint32_t version    = reader.readU32();
+  uint32_t numEntries = reader.readU32();
+
+  if(!reader.valid || memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || version != VERSION) {
+    printf("part cache: %s is outdated or invalid, ignored\n", filename.c_str());
+    return false;
+  }
+
+  for(uint32_t i = 0; i < numEntries && reader.valid; i++) {
+    Entry entry;
+    reader.read(entry.key);
+    reader.read(&entry.lastUse, sizeof(entry.lastUse));
+    reader.read(entry.name);
+    readPartFields(reader, entry.part);
+    reader.read(entry.positions);
+    reader.read(entry.triangles);
+    reader.read(entry.lines);
+    reader.read(entry.optionalLines);
+    reader.read(entry.triangleMaterials);
+
+    entry.hasRenderPart = reader.readU32() != 0;
+    readPartFields(reader, entry.renderPart);
+    reader.read(entry.renderVertices);
+    reader.read(entry.renderTriangles);
+    reader.read(entry.renderLines);
+    reader.read(entry.renderTrianglesC);
+    reader.read(entry.renderTriangleMaterials);
+    reader.read(entry.renderMaterialsC);
+
+    if(reader.valid && !entry.isConsistent()) {
+      reader.valid = false;
+    }
+    if(reader.valid) {
+      m_generation  = std::max(m_generation, entry.lastUse);
+      Entry& stored = m_entries[entry.name];
+      stored        = std::move(entry);
+      stored.setupViews();
+    }
+  }
+
+  if(!reader.valid) {
+    printf("part cache: %s is truncated or invalid, ignored\n", filename.c_str());
+    m_entries.clear();
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace ldrawviewer
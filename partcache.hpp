@@ -0,0 +1,106 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "external/ldrawloader/src/ldrawloader.h"
+
+namespace ldrawviewer {
+
+// Versioned binary cache of processed (fixed) LdrPart and LdrRenderPart
+// geometry. There is one entry per part name, it is valid while its key, the
+// part file's size and modification time as well as all loader settings that
+// influence the processing, matches. Storing a part replaces its stale entry,
+// trim drops the least recently used entries once the cache grows too large.
+// Parts handed out by lookup stay valid until the next beginLoad.
+class PartCache
+{
+public:
+  static const uint32_t VERSION           = 4;
+  static const uint64_t DEFAULT_MAX_BYTES = 512ull * 1024 * 1024;
+
+  struct Stats
+  {
+    uint32_t hits    = 0;
+    uint32_t misses  = 0;
+    uint32_t stored  = 0;
+    uint32_t evicted = 0;
+  };
+
+  // optimized entries hold OptimizedPart geometry
+  static std::string makeKey(const std::string& filename, const LdrLoaderCreateInfo& info, bool optimized);
+
+  bool load(const std::string& filename);
+  bool save(const std::string& filename) const;
+
+  // starts the lookups and stores of a model load, resets the stats
+  void beginLoad();
+  // returns false on miss, renderPart is null if none was stored.
+  // The per model numInstances of the part is always 0.
+  bool lookup(const char* partName, const std::string& key, const LdrPart*& part, const LdrRenderPart*& renderPart);
+  void store(const char* partName, const std::string& key, const LdrPart* part, const LdrRenderPart* renderPart);
+  // drops least recently used entries until the cache fits, never those of the current load
+  void trim(uint64_t maxBytes = DEFAULT_MAX_BYTES);
+
+  bool isDirty() const { return m_dirty; }
+
+  const Stats& getStats() const { return m_stats; }
+
+private:
+  struct Entry
+  {
+    std::string                 key;
+    uint64_t                    lastUse = 0;  // generation of the last load that used the entry
+    std::string                 name;
+    std::vector<LdrVector>      positions;
+    std::vector<LdrVertexIndex> triangles;
+    std::vector<LdrVertexIndex> lines;
+    std::vector<LdrVertexIndex> optionalLines;
+    std::vector<LdrMaterialID>  triangleMaterials;
+
+    bool                         hasRenderPart = false;
+    std::vector<LdrRenderVertex> renderVertices;
+    std::vector<LdrVertexIndex>  renderTriangles;
+    std::vector<LdrVertexIndex>  renderLines;
+    std::vector<LdrVertexIndex>  renderTrianglesC;
+    std::vector<LdrMaterialID>   renderTriangleMaterials;
+    std::vector<LdrMaterialID>   renderMaterialsC;
+
+    // flags and counts the viewer reads, every pointer is redirected to the arrays above,
+    // all other fields of the loader's structs stay zero
+    LdrPart       part       = {};
+    LdrRenderPart renderPart = {};
+
+    void   setupViews();
+    bool   isConsistent() const;
+    size_t getBytes() const;
+  };
+
+  // by part name
+  std::unordered_map<std::string, Entry> m_entries;
+  uint64_t                               m_generation = 0;
+  Stats                                  m_stats;
+  bool                                   m_dirty = false;
+};
+
+}  // namespace ldrawviewer
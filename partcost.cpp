@@ -0,0 +1,248 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include "partcost.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <queue>
+
+namespace ldrawviewer {
+
+// used until the history provides a calibration
+static const double DEFAULT_COST_PER_BYTE = 0.05;
+// parts that cannot be found on disk (e.g. mpd embedded)
+static const uint64_t DEFAULT_FILE_SIZE = 4096;
+
+std::string findPartFile(const std::string& ldrawPath, const std::string& modelPath, const char* partName, bool hiRes)
+{
+  if(!partName || !partName[0])
+    return std::string();
+
+  std::string name(partName);
+  std::replace(name.begin(), name.end(), '\\', '/');
+  std::string nameLower(name);
+  std::transform(nameLower.begin(), nameLower.end(), nameLower.begin(), [](unsigned char c) { return char(tolower(c)); });
+
+  std::vector<std::filesystem::path> searchDirs;
+  if(!ldrawPath.empty()) {
+    std::filesystem::path base(ldrawPath);
+    if(hiRes) {
+      searchDirs.push_back(base / "p" / "48");
+    }
+    searchDirs.push_back(base / "parts");
+    searchDirs.push_back(base / "p");
+    searchDirs.push_back(base / "models");
+  }
+  if(!modelPath.empty()) {
+    searchDirs.push_back(std::filesystem::path(modelPath).parent_path());
+  }
+
+  std::error_code ec;
+  for(const std::filesystem::path& dir : searchDirs) {
+    std::filesystem::path path = dir / name;
+    if(std::filesystem::is_regular_file(path, ec))
+      return path.string();
+    path = dir / nameLower;
+    if(std::filesystem::is_regular_file(path, ec))
+      return path.string();
+  }
+
+  return std::string();
+}
+
+bool PartCostEstimator::loadHistory(const std::string& filename)
+{
+  FILE* file = fopen(filename.c_str(), "rt");
+  if(!file)
+    return false;
+
+  m_history.clear();
+  m_sumMicroSeconds = 0;
+  m_sumFileSize     = 0;
+
+  char               name[1024];
+  double             microSeconds;
+  unsigned long long fileSize;
+  while(fscanf(file, "%lf %llu %1023[^\n]\n", &microSeconds, &fileSize, name) == 3) {
+    updateHistory(name, microSeconds, uint64_t(fileSize));
+  }
+
+  fclose(file);
+  return true;
+}
+
+bool PartCostEstimator::saveHistory(const std::string& filename) const
+{
+  FILE* file = fopen(filename.c_str(), "wt");
+  if(!file)
+    return false;
+
+  for(const auto& it : m_history) {
+    fprintf(file, "%.3f %llu %s\n", it.second.microSeconds, (unsigned long long)it.second.fileSize, it.first.c_str());
+  }
+
+  fclose(file);
+  return true;
+}
+
+void PartCostEstimator::updateHistory(const char* partName, double microSeconds, uint64_t fileSize)
+{
+  if(!partName || !partName[0])
+    return;
+
+  Entry& entry = m_history[partName];
+  m_sumMicroSeconds += microSeconds - entry.microSeconds;
+  m_sumFileSize += fileSize - entry.fileSize;
+  entry = {microSeconds, fileSize};
+}
+
+double PartCostEstimator::getCostPerByte() const
+{
+  return m_sumFileSize ? m_sumMicroSeconds / double(m_sumFileSize) : DEFAULT_COST_PER_BYTE;
+}
+
+double PartCostEstimator::estimate(const char* partName, uint64_t fileSize, bool& fromHistory) const
+{
+  if(partName) {
+    auto it = m_history.find(partName);
+    if(it != m_history.end()) {
+      fromHistory = true;
+      return it->second.microSeconds;
+    }
+  }
+
+  fromHistory = false;
+  return double(fileSize) * getCostPerByte();
+}
+
+void buildPartSchedule(LdrLoaderHDL                  loader,
+                       const std::vector<LdrPartID>& partIds,
+                       const PartCostEstimator&      estimator,
+                       const std::string&            ldrawPath,
+                       const std::string&            modelPath,
+                       bool                          hiRes,
+                       uint32_t                      numWorkers,
+                       PartSchedule&                 schedule)
+{
+  uint32_t numParts = uint32_t(partIds.size());
+  numWorkers        = std::max(numWorkers, 1u);
+
+  schedule = PartSchedule();
+
+  std::vector<double>   costs(numParts);
+  std::vector<uint64_t> fileSizes(numParts);
+  for(uint32_t i = 0; i < numParts; i++) {
+    const LdrPart* part = ldrGetPart(loader, partIds[i]);
+    const char*    name = part ? part->name : nullptr;
+
+    uint64_t    fileSize = DEFAULT_FILE_SIZE;
+    std::string filename = findPartFile(ldrawPath, modelPath, name, hiRes);
+    if(!filename.empty()) {
+      std::error_code ec;
+      uintmax_t       size = std::filesystem::file_size(filename, ec);
+      if(!ec) {
+        fileSize = uint64_t(size);
+      }
+    }
+
+    bool fromHistory;
+    costs[i]     = estimator.estimate(name, fileSize, fromHistory);
+    fileSizes[i] = fileSize;
+    schedule.numFromHistory += fromHistory ? 1 : 0;
+    schedule.numFromFileSize += fromHistory ? 0 : 1;
+  }
+
+  // longest processing time first
+  std::vector<uint32_t> order(numParts);
+  for(uint32_t i = 0; i < numParts; i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return costs[a] > costs[b]; });
+
+  schedule.partIds.resize(numParts);
+  schedule.costs.resize(numParts);
+  schedule.fileSizes.resize(numParts);
+  for(uint32_t i = 0; i < numParts; i++) {
+    schedule.partIds[i]   = partIds[order[i]];
+    schedule.costs[i]     = costs[order[i]];
+    schedule.fileSizes[i] = fileSizes[order[i]];
+    schedule.estimatedTotal += schedule.costs[i];
+  }
+
+  // batches of roughly equal cost, expensive parts end up alone in their batch
+  double   batchCost = schedule.estimatedTotal / double(numWorkers * 8);
+  uint32_t maxBatch  = getWorkStealingBatchSize(numParts, numWorkers);
+
+  WorkStealingQueues::Batch batch = {0, 0};
+  double                    cost  = 0;
+  for(uint32_t i = 0; i < numParts; i++) {
+    cost += schedule.costs[i];
+    batch.end = i + 1;
+    if(cost >= batchCost || batch.end - batch.begin >= maxBatch) {
+      schedule.batches.push_back(batch);
+      batch.begin = batch.end;
+      cost        = 0;
+    }
+  }
+  if(batch.end > batch.begin) {
+    schedule.batches.push_back(batch);
+  }
+
+  // simulate LPT: every part goes to the worker that becomes idle first
+  std::priority_queue<double, std::vector<double>, std::greater<double>> workerLoad;
+  for(uint32_t w = 0; w < numWorkers; w++) {
+    workerLoad.push(0);
+  }
+  for(uint32_t i = 0; i < numParts; i++) {
+    double load = workerLoad.top() + schedule.costs[i];
+    workerLoad.pop();
+    workerLoad.push(load);
+    schedule.estimatedMakespan = std::max(schedule.estimatedMakespan, load);
+  }
+}
+
+void updatePartCostHistory(LdrLoaderHDL               loader,
+                           const PartSchedule&        schedule,
+                           const std::vector<double>& batchTimes,
+                           PartCostEstimator&         estimator)
+{
+  for(size_t b = 0; b < schedule.batches.size(); b++) {
+    const WorkStealingQueues::Batch& batch = schedule.batches[b];
+    if(batch.begin >= batchTimes.size())
+      continue;
+
+    double batchCost = 0;
+    for(uint32_t i = batch.begin; i < batch.end; i++) {
+      batchCost += schedule.costs[i];
+    }
+
+    for(uint32_t i = batch.begin; i < batch.end; i++) {
+      double share = batchCost > 0 ? schedule.costs[i] / batchCost : 1.0 / double(batch.end - batch.begin);
+
+      const LdrPart* part = ldrGetPart(loader, schedule.partIds[i]);
+      if(part) {
+        estimator.updateHistory(part->name, batchTimes[batch.begin] * share, schedule.fileSizes[i]);
+      }
+    }
+  }
+}
+
+}  // namespace ldrawviewer
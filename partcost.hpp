@@ -0,0 +1,95 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "external/ldrawloader/src/ldrawloader.h"
+
+#include "threadpool.hpp"
+
+namespace ldrawviewer {
+
+// searches the usual LDraw library folders for a part, returns empty string if not found
+std::string findPartFile(const std::string& ldrawPath, const std::string& modelPath, const char* partName, bool hiRes);
+
+// Estimates per-part loading cost in microseconds. Timings measured by
+// earlier runs are used where available, otherwise the on-disk file size
+// is scaled by a cost-per-byte factor that is calibrated from the history.
+class PartCostEstimator
+{
+public:
+  bool loadHistory(const std::string& filename);
+  bool saveHistory(const std::string& filename) const;
+
+  void   updateHistory(const char* partName, double microSeconds, uint64_t fileSize);
+  double estimate(const char* partName, uint64_t fileSize, bool& fromHistory) const;
+
+private:
+  struct Entry
+  {
+    double   microSeconds = 0;
+    uint64_t fileSize     = 0;
+  };
+
+  double getCostPerByte() const;
+
+  std::unordered_map<std::string, Entry> m_history;
+  // running sums over m_history for the cost-per-byte calibration
+  double   m_sumMicroSeconds = 0;
+  uint64_t m_sumFileSize     = 0;
+};
+
+// parts in longest-processing-time-first order with cost balanced batches
+struct PartSchedule
+{
+  std::vector<LdrPartID>                 partIds;
+  std::vector<double>                    costs;
+  std::vector<uint64_t>                  fileSizes;
+  std::vector<WorkStealingQueues::Batch> batches;
+
+  // of the load stage alone, the history holds load times only
+  double   estimatedMakespan = 0;
+  double   estimatedTotal    = 0;
+  uint32_t numFromHistory    = 0;
+  uint32_t numFromFileSize   = 0;
+};
+
+// schedules the given parts (typically all registered parts that need loading)
+void buildPartSchedule(LdrLoaderHDL                  loader,
+                       const std::vector<LdrPartID>& partIds,
+                       const PartCostEstimator&      estimator,
+                       const std::string&            ldrawPath,
+                       const std::string&            modelPath,
+                       bool                          hiRes,
+                       uint32_t                      numWorkers,
+                       PartSchedule&                 schedule);
+
+// feeds measured per-batch load timings back into the history, batchTimes is indexed
+// by the first item of each batch, its time is split across the parts of the batch
+// according to their estimates. Only loading is timed, the history estimates nothing else.
+void updatePartCostHistory(LdrLoaderHDL               loader,
+                           const PartSchedule&        schedule,
+                           const std::vector<double>& batchTimes,
+                           PartCostEstimator&         estimator);
+
+}  // namespace ldrawviewer
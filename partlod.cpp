@@ -0,0 +1,654 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include "partlod.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace ldrawviewer {
+
+// share of the full triangle count each level aims for, and the largest error it may accept relative to the bbox diagonal
+static const float LOD_TRIANGLE_RATIO[PART_LOD_LEVELS - 1] = {0.25f, 0.0625f, 0.015625f};
+static const float LOD_ERROR_RATIO[PART_LOD_LEVELS - 1]    = {0.005f, 0.02f, 0.08f};
+// components below this size relative to the bbox diagonal count as details, e.g. studs
+static const float LOD_COMPONENT_RATIO = 0.25f;
+// a collapse may not rotate a remaining triangle further than ~75 degrees
+static const float LOD_MAX_FLIP = 0.25f;
+
+struct Quadric
+{
+  // upper triangle of the symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww
+  double m[10]  = {};
+  double weight = 0;
+
+  void addPlane(const double n[3], double d, double w)
+  {
+    double p[4] = {n[0], n[1], n[2], d};
+    int    k    = 0;
+    for(int r = 0; r < 4; r++) {
+      for(int c = r; c < 4; c++) {
+        m[k++] += w * p[r] * p[c];
+      }
+    }
+    weight += w;
+  }
+  void add(const Quadric& other)
+  {
+    for(int k = 0; k < 10; k++) {
+      m[k] += other.m[k];
+    }
+    weight += other.weight;
+  }
+  double evaluate(const float p[3]) const
+  {
+    double x = p[0], y = p[1], z = p[2];
+    return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x + m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+           + m[7] * z * z + 2 * m[8] * z + m[9];
+  }
+};
+
+static void getTriangleNormal(const float* a, const float* b, const float* c, double n[3])
+{
+  double e0[3] = {double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2]};
+  double e1[3] = {double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2]};
+  n[0]         = e0[1] * e1[2] - e0[2] * e1[1];
+  n[1]         = e0[2] * e1[0] - e0[0] * e1[2];
+  n[2]         = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+// Works on welded positions. Collapses are applied in passes of independent collapses,
+// cheapest first, so the adjacency only has to be rebuilt once per pass.
+class LodSimplifier
+{
+public:
+  void init(const uint32_t* triangles,
+            uint32_t        numTriangles,
+            const uint32_t* lines,
+            uint32_t        numLines,
+            const void*     vertices,
+            size_t          vertexSize,
+            uint32_t        numVertices);
+
+  // returns the triangle count reached, stops early when every collapse exceeds maxError
+  uint32_t simplify(uint32_t targetTriangles, float maxError);
+  // drops disconnected details like studs that sit on a closed surface, when they are thinner than
+  // maxError and smaller than maxSize, returns the triangle count left
+  uint32_t removeSmallComponents(float maxError, float maxSize);
+
+  uint32_t getNumTriangles() const { return uint32_t(m_triangles.size() / 3); }
+  float    getError() const { return float(std::sqrt(m_maxErrorSq)); }
+  // welded vertex and source triangle of each remaining corner
+  const std::vector<uint32_t>& getTriangles() const { return m_triangles; }
+  const std::vector<uint32_t>& getSourceTriangles() const { return m_sourceTriangles; }
+  const std::vector<uint32_t>& getWelded() const { return m_welded; }
+
+private:
+  struct Candidate
+  {
+    double   error;
+    uint32_t from;
+    uint32_t to;
+  };
+
+  const float* getPosition(uint32_t welded) const { return &m_positions[welded * 3]; }
+  void         buildAdjacency();
+  bool         isCollapseAllowed(uint32_t from, uint32_t to) const;
+  bool         isFlipFree(uint32_t from, uint32_t to) const;
+  void         collapseFeature(uint32_t from, uint32_t to);
+
+  std::vector<uint32_t> m_welded;     // per source vertex
+  std::vector<float>    m_positions;  // per welded vertex
+  std::vector<Quadric>  m_quadrics;
+
+  // feature curves, only vertices with exactly two feature neighbours may move along them
+  std::vector<uint32_t> m_featureDegree;
+  std::vector<uint32_t> m_featureLinks;  // two per welded vertex
+
+  std::vector<uint32_t> m_triangles;
+  std::vector<uint32_t> m_sourceTriangles;
+  std::vector<uint32_t> m_adjacencyOffsets;
+  std::vector<uint32_t> m_adjacency;
+
+  double m_maxErrorSq = 0;
+};
+
+void LodSimplifier::init(const uint32_t* triangles,
+                         uint32_t        numTriangles,
+                         const uint32_t* lines,
+                         uint32_t        numLines,
+                         const void*     vertices,
+                         size_t          vertexSize,
+                         uint32_t        numVertices)
+{
+  auto getSourcePosition = [&](uint32_t v) { return (const float*)((const uint8_t*)vertices + vertexSize * v); };
+
+  // weld equal positions, sorting keeps this deterministic
+  std::vector<uint32_t> order(numVertices);
+  for(uint32_t v = 0; v < numVertices; v++) {
+    order[v] = v;
+  }
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    const float* pa = getSourcePosition(a);
+    const float* pb = getSourcePosition(b);
+    if(pa[0] != pb[0])
+      return pa[0] < pb[0];
+    if(pa[1] != pb[1])
+      return pa[1] < pb[1];
+    if(pa[2] != pb[2])
+      return pa[2] < pb[2];
+    return a < b;
+  });
+
+  m_welded.assign(numVertices, 0);
+  m_positions.clear();
+  for(uint32_t i = 0; i < numVertices; i++) {
+    const float* pos = getSourcePosition(order[i]);
+    if(i == 0 || memcmp(pos, getSourcePosition(order[i - 1]), sizeof(float) * 3) != 0) {
+      m_positions.insert(m_positions.end(), pos, pos + 3);
+    }
+    m_welded[order[i]] = uint32_t(m_positions.size() / 3) - 1;
+  }
+  uint32_t numWelded = uint32_t(m_positions.size() / 3);
+
+  // triangles that are degenerate after welding are dropped right away
+  m_triangles.clear();
+  m_sourceTriangles.clear();
+  for(uint32_t t = 0; t < numTriangles; t++) {
+    const uint32_t* tri = &triangles[t * 3];
+    if(tri[0] >= numVertices || tri[1] >= numVertices || tri[2] >= numVertices)
+      continue;
+
+    uint32_t a = m_welded[tri[0]];
+    uint32_t b = m_welded[tri[1]];
+    uint32_t c = m_welded[tri[2]];
+    if(a == b || b == c || a == c)
+      continue;
+
+    m_triangles.insert(m_triangles.end(), {a, b, c});
+    m_sourceTriangles.push_back(t);
+  }
+
+  // area weighted plane of every triangle
+  m_quadrics.assign(numWelded, Quadric());
+  for(size_t t = 0; t < m_triangles.size(); t += 3) {
+    double n[3];
+    getTriangleNormal(getPosition(m_triangles[t]), getPosition(m_triangles[t + 1]), getPosition(m_triangles[t + 2]), n);
+    double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if(len <= 0)
+      continue;
+
+    const float* p     = getPosition(m_triangles[t]);
+    double       un[3] = {n[0] / len, n[1] / len, n[2] / len};
+    double       d     = -(un[0] * p[0] + un[1] * p[1] + un[2] * p[2]);
+    for(int k = 0; k < 3; k++) {
+      m_quadrics[m_triangles[t + k]].addPlane(un, d, len * 0.5);
+    }
+  }
+
+  // feature edges: edge lines, and triangle edges not shared by exactly two triangles
+  struct Edge
+  {
+    uint32_t a;
+    uint32_t b;
+    uint32_t triangle;  // ~0u for edge lines
+    bool     operator<(const Edge& other) const { return a != other.a ? a < other.a : b < other.b; }
+  };
+  std::vector<Edge> edges;
+  edges.reserve(m_triangles.size());
+  for(size_t t = 0; t < m_triangles.size(); t += 3) {
+    for(int k = 0; k < 3; k++) {
+      uint32_t a = m_triangles[t + k];
+      uint32_t b = m_triangles[t + (k + 1) % 3];
+      edges.push_back({std::min(a, b), std::max(a, b), uint32_t(t / 3)});
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+
+  std::vector<Edge> features;
+  for(size_t e = 0; e < edges.size();) {
+    size_t next = e + 1;
+    while(next < edges.size() && edges[next].a == edges[e].a && edges[next].b == edges[e].b) {
+      next++;
+    }
+    if(next - e != 2) {
+      features.push_back(edges[e]);
+    }
+    e = next;
+  }
+  for(uint32_t l = 0; l < numLines; l++) {
+    if(lines[l * 2] >= numVertices || lines[l * 2 + 1] >= numVertices)
+      continue;
+
+    uint32_t a = m_welded[lines[l * 2]];
+    uint32_t b = m_welded[lines[l * 2 + 1]];
+    if(a == b)
+      continue;
+
+    // an adjacent triangle orients the constraint plane
+    Edge edge = {std::min(a, b), std::max(a, b), ~0u};
+    auto it   = std::lower_bound(edges.begin(), edges.end(), edge);
+    if(it != edges.end() && it->a == edge.a && it->b == edge.b) {
+      edge.triangle = it->triangle;
+    }
+    features.push_back(edge);
+  }
+  std::sort(features.begin(), features.end());
+  features.erase(std::unique(features.begin(), features.end(),
+                             [](const Edge& x, const Edge& y) { return x.a == y.a && x.b == y.b; }),
+                 features.end());
+
+  m_featureDegree.assign(numWelded, 0);
+  m_featureLinks.assign(size_t(numWelded) * 2, ~0u);
+  for(const Edge& edge : features) {
+    uint32_t ends[2] = {edge.a, edge.b};
+    for(int k = 0; k < 2; k++) {
+      uint32_t v = ends[k];
+      if(m_featureDegree[v] < 2) {
+        m_featureLinks[v * 2 + m_featureDegree[v]] = ends[1 - k];
+      }
+      m_featureDegree[v]++;
+    }
+
+    // plane through the edge, perpendicular to its triangle, keeps the curve in place
+    if(edge.triangle == ~0u)
+      continue;
+
+    const uint32_t* tri = &m_triangles[edge.triangle * 3];
+    double          n[3];
+    getTriangleNormal(getPosition(tri[0]), getPosition(tri[1]), getPosition(tri[2]), n);
+
+    const float* pa     = getPosition(edge.a);
+    const float* pb     = getPosition(edge.b);
+    double       dir[3] = {double(pb[0]) - pa[0], double(pb[1]) - pa[1], double(pb[2]) - pa[2]};
+    double       pn[3]  = {dir[1] * n[2] - dir[2] * n[1], dir[2] * n[0] - dir[0] * n[2], dir[0] * n[1] - dir[1] * n[0]};
+    double       len    = std::sqrt(pn[0] * pn[0] + pn[1] * pn[1] + pn[2] * pn[2]);
+    double       lenSq  = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+    if(len <= 0)
+      continue;
+
+    pn[0] /= len;
+    pn[1] /= len;
+    pn[2] /= len;
+    double d = -(pn[0] * pa[0] + pn[1] * pa[1] + pn[2] * pa[2]);
+    m_quadrics[edge.a].addPlane(pn, d, lenSq);
+    m_quadrics[edge.b].addPlane(pn, d, lenSq);
+  }
+
+  m_maxErrorSq = 0;
+}
+
+void LodSimplifier::buildAdjacency()
+{
+  uint32_t numWelded = uint32_t(m_positions.size() / 3);
+  m_adjacencyOffsets.assign(numWelded + 1, 0);
+  for(uint32_t v : m_triangles) {
+    m_adjacencyOffsets[v + 1]++;
+  }
+  for(uint32_t v = 0; v < numWelded; v++) {
+    m_adjacencyOffsets[v + 1] += m_adjacencyOffsets[v];
+  }
+  m_adjacency.resize(m_triangles.size());
+  std::vector<uint32_t> fill(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+  for(size_t i = 0; i < m_triangles.size(); i++) {
+    m_adjacency[fill[m_triangles[i]]++] = uint32_t(i / 3);
+  }
+}
+
+bool LodSimplifier::isCollapseAllowed(uint32_t from, uint32_t to) const
+{
+  uint32_t degree = m_featureDegree[from];
+  if(degree == 0)
+    return true;
+  return degree == 2 && (m_featureLinks[from * 2] == to || m_featureLinks[from * 2 + 1] == to);
+}
+
+bool LodSimplifier::isFlipFree(uint32_t from, uint32_t to) const
+{
+  for(uint32_t i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; i++) {
+    const uint32_t* tri = &m_triangles[m_adjacency[i] * 3];
+    if(tri[0] == to || tri[1] == to || tri[2] == to)
+      continue;
+
+    const float* before[3];
+    const float* after[3];
+    for(int k = 0; k < 3; k++) {
+      before[k] = getPosition(tri[k]);
+      after[k]  = getPosition(tri[k] == from ? to : tri[k]);
+    }
+    double n0[3];
+    double n1[3];
+    getTriangleNormal(before[0], before[1], before[2], n0);
+    getTriangleNormal(after[0], after[1], after[2], n1);
+
+    double dot  = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+    double len0 = std::sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+    double len1 = std::sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+    if(len1 <= 0 || dot <= LOD_MAX_FLIP * len0 * len1)
+      return false;
+  }
+  return true;
+}
+
+void LodSimplifier::collapseFeature(uint32_t from, uint32_t to)
+{
+  if(m_featureDegree[from] != 2)
+    return;
+
+  // the curve skips from, its other neighbour now links to the target
+  uint32_t other = m_featureLinks[from * 2] == to ? m_featureLinks[from * 2 + 1] : m_featureLinks[from * 2];
+
+  auto relink = [&](uint32_t v, uint32_t oldLink, uint32_t newLink) {
+    if(m_featureDegree[v] != 2)
+      return;
+    for(int k = 0; k < 2; k++) {
+      if(m_featureLinks[v * 2 + k] == oldLink) {
+        m_featureLinks[v * 2 + k] = newLink;
+      }
+    }
+    // a closed curve shrank to a single segment, its ends stay
+    if(m_featureLinks[v * 2] == m_featureLinks[v * 2 + 1]) {
+      m_featureDegree[v] = 1;
+    }
+  };
+  relink(to, from, other);
+  relink(other, from, to);
+  m_featureDegree[from] = 0;
+}
+
+uint32_t LodSimplifier::simplify(uint32_t targetTriangles, float maxError)
+{
+  uint32_t               numWelded  = uint32_t(m_positions.size() / 3);
+  double                 maxErrorSq = double(maxError) * double(maxError);
+  std::vector<Candidate> candidates;
+  std::vector<uint8_t>   locked;
+  std::vector<uint32_t>  remap;
+
+  while(getNumTriangles() > targetTriangles) {
+    buildAdjacency();
+
+    // cheapest allowed collapse per vertex
+    candidates.clear();
+    for(uint32_t from = 0; from < numWelded; from++) {
+      if(m_adjacencyOffsets[from] == m_adjacencyOffsets[from + 1] || (m_featureDegree[from] != 0 && m_featureDegree[from] != 2))
+        continue;
+
+      Candidate best = {DBL_MAX, from, from};
+      for(uint32_t i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; i++) {
+        const uint32_t* tri = &m_triangles[m_adjacency[i] * 3];
+        for(int k = 0; k < 3; k++) {
+          uint32_t to = tri[k];
+          if(to == from || !isCollapseAllowed(from, to))
+            continue;
+
+          const Quadric& qa     = m_quadrics[from];
+          const Quadric& qb     = m_quadrics[to];
+          double         weight = qa.weight + qb.weight;
+          double         error  = weight > 0 ? (qa.evaluate(getPosition(to)) + qb.evaluate(getPosition(to))) / weight : 0.0;
+          error                 = std::max(error, 0.0);
+          if(error < best.error) {
+            best = {error, from, to};
+          }
+        }
+      }
+      if(best.to != from && best.error <= maxErrorSq) {
+        candidates.push_back(best);
+      }
+    }
+    if(candidates.empty())
+      break;
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+      return a.error != b.error ? a.error < b.error : a.from < b.from;
+    });
+
+    // every collapse removes about two triangles, collapses of one pass must not share triangles
+    uint32_t maxCollapses = (getNumTriangles() - targetTriangles + 1) / 2;
+    uint32_t collapses    = 0;
+    locked.assign(numWelded, 0);
+    remap.resize(numWelded);
+    for(uint32_t v = 0; v < numWelded; v++) {
+      remap[v] = v;
+    }
+
+    for(const Candidate& candidate : candidates) {
+      if(collapses >= std::max(maxCollapses, 1u))
+        break;
+      if(locked[candidate.from] || locked[candidate.to] || !isFlipFree(candidate.from, candidate.to))
+        continue;
+
+      remap[candidate.from] = candidate.to;
+      m_quadrics[candidate.to].add(m_quadrics[candidate.from]);
+      collapseFeature(candidate.from, candidate.to);
+      m_maxErrorSq = std::max(m_maxErrorSq, candidate.error);
+
+      for(uint32_t i = m_adjacencyOffsets[candidate.from]; i < m_adjacencyOffsets[candidate.from + 1]; i++) {
+        const uint32_t* tri = &m_triangles[m_adjacency[i] * 3];
+        locked[tri[0]]      = 1;
+        locked[tri[1]]      = 1;
+        locked[tri[2]]      = 1;
+      }
+      locked[candidate.to] = 1;
+      collapses++;
+    }
+    if(!collapses)
+      break;
+
+    // remap and drop what became degenerate
+    size_t write = 0;
+    for(size_t t = 0; t < m_triangles.size() / 3; t++) {
+      uint32_t a = remap[m_triangles[t * 3 + 0]];
+      uint32_t b = remap[m_triangles[t * 3 + 1]];
+      uint32_t c = remap[m_triangles[t * 3 + 2]];
+      if(a == b || b == c || a == c)
+        continue;
+
+      m_triangles[write * 3 + 0] = a;
+      m_triangles[write * 3 + 1] = b;
+      m_triangles[write * 3 + 2] = c;
+      m_sourceTriangles[write]   = m_sourceTriangles[t];
+      write++;
+    }
+    m_triangles.resize(write * 3);
+    m_sourceTriangles.resize(write);
+  }
+
+  return getNumTriangles();
+}
+
+uint32_t LodSimplifier::removeSmallComponents(float maxError, float maxSize)
+{
+  uint32_t numWelded = uint32_t(m_positions.size() / 3);
+
+  // union-find over the vertices of the remaining triangles
+  std::vector<uint32_t> parent(numWelded);
+  for(uint32_t v = 0; v < numWelded; v++) {
+    parent[v] = v;
+  }
+  auto find = [&](uint32_t v) {
+    while(parent[v] != v) {
+      parent[v] = parent[parent[v]];
+      v         = parent[v];
+    }
+    return v;
+  };
+  for(size_t i = 0; i < m_triangles.size(); i += 3) {
+    for(int k = 1; k < 3; k++) {
+      uint32_t a = find(m_triangles[i]);
+      uint32_t b = find(m_triangles[i + k]);
+      if(a != b) {
+        parent[std::max(a, b)] = std::min(a, b);
+      }
+    }
+  }
+
+  std::vector<float> bounds(size_t(numWelded) * 6);
+  for(uint32_t v = 0; v < numWelded; v++) {
+    for(int c = 0; c < 3; c++) {
+      bounds[v * 6 + c]     = FLT_MAX;
+      bounds[v * 6 + 3 + c] = -FLT_MAX;
+    }
+  }
+  for(uint32_t v : m_triangles) {
+    uint32_t     root = find(v);
+    const float* pos  = getPosition(v);
+    for(int c = 0; c < 3; c++) {
+      bounds[root * 6 + c]     = std::min(bounds[root * 6 + c], pos[c]);
+      bounds[root * 6 + 3 + c] = std::max(bounds[root * 6 + 3 + c], pos[c]);
+    }
+  }
+
+  // the thinnest extent is what removing the component moves the surface by at most
+  std::vector<uint8_t> removed(numWelded, 0);
+  for(uint32_t v = 0; v < numWelded; v++) {
+    if(find(v) != v || bounds[v * 6] > bounds[v * 6 + 3])
+      continue;
+
+    float extent[3];
+    for(int c = 0; c < 3; c++) {
+      extent[c] = bounds[v * 6 + 3 + c] - bounds[v * 6 + c];
+    }
+    float thickness = std::min(extent[0], std::min(extent[1], extent[2]));
+    float size      = std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+    if(thickness <= maxError && size <= maxSize) {
+      removed[v]   = 1;
+      m_maxErrorSq = std::max(m_maxErrorSq, double(thickness) * double(thickness));
+    }
+  }
+
+  size_t write = 0;
+  for(size_t t = 0; t < m_triangles.size() / 3; t++) {
+    if(removed[find(m_triangles[t * 3])])
+      continue;
+
+    for(int k = 0; k < 3; k++) {
+      m_triangles[write * 3 + k] = m_triangles[t * 3 + k];
+    }
+    m_sourceTriangles[write] = m_sourceTriangles[t];
+    write++;
+  }
+  m_triangles.resize(write * 3);
+  m_sourceTriangles.resize(write);
+
+  return getNumTriangles();
+}
+
+void buildPartLodChain(const uint32_t* triangles,
+                       uint32_t        numTriangles,
+                       const uint32_t* lines,
+                       uint32_t        numLines,
+                       const void*     vertices,
+                       size_t          vertexSize,
+                       size_t          normalOffset,
+                       uint32_t        numVertices,
+                       bool            hasNormals,
+                       PartLodChain&   chain)
+{
+  chain = PartLodChain();
+  if(!numTriangles || !numVertices)
+    return;
+
+  auto getSourcePosition = [&](uint32_t v) { return (const float*)((const uint8_t*)vertices + vertexSize * v); };
+  auto getSourceNormal   = [&](uint32_t v) { return (const float*)((const uint8_t*)vertices + vertexSize * v + normalOffset); };
+
+  float bmin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float bmax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for(uint32_t v = 0; v < numVertices; v++) {
+    const float* pos = getSourcePosition(v);
+    for(int c = 0; c < 3; c++) {
+      bmin[c] = std::min(bmin[c], pos[c]);
+      bmax[c] = std::max(bmax[c], pos[c]);
+    }
+  }
+  float diagonal = std::sqrt((bmax[0] - bmin[0]) * (bmax[0] - bmin[0]) + (bmax[1] - bmin[1]) * (bmax[1] - bmin[1])
+                             + (bmax[2] - bmin[2]) * (bmax[2] - bmin[2]));
+
+  LodSimplifier simplifier;
+  simplifier.init(triangles, numTriangles, lines, numLines, vertices, vertexSize, numVertices);
+
+  const std::vector<uint32_t>& welded = simplifier.getWelded();
+
+  // source vertices per welded vertex, to find split copies
+  uint32_t              numWelded = 0;
+  for(uint32_t w : welded) {
+    numWelded = std::max(numWelded, w + 1);
+  }
+  std::vector<uint32_t> groupOffsets(numWelded + 1, 0);
+  std::vector<uint32_t> groupVertices(numVertices);
+  for(uint32_t w : welded) {
+    groupOffsets[w + 1]++;
+  }
+  for(uint32_t w = 0; w < numWelded; w++) {
+    groupOffsets[w + 1] += groupOffsets[w];
+  }
+  {
+    std::vector<uint32_t> fill(groupOffsets.begin(), groupOffsets.end() - 1);
+    for(uint32_t v = 0; v < numVertices; v++) {
+      groupVertices[fill[welded[v]]++] = v;
+    }
+  }
+
+  uint32_t previous = numTriangles;
+  for(uint32_t level = 0; level < PART_LOD_LEVELS - 1; level++) {
+    uint32_t target = uint32_t(float(numTriangles) * LOD_TRIANGLE_RATIO[level]);
+    float    error  = diagonal * LOD_ERROR_RATIO[level];
+    uint32_t result = simplifier.simplify(target, error);
+    if(result > target) {
+      result = simplifier.removeSmallComponents(error, diagonal * LOD_COMPONENT_RATIO);
+    }
+
+    // not worth an index range, later levels may still get further with a larger error
+    if(!result || result * 4 > previous * 3)
+      continue;
+
+    std::vector<uint32_t>&       lod     = chain.triangles[chain.numLevels];
+    const std::vector<uint32_t>& current = simplifier.getTriangles();
+    const std::vector<uint32_t>& sources = simplifier.getSourceTriangles();
+    lod.resize(current.size());
+    for(size_t t = 0; t < sources.size(); t++) {
+      for(int k = 0; k < 3; k++) {
+        uint32_t vertex       = triangles[sources[t] * 3 + k];
+        uint32_t targetVertex = current[t * 3 + k];
+        if(welded[vertex] != targetVertex) {
+          // the copy of the target position whose normal is closest to the corner's original one
+          uint32_t best    = groupVertices[groupOffsets[targetVertex]];
+          float    bestDot = -FLT_MAX;
+          for(uint32_t i = groupOffsets[targetVertex]; hasNormals && i < groupOffsets[targetVertex + 1]; i++) {
+            const float* n0  = getSourceNormal(vertex);
+            const float* n1  = getSourceNormal(groupVertices[i]);
+            float        dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+            if(dot > bestDot) {
+              best    = groupVertices[i];
+              bestDot = dot;
+            }
+          }
+          vertex = best;
+        }
+        lod[t * 3 + k] = vertex;
+      }
+    }
+    chain.error[chain.numLevels] = simplifier.getError();
+    chain.numLevels++;
+    previous = result;
+  }
+}
+
+}  // namespace ldrawviewer
@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ldrawviewer {
+
+// Simplified triangle lists per part for instances far away from the camera. Every level
+// references the part's own vertices, so it is just another index range over the same
+// vertex range and needs no extra vertex data.
+
+// levels including the full geometry
+static const uint32_t PART_LOD_LEVELS = 4;
+
+struct PartLodChain
+{
+  // simplified levels 1 to numLevels are in triangles[level - 1], with fewer triangles each
+  uint32_t              numLevels = 0;
+  std::vector<uint32_t> triangles[PART_LOD_LEVELS - 1];
+  // approximate object space deviation from the full geometry
+  float error[PART_LOD_LEVELS - 1] = {};
+};
+
+// Quadric error edge collapses onto existing vertices (Garland and Heckbert). Positions are
+// welded, so vertices split for normals do not tear the surface, and corners pick the split
+// copy with the closest normal afterwards. Edge lines and open borders are feature curves:
+// their vertices only collapse along the curve, ends and junctions of curves never move.
+// Levels are relative to the bbox diagonal of the part, a level is only kept if it removes
+// at least a quarter of the previous one's triangles. position must be the first member of
+// the vertex, normals are optional.
+void buildPartLodChain(const uint32_t* triangles,
+                       uint32_t        numTriangles,
+                       const uint32_t* lines,
+                       uint32_t        numLines,
+                       const void*     vertices,
+                       size_t          vertexSize,
+                       size_t          normalOffset,
+                       uint32_t        numVertices,
+                       bool            hasNormals,
+                       PartLodChain&   chain);
+
+}  // namespace ldrawviewer
@@ -0,0 +1,471 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "partoptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace ldrawviewer {
+
+void simulateVertexCache(const uint32_t* indices, uint32_t numTriangles, uint32_t numVertices, uint32_t cacheSize, VertexCacheStats& stats)
+{
+  stats = VertexCacheStats();
+
+  // a vertex is cached while fewer than cacheSize misses happened since its own, 0 means never seen
+  std::vector<uint32_t> timestamps(numVertices, 0);
+  uint32_t              time = cacheSize + 1;
+
+  for(uint32_t i = 0; i < numTriangles * 3; i++) {
+    uint32_t vertex = indices[i];
+    if(vertex >= numVertices)
+      continue;
+
+    if(!timestamps[vertex]) {
+      stats.vertices++;
+    }
+    if(time - timestamps[vertex] > cacheSize) {
+      timestamps[vertex] = time++;
+      stats.transformed++;
+    }
+  }
+  stats.triangles = numTriangles;
+}
+
+// scoring model of Forsyth's article, the cache size here is larger than the simulated one on purpose
+static const uint32_t FORSYTH_CACHE_SIZE = 32;
+
+static float getForsythScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+  if(!remainingTriangles)
+    return -1.0f;
+
+  float score = 0;
+  if(cachePosition >= 0) {
+    // the last triangle's vertices get a fixed score, so the next one does not simply reuse its edge
+    if(cachePosition < 3) {
+      score = 0.75f;
+    }
+    else {
+      float scale = 1.0f / float(FORSYTH_CACHE_SIZE - 3);
+      score       = powf(1.0f - float(cachePosition - 3) * scale, 1.5f);
+    }
+  }
+
+  // vertices with few triangles left are finished first, so they do not linger
+  return score + 2.0f * powf(float(remainingTriangles), -0.5f);
+}
+
+void optimizeVertexCache(const uint32_t* indices, uint32_t numTriangles, uint32_t numVertices, std::vector<uint32_t>& order)
+{
+  order.clear();
+  order.reserve(numTriangles);
+  if(!numTriangles)
+    return;
+
+  // triangles per vertex, a vertex's unfinished triangles are kept at the front of its range
+  std::vector<uint32_t> remaining(numVertices, 0);
+  for(uint32_t i = 0; i < numTriangles * 3; i++) {
+    remaining[indices[i]]++;
+  }
+  std::vector<uint32_t> offsets(numVertices + 1, 0);
+  for(uint32_t v = 0; v < numVertices; v++) {
+    offsets[v + 1] = offsets[v] + remaining[v];
+  }
+  std::vector<uint32_t> adjacency(numTriangles * 3);
+  {
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for(uint32_t i = 0; i < numTriangles * 3; i++) {
+      adjacency[fill[indices[i]]++] = i / 3;
+    }
+  }
+
+  std::vector<int32_t> cachePositions(numVertices, -1);
+  std::vector<float>   vertexScores(numVertices);
+  for(uint32_t v = 0; v < numVertices; v++) {
+    vertexScores[v] = getForsythScore(-1, remaining[v]);
+  }
+
+  std::vector<float>   triangleScores(numTriangles);
+  std::vector<uint8_t> emitted(numTriangles, 0);
+  for(uint32_t t = 0; t < numTriangles; t++) {
+    const uint32_t* tri = &indices[t * 3];
+    triangleScores[t]   = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+  }
+
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> newCache;
+  cache.reserve(FORSYTH_CACHE_SIZE + 3);
+  newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+  uint32_t best   = ~0u;
+  uint32_t cursor = 0;
+  while(order.size() < numTriangles) {
+    // nothing in the cache has triangles left, continue in input order, searching the best of the
+    // rest would be quadratic for parts made of many small pieces such as studs
+    if(best == ~0u) {
+      while(emitted[cursor]) {
+        cursor++;
+      }
+      best = cursor;
+    }
+
+    order.push_back(best);
+    emitted[best] = 1;
+
+    const uint32_t* tri = &indices[best * 3];
+    for(uint32_t c = 0; c < 3; c++) {
+      uint32_t  vertex = tri[c];
+      uint32_t* begin  = &adjacency[offsets[vertex]];
+      uint32_t* last   = begin + remaining[vertex] - 1;
+      *std::find(begin, last + 1, best) = *last;
+      remaining[vertex]--;
+    }
+
+    // the triangle's vertices move to the front, the rest keeps its order
+    newCache.clear();
+    for(uint32_t c = 0; c < 3; c++) {
+      if(std::find(newCache.begin(), newCache.end(), tri[c]) == newCache.end()) {
+        newCache.push_back(tri[c]);
+      }
+    }
+    for(uint32_t vertex : cache) {
+      if(std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()) {
+        newCache.push_back(vertex);
+      }
+    }
+
+    for(uint32_t i = 0; i < uint32_t(newCache.size()); i++) {
+      uint32_t vertex        = newCache[i];
+      cachePositions[vertex] = i < FORSYTH_CACHE_SIZE ? int32_t(i) : -1;
+      vertexScores[vertex]   = getForsythScore(cachePositions[vertex], remaining[vertex]);
+    }
+
+    // only triangles around cached or just evicted vertices changed
+    best            = ~0u;
+    float bestScore = -1.0f;
+    for(uint32_t vertex : newCache) {
+      for(uint32_t a = 0; a < remaining[vertex]; a++) {
+        uint32_t        t     = adjacency[offsets[vertex] + a];
+        const uint32_t* other = &indices[t * 3];
+        triangleScores[t]     = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+        if(triangleScores[t] > bestScore) {
+          best      = t;
+          bestScore = triangleScores[t];
+        }
+      }
+    }
+
+    newCache.resize(std::min(uint32_t(newCache.size()), FORSYTH_CACHE_SIZE));
+    std::swap(cache, newCache);
+  }
+}
+
+static inline LdrVector getPosition(const void* vertices, size_t vertexSize, uint32_t index)
+{
+  LdrVector position;
+  memcpy(&position, (const uint8_t*)vertices + vertexSize * index, sizeof(position));
+  return position;
+}
+
+void optimizeOverdraw(const uint32_t*        indices,
+                      uint32_t               numTriangles,
+                      const void*            vertices,
+                      size_t                 vertexSize,
+                      uint32_t               numVertices,
+                      float                  threshold,
+                      std::vector<uint32_t>& order)
+{
+  if(numTriangles < 2)
+    return;
+
+  std::vector<uint32_t> ordered(numTriangles * 3);
+  for(uint32_t t = 0; t < numTriangles; t++) {
+    memcpy(&ordered[t * 3], &indices[order[t] * 3], sizeof(uint32_t) * 3);
+  }
+
+  VertexCacheStats total;
+  simulateVertexCache(ordered.data(), numTriangles, numVertices, VERTEX_CACHE_SIZE, total);
+  float clusterThreshold = threshold * total.getAcmr();
+
+  // hard boundaries where a triangle misses all three vertices, the cache starts over there anyway
+  std::vector<uint32_t> hardClusters;
+  std::vector<uint32_t> timestamps(numVertices, 0);
+  uint32_t              time = VERTEX_CACHE_SIZE + 1;
+
+  auto countMisses = [&](uint32_t t) {
+    uint32_t misses = 0;
+    for(uint32_t c = 0; c < 3; c++) {
+      uint32_t vertex = ordered[t * 3 + c];
+      if(time - timestamps[vertex] > VERTEX_CACHE_SIZE) {
+        timestamps[vertex] = time++;
+        misses++;
+      }
+    }
+    return misses;
+  };
+
+  for(uint32_t t = 0; t < numTriangles; t++) {
+    if(countMisses(t) == 3) {
+      hardClusters.push_back(t);
+    }
+  }
+  hardClusters.push_back(numTriangles);
+
+  // soft boundaries within, a cluster ends as soon as it is about as cache efficient from a cold
+  // cache as the whole order, so any cluster order stays close to the original ACMR
+  std::vector<uint32_t> clusters;
+  for(size_t h = 0; h + 1 < hardClusters.size(); h++) {
+    uint32_t clusterMisses    = 0;
+    uint32_t clusterTriangles = 0;
+
+    for(uint32_t t = hardClusters[h]; t < hardClusters[h + 1]; t++) {
+      if(!clusterTriangles) {
+        clusters.push_back(t);
+        time += VERTEX_CACHE_SIZE + 1;
+      }
+
+      clusterMisses += countMisses(t);
+      clusterTriangles++;
+
+      if(float(clusterMisses) <= clusterThreshold * float(clusterTriangles)) {
+        clusterMisses    = 0;
+        clusterTriangles = 0;
+      }
+    }
+  }
+  if(clusters.size() < 2)
+    return;
+
+  clusters.push_back(numTriangles);
+  uint32_t numClusters = uint32_t(clusters.size()) - 1;
+
+  // area weighted centroids and normals
+  struct Cluster
+  {
+    uint32_t  begin;
+    uint32_t  end;
+    LdrVector centroid;
+    LdrVector normal;
+    float     area;
+    float     sortKey;
+  };
+  std::vector<Cluster> clusterData(numClusters);
+  LdrVector            meshCentroid = {0, 0, 0};
+  float                meshArea     = 0;
+
+  for(uint32_t c = 0; c < numClusters; c++) {
+    Cluster& cluster = clusterData[c];
+    cluster          = {clusters[c], clusters[c + 1], {0, 0, 0}, {0, 0, 0}, 0, 0};
+
+    for(uint32_t t = cluster.begin; t < cluster.end; t++) {
+      LdrVector a = getPosition(vertices, vertexSize, ordered[t * 3 + 0]);
+      LdrVector b = getPosition(vertices, vertexSize, ordered[t * 3 + 1]);
+      LdrVector d = getPosition(vertices, vertexSize, ordered[t * 3 + 2]);
+
+      LdrVector e0   = {b.x - a.x, b.y - a.y, b.z - a.z};
+      LdrVector e1   = {d.x - a.x, d.y - a.y, d.z - a.z};
+      LdrVector n    = {e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x};
+      float     area = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+      cluster.centroid.x += (a.x + b.x + d.x) * area / 3.0f;
+      cluster.centroid.y += (a.y + b.y + d.y) * area / 3.0f;
+      cluster.centroid.z += (a.z + b.z + d.z) * area / 3.0f;
+      cluster.normal.x += n.x;
+      cluster.normal.y += n.y;
+      cluster.normal.z += n.z;
+      cluster.area += area;
+    }
+
+    meshCentroid.x += cluster.centroid.x;
+    meshCentroid.y += cluster.centroid.y;
+    meshCentroid.z += cluster.centroid.z;
+    meshArea += cluster.area;
+  }
+  if(meshArea <= 0)
+    return;
+
+  meshCentroid = {meshCentroid.x / meshArea, meshCentroid.y / meshArea, meshCentroid.z / meshArea};
+
+  for(Cluster& cluster : clusterData) {
+    float length = sqrtf(cluster.normal.x * cluster.normal.x + cluster.normal.y * cluster.normal.y + cluster.normal.z * cluster.normal.z);
+    if(cluster.area <= 0 || length <= 0)
+      continue;
+
+    LdrVector centroid = {cluster.centroid.x / cluster.area, cluster.centroid.y / cluster.area, cluster.centroid.z / cluster.area};
+    cluster.sortKey    = ((centroid.x - meshCentroid.x) * cluster.normal.x + (centroid.y - meshCentroid.y) * cluster.normal.y
+                       + (centroid.z - meshCentroid.z) * cluster.normal.z)
+                      / length;
+  }
+
+  // outward facing clusters far from the center are likely to occlude the rest
+  std::stable_sort(clusterData.begin(), clusterData.end(),
+                   [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+  std::vector<uint32_t> sorted;
+  sorted.reserve(numTriangles);
+  for(const Cluster& cluster : clusterData) {
+    sorted.insert(sorted.end(), order.begin() + cluster.begin, order.begin() + cluster.end);
+  }
+  order = std::move(sorted);
+}
+
+template <typename T>
+static T* getArray(std::vector<T>& vec)
+{
+  return vec.empty() ? nullptr : vec.data();
+}
+
+// cache order followed by the overdraw order, materials (optional) follow their triangles
+static void reorderTriangles(const LdrVertexIndex*        triangles,
+                             const LdrMaterialID*         materials,
+                             uint32_t                     numTriangles,
+                             const void*                  vertices,
+                             size_t                       vertexSize,
+                             uint32_t                     numVertices,
+                             std::vector<LdrVertexIndex>& outTriangles,
+                             std::vector<LdrMaterialID>&  outMaterials,
+                             VertexCacheStats&            before,
+                             VertexCacheStats&            after)
+{
+  outTriangles.clear();
+  outMaterials.clear();
+  if(!numTriangles || !triangles)
+    return;
+
+  VertexCacheStats stats;
+  simulateVertexCache(triangles, numTriangles, numVertices, VERTEX_CACHE_SIZE, stats);
+  before.add(stats);
+
+  std::vector<uint32_t> order;
+  optimizeVertexCache(triangles, numTriangles, numVertices, order);
+  optimizeOverdraw(triangles, numTriangles, vertices, vertexSize, numVertices, 1.05f, order);
+
+  outTriangles.resize(size_t(numTriangles) * 3);
+  for(uint32_t t = 0; t < numTriangles; t++) {
+    memcpy(&outTriangles[t * 3], &triangles[order[t] * 3], sizeof(LdrVertexIndex) * 3);
+  }
+  if(materials) {
+    outMaterials.resize(numTriangles);
+    for(uint32_t t = 0; t < numTriangles; t++) {
+      outMaterials[t] = materials[order[t]];
+    }
+  }
+
+  simulateVertexCache(outTriangles.data(), numTriangles, numVertices, VERTEX_CACHE_SIZE, stats);
+  after.add(stats);
+}
+
+// vertices are renumbered in order of first use across all lists, unreferenced ones go last
+template <typename T>
+static void remapVertices(std::vector<T>& vertices, std::vector<LdrVertexIndex>* lists[], uint32_t numLists)
+{
+  uint32_t              numVertices = uint32_t(vertices.size());
+  std::vector<uint32_t> remap(numVertices, ~0u);
+  uint32_t              next = 0;
+
+  for(uint32_t l = 0; l < numLists; l++) {
+    for(LdrVertexIndex index : *lists[l]) {
+      if(index < numVertices && remap[index] == ~0u) {
+        remap[index] = next++;
+      }
+    }
+  }
+  for(uint32_t v = 0; v < numVertices; v++) {
+    if(remap[v] == ~0u) {
+      remap[v] = next++;
+    }
+  }
+
+  std::vector<T> remapped(numVertices);
+  for(uint32_t v = 0; v < numVertices; v++) {
+    remapped[remap[v]] = vertices[v];
+  }
+  vertices = std::move(remapped);
+
+  for(uint32_t l = 0; l < numLists; l++) {
+    for(LdrVertexIndex& index : *lists[l]) {
+      if(index < numVertices) {
+        index = remap[index];
+      }
+    }
+  }
+}
+
+template <typename T>
+static void copyArray(std::vector<T>& vec, const T* src, uint32_t count)
+{
+  if(src && count) {
+    vec.assign(src, src + count);
+  }
+  else {
+    vec.clear();
+  }
+}
+
+void OptimizedPart::init(const LdrPart* part, const LdrRenderPart* renderPart)
+{
+  m_stats = Stats();
+
+  m_hasPart = part != nullptr;
+  if(part) {
+    copyArray(m_positions, part->positions, part->numPositions);
+    copyArray(m_lines, part->lines, part->numLines * 2);
+    copyArray(m_optionalLines, part->optional_lines, part->numOptionalLines * 2);
+    reorderTriangles(part->triangles, part->triangleMaterials, part->numTriangles, part->positions, sizeof(LdrVector),
+                     part->numPositions, m_triangles, m_triangleMaterials, m_stats.before, m_stats.after);
+
+    std::vector<LdrVertexIndex>* lists[] = {&m_triangles, &m_lines, &m_optionalLines};
+    remapVertices(m_positions, lists, 3);
+
+    // everything else, such as the name and flags, stays as is
+    m_part                   = *part;
+    m_part.positions         = getArray(m_positions);
+    m_part.triangles         = getArray(m_triangles);
+    m_part.lines             = getArray(m_lines);
+    m_part.optional_lines    = getArray(m_optionalLines);
+    m_part.triangleMaterials = getArray(m_triangleMaterials);
+  }
+
+  m_hasRenderPart = renderPart != nullptr;
+  if(renderPart) {
+    const LdrRenderPart* rpart = renderPart;
+    copyArray(m_renderVertices, rpart->vertices, rpart->numVertices);
+    copyArray(m_renderLines, rpart->lines, rpart->numLines * 2);
+    reorderTriangles(rpart->triangles, rpart->triangleMaterials, rpart->numTriangles, rpart->vertices, sizeof(LdrRenderVertex),
+                     rpart->numVertices, m_renderTriangles, m_renderTriangleMaterials, m_stats.renderBefore, m_stats.renderAfter);
+    reorderTriangles(rpart->trianglesC, rpart->materialsC, rpart->numTrianglesC, rpart->vertices, sizeof(LdrRenderVertex),
+                     rpart->numVertices, m_renderTrianglesC, m_renderMaterialsC, m_stats.renderBefore, m_stats.renderAfter);
+
+    std::vector<LdrVertexIndex>* lists[] = {&m_renderTriangles, &m_renderTrianglesC, &m_renderLines};
+    remapVertices(m_renderVertices, lists, 3);
+
+    m_renderPart                   = *rpart;
+    m_renderPart.vertices          = getArray(m_renderVertices);
+    m_renderPart.triangles         = getArray(m_renderTriangles);
+    m_renderPart.lines             = getArray(m_renderLines);
+    m_renderPart.trianglesC        = getArray(m_renderTrianglesC);
+    m_renderPart.triangleMaterials = getArray(m_renderTriangleMaterials);
+    m_renderPart.materialsC        = getArray(m_renderMaterialsC);
+  }
+}
+
+}  // namespace ldrawviewer
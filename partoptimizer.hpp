@@ -0,0 +1,121 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "external/ldrawloader/src/ldrawloader.h"
+
+namespace ldrawviewer {
+
+// Index reordering for the post-transform vertex cache and overdraw, and vertex
+// reordering for fetch locality. Triangle orders are permutations of the input
+// triangles, so per-triangle data can follow them.
+
+// FIFO size the simulated cache uses for reporting, typical for current hardware
+static const uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats
+{
+  uint32_t triangles   = 0;
+  uint32_t vertices    = 0;  // distinct vertices referenced by the triangles
+  uint32_t transformed = 0;  // cache misses
+
+  // average cache miss ratio, transformed vertices per triangle, 0.5 is ideal for regular meshes
+  float getAcmr() const { return triangles ? float(transformed) / float(triangles) : 0.0f; }
+  // average transform to vertex ratio, 1.0 is ideal
+  float getAtvr() const { return vertices ? float(transformed) / float(vertices) : 0.0f; }
+
+  void add(const VertexCacheStats& other)
+  {
+    triangles += other.triangles;
+    vertices += other.vertices;
+    transformed += other.transformed;
+  }
+};
+
+void simulateVertexCache(const uint32_t* indices, uint32_t numTriangles, uint32_t numVertices, uint32_t cacheSize, VertexCacheStats& stats);
+
+// Forsyth's linear-speed vertex cache optimization, order receives the triangles in draw order
+void optimizeVertexCache(const uint32_t* indices, uint32_t numTriangles, uint32_t numVertices, std::vector<uint32_t>& order);
+
+// Sander et al., splits a cache optimized order into clusters where the simulated cache restarts,
+// or where the cluster's ACMR stays within threshold times the order's ACMR, and draws clusters
+// facing away from the center first. position must be the first member of the vertex.
+void optimizeOverdraw(const uint32_t*        indices,
+                      uint32_t               numTriangles,
+                      const void*            vertices,
+                      size_t                 vertexSize,
+                      uint32_t               numVertices,
+                      float                  threshold,
+                      std::vector<uint32_t>& order);
+
+// Owned copy of a part and its render part with every triangle list reordered for the vertex
+// cache and overdraw, and vertices renumbered in order of first use, which keeps per-triangle
+// materials in step and leaves the geometry unchanged.
+class OptimizedPart
+{
+public:
+  struct Stats
+  {
+    VertexCacheStats before;
+    VertexCacheStats after;
+    VertexCacheStats renderBefore;  // triangles and chamfered triangles of the render part
+    VertexCacheStats renderAfter;
+  };
+
+  OptimizedPart() = default;
+  OptimizedPart(const OptimizedPart&) = delete;
+  OptimizedPart& operator=(const OptimizedPart&) = delete;
+  // the views point into the vectors' heap storage, which moves along
+  OptimizedPart(OptimizedPart&&) = default;
+  OptimizedPart& operator=(OptimizedPart&&) = default;
+
+  // either may be null
+  void init(const LdrPart* part, const LdrRenderPart* renderPart);
+
+  const LdrPart*       getPart() const { return m_hasPart ? &m_part : nullptr; }
+  const LdrRenderPart* getRenderPart() const { return m_hasRenderPart ? &m_renderPart : nullptr; }
+  const Stats&         getStats() const { return m_stats; }
+
+private:
+  bool                        m_hasPart = false;
+  LdrPart                     m_part;
+  std::vector<LdrVector>      m_positions;
+  std::vector<LdrVertexIndex> m_triangles;
+  std::vector<LdrVertexIndex> m_lines;
+  std::vector<LdrVertexIndex> m_optionalLines;
+  std::vector<LdrMaterialID>  m_triangleMaterials;
+
+  bool                         m_hasRenderPart = false;
+  LdrRenderPart                m_renderPart;
+  std::vector<LdrRenderVertex> m_renderVertices;
+  std::vector<LdrVertexIndex>  m_renderTriangles;
+  std::vector<LdrVertexIndex>  m_renderLines;
+  std::vector<LdrVertexIndex>  m_renderTrianglesC;
+  std::vector<LdrMaterialID>   m_renderTriangleMaterials;
+  std::vector<LdrMaterialID>   m_renderMaterialsC;
+
+  Stats m_stats;
+};
+
+}  // namespace ldrawviewer
@@ -27,30 +27,35 @@
 in Interpolants {
   vec3 wPos;
   vec3 wNormal;
+  flat uint instanceIndex;
+  flat uint materialID;
 } IN;
 
 layout(location=0,index=0) out vec4 out_Color;
 
 layout(location=UNI_COLORMUL) uniform float colorMul;
 layout(location=UNI_LIGHTING) uniform bool lighting;
-layout(location=UNI_MATERIALID) uniform uint materialID;
-layout(location=UNI_MATERIALIDOFFSET) uniform uint materialIDOffset;
+layout(location=UNI_PARTMATERIALS) uniform bool partMaterials;
 
 void main()
 {
-  vec4 objColor = max(vec4(0.1),object.color);
+  InstanceData instance       = instances[IN.instanceIndex];
+  vec4 objectColor            = instance.color;
+  uint objectMaterialID       = instance.materialID;
+  uint objectMaterialIDOffset = partMaterials ? partMaterialOffsets[instance.part] : ~0u;
+
+  vec4 objColor = max(vec4(0.1),objectColor);
   if (view.useObjectColor != 0)
   {
-    uint usedMaterialID = materialID;
+    // split vertices carry the material, otherwise fall back to the per-triangle lookup
+    uint usedMaterialID = IN.materialID;
   
-    if (materialIDOffset != ~0) {
-      // using gl_PrimitiveID may not be exactly fast
-      // more portable is to split vertices along material edges and encode materialID within them
-      // should add support in loader library for that
-      usedMaterialID = materialIndices[materialIDOffset + gl_PrimitiveID];
-      if (usedMaterialID == 16) {
-        usedMaterialID = materialID;
-      }
+    if (objectMaterialIDOffset != ~0) {
+      // using gl_PrimitiveID may not be exactly fast, see the vertexmaterials option
+      usedMaterialID = materialIndices[objectMaterialIDOffset + gl_PrimitiveID];
+    }
+    if (usedMaterialID == 16) {
+      usedMaterialID = objectMaterialID;
     }
   
     if (usedMaterialID == 16) {
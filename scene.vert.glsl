@@ -22,20 +22,51 @@
 /**/
 
 #extension GL_ARB_shading_language_include : enable
+#extension GL_ARB_shader_draw_parameters : require
 #include "common.h"
 
+// quantized: unorm positions within the part bounds and octahedral normals in xy
 in layout(location=VERTEX_POS)    vec3 inPos;
 in layout(location=VERTEX_NORMAL) vec3 inNormal;
+// 16 (inherit) unless vertices were split along material boundaries
+in layout(location=VERTEX_MATERIALID) uint inMaterialID;
 
 out Interpolants {
   vec3 wPos;
   vec3 wNormal;
+  flat uint instanceIndex;
+  flat uint materialID;
 } OUT;
 
+layout(location=UNI_QUANTIZED) uniform bool quantized;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+  vec3  normal = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+  float t      = max(-normal.z, 0.0);
+  normal.x += normal.x >= 0.0 ? -t : t;
+  normal.y += normal.y >= 0.0 ? -t : t;
+  return normalize(normal);
+}
+
 void main()
 {
-  vec3 wPos     = (object.worldMatrix   * vec4(inPos.xyz,1)).xyz;
-  vec3 wNormal  = mat3(object.worldMatrixIT) * inNormal.xyz;
+  uint instanceIndex = uint(gl_BaseInstanceARB + gl_InstanceID);
+  mat4 worldMatrix   = instances[instanceIndex].worldMatrix;
+  mat4 worldMatrixIT = instances[instanceIndex].worldMatrixIT;
+  OUT.instanceIndex  = instanceIndex;
+  OUT.materialID     = inMaterialID;
+
+  vec3 pos    = inPos.xyz;
+  vec3 normal = inNormal.xyz;
+  if (quantized) {
+    PartBounds bounds = partBounds[instances[instanceIndex].part];
+    pos    = bounds.bboxMin.xyz + (bounds.bboxMax.xyz - bounds.bboxMin.xyz) * pos;
+    normal = decodeOctahedral(inNormal.xy);
+  }
+
+  vec3 wPos     = (worldMatrix   * vec4(pos,1)).xyz;
+  vec3 wNormal  = mat3(worldMatrixIT) * normal;
   gl_Position   = view.viewProjMatrix * vec4(wPos,1);
   OUT.wPos = wPos;
   OUT.wNormal = wNormal;
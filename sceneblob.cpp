@@ -0,0 +1,350 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include "sceneblob.hpp"
+#include "scenepipeline.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ldrawviewer {
+
+static const char     BLOB_MAGIC[8]  = {'L', 'D', 'R', 'B', 'L', 'O', 'B', '1'};
+static const uint64_t BLOB_ALIGNMENT = 64;
+
+static void getFileStats(const std::string& filename, uint64_t& fileSize, uint64_t& fileTime)
+{
+  std::error_code ec;
+  fileSize = uint64_t(std::filesystem::file_size(filename, ec));
+  if(ec) {
+    fileSize = 0;
+  }
+  fileTime = uint64_t(std::filesystem::last_write_time(filename, ec).time_since_epoch().count());
+  if(ec) {
+    fileTime = 0;
+  }
+}
+
+bool SceneBlob::save(const std::string& filename, const SceneBlobContent& content)
+{
+  SceneBlobHeader header = {};
+  memcpy(header.magic, BLOB_MAGIC, sizeof(BLOB_MAGIC));
+  header.version      = VERSION;
+  header.drawPartSize = content.drawPartSize;
+  header.instanceSize = sizeof(SceneBlobInstance);
+  header.vertexSize   = content.vertexSize;
+  header.meshletSize  = content.meshletSize;
+  header.options      = content.options;
+  getFileStats(content.modelPath, header.modelFileSize, header.modelFileTime);
+
+  header.numDrawParts    = content.numDrawParts;
+  header.numInstances    = content.numInstances;
+  header.numVertices     = content.numVertices;
+  header.numIndices      = content.numIndices;
+  header.numMaterials    = content.numMaterials;
+  header.modelPathLength = uint32_t(content.modelPath.size());
+
+  header.numSplitVertices  = content.numSplitVertices;
+  header.numSplitMaterials = content.numSplitMaterials;
+  header.numIndices16      = content.numIndices16;
+  header.numMeshlets       = content.numMeshlets;
+
+  struct Section
+  {
+    uint64_t*   offset;
+    const void* data;
+    size_t      size;
+  };
+  Section sections[] = {
+      {&header.drawPartsOffset, content.drawParts, size_t(content.drawPartSize) * content.numDrawParts},
+      {&header.instancesOffset, content.instances, sizeof(SceneBlobInstance) * content.numInstances},
+      {&header.verticesOffset, content.vertices, size_t(content.vertexSize) * content.numVertices},
+      {&header.indicesOffset, content.indices, sizeof(uint32_t) * content.numIndices + sizeof(uint16_t) * content.numIndices16},
+      {&header.materialsOffset, content.materials, sizeof(LdrMaterialID) * content.numMaterials},
+      {&header.modelPathOffset, content.modelPath.data(), content.modelPath.size()},
+      {&header.partBoundsOffset, content.partBounds, sizeof(LdrBbox) * content.numDrawParts},
+      {&header.meshletsOffset, content.meshlets, size_t(content.meshletSize) * content.numMeshlets},
+  };
+
+  uint64_t offset = sizeof(SceneBlobHeader);
+  for(Section& section : sections) {
+    offset          = (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+    *section.offset = offset;
+    offset += section.size;
+  }
+
+  FILE* file = fopen(filename.c_str(), "wb");
+  if(!file)
+    return false;
+
+  // sections are streamed in offset order, the gaps between them are zero padding
+  static const uint8_t padding[BLOB_ALIGNMENT] = {};
+
+  bool     success  = fwrite(&header, sizeof(header), 1, file) == 1;
+  uint64_t position = sizeof(header);
+  for(const Section& section : sections) {
+    size_t paddingSize = size_t(*section.offset - position);
+    success            = success && fwrite(padding, 1, paddingSize, file) == paddingSize;
+    success            = success && (!section.size || fwrite(section.data, section.size, 1, file) == 1);
+    position           = *section.offset + section.size;
+  }
+  fclose(file);
+
+  return success;
+}
+
+static inline bool isInRange(uint32_t offset, uint64_t count, uint64_t total)
+{
+  return uint64_t(offset) + count <= total;
+}
+
+// the sections are in bounds, now everything indexed through them must be too,
+// otherwise a stale or foreign blob reads out of bounds during upload and culling
+static bool validateContents(const SceneBlobHeader& header, const uint8_t* data)
+{
+  const SceneBlobInstance* instances = (const SceneBlobInstance*)(data + header.instancesOffset);
+  const DrawPart*          drawParts = (const DrawPart*)(data + header.drawPartsOffset);
+  const Meshlet*           meshlets  = (const Meshlet*)(data + header.meshletsOffset);
+
+  for(uint32_t i = 0; i < header.numInstances; i++) {
+    if(instances[i].part != LDR_INVALID_ID && instances[i].part >= header.numDrawParts)
+      return false;
+  }
+
+  for(uint32_t p = 0; p < header.numDrawParts; p++) {
+    const DrawPart& drawPart = drawParts[p];
+    if(!(drawPart.flags & DRAWPART_ACTIVE))
+      continue;
+
+    // index offsets count elements of the part's pool, the uint16_t pool follows the uint32_t one
+    bool     index16     = (drawPart.flags & DRAWPART_INDEX16) != 0;
+    uint64_t indexBegin  = index16 ? uint64_t(header.numIndices) * 2 : 0;
+    uint64_t indexEnd    = index16 ? indexBegin + header.numIndices16 : header.numIndices;
+    auto     isInIndices = [&](uint32_t offset, uint64_t count) { return offset >= indexBegin && isInRange(offset, count, indexEnd); };
+
+    bool valid = isInRange(drawPart.vertexOffset, drawPart.vertexCount, header.numVertices)
+                 && isInIndices(drawPart.triangleOffset, uint64_t(drawPart.triangleCount) * 3)
+                 && isInIndices(drawPart.edgesOffset, uint64_t(drawPart.edgesCount) * 2)
+                 && isInIndices(drawPart.optionalOffset, uint64_t(drawPart.optionalCount) * 2)
+                 && isInIndices(drawPart.triangleOffsetC, uint64_t(drawPart.triangleCountC) * 3)
+                 && isInRange(drawPart.meshletOffset, drawPart.meshletCount, header.numMeshlets)
+                 && isInRange(drawPart.meshletOffsetC, drawPart.meshletCountC, header.numMeshlets)
+                 && drawPart.lodLevels < PART_LOD_LEVELS;
+    if(valid && (drawPart.flags & DRAWPART_MATERIALS)) {
+      valid = isInRange(drawPart.materialIDOffset, drawPart.triangleCount, header.numMaterials);
+    }
+    if(valid && (drawPart.flags & DRAWPART_MATERIALS_C)) {
+      valid = isInRange(drawPart.materialIDOffsetC, drawPart.triangleCountC, header.numMaterials);
+    }
+    for(uint32_t l = 0; l < drawPart.lodLevels && valid; l++) {
+      valid = isInIndices(drawPart.lodTriangleOffset[l], uint64_t(drawPart.lodTriangleCount[l]) * 3);
+    }
+    for(uint32_t m = 0; m < drawPart.meshletCount && valid; m++) {
+      const Meshlet& meshlet = meshlets[drawPart.meshletOffset + m];
+      valid                  = isInRange(meshlet.triangleOffset, meshlet.triangleCount, drawPart.triangleCount);
+    }
+    for(uint32_t m = 0; m < drawPart.meshletCountC && valid; m++) {
+      const Meshlet& meshlet = meshlets[drawPart.meshletOffsetC + m];
+      valid                  = isInRange(meshlet.triangleOffset, meshlet.triangleCount, drawPart.triangleCountC);
+    }
+    if(!valid)
+      return false;
+  }
+
+  return true;
+}
+
+SceneBlob& SceneBlob::operator=(SceneBlob&& other) noexcept
+{
+  if(this != &other) {
+    close();
+    m_data       = other.m_data;
+    m_size       = other.m_size;
+    m_file       = other.m_file;
+    other.m_data = nullptr;
+    other.m_size = 0;
+#ifdef _WIN32
+    m_mapping       = other.m_mapping;
+    other.m_file    = nullptr;
+    other.m_mapping = nullptr;
+#else
+    other.m_file = -1;
+#endif
+  }
+  return *this;
+}
+
+bool SceneBlob::open(const std::string& filename)
+{
+  close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+
+  m_data    = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  m_size    = size_t(fileSize.QuadPart);
+  m_file    = file;
+  m_mapping = mapping;
+#else
+  int file = ::open(filename.c_str(), O_RDONLY);
+  if(file < 0)
+    return false;
+
+  struct stat fileStat;
+  if(fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+    ::close(file);
+    return false;
+  }
+
+  void* data = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+  if(data == MAP_FAILED) {
+    ::close(file);
+    return false;
+  }
+
+  m_data = (const uint8_t*)data;
+  m_size = size_t(fileStat.st_size);
+  m_file = file;
+#endif
+
+  if(!m_data) {
+    close();
+    return false;
+  }
+
+  // validate the structure, settings are checked by isCompatible
+  bool valid = m_size >= sizeof(SceneBlobHeader);
+  if(valid) {
+    const SceneBlobHeader& header = getHeader();
+
+    valid = memcmp(header.magic, BLOB_MAGIC, sizeof(BLOB_MAGIC)) == 0 && header.version == VERSION
+            && header.instanceSize == sizeof(SceneBlobInstance) && header.drawPartSize == sizeof(DrawPart)
+            && header.meshletSize == sizeof(Meshlet);
+
+    struct Section
+    {
+      uint64_t offset;
+      uint64_t size;
+    };
+    Section sections[] = {
+        {header.drawPartsOffset, uint64_t(header.drawPartSize) * header.numDrawParts},
+        {header.instancesOffset, uint64_t(sizeof(SceneBlobInstance)) * header.numInstances},
+        {header.verticesOffset, uint64_t(header.vertexSize) * header.numVertices},
+        {header.indicesOffset, uint64_t(sizeof(uint32_t)) * header.numIndices + uint64_t(sizeof(uint16_t)) * header.numIndices16},
+        {header.materialsOffset, uint64_t(sizeof(LdrMaterialID)) * header.numMaterials},
+        {header.modelPathOffset, uint64_t(header.modelPathLength)},
+        {header.partBoundsOffset, uint64_t(sizeof(LdrBbox)) * header.numDrawParts},
+        {header.meshletsOffset, uint64_t(header.meshletSize) * header.numMeshlets},
+    };
+    for(const Section& section : sections) {
+      valid = valid && section.offset <= m_size && section.size <= m_size - section.offset;
+    }
+    valid = valid && validateContents(header, m_data);
+  }
+
+  if(!valid) {
+    printf("scene blob %s: invalid or outdated format\n", filename.c_str());
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void SceneBlob::close()
+{
+#ifdef _WIN32
+  if(m_data) {
+    UnmapViewOfFile(m_data);
+  }
+  if(m_mapping) {
+    CloseHandle(m_mapping);
+  }
+  if(m_file) {
+    CloseHandle(m_file);
+  }
+  m_mapping = nullptr;
+  m_file    = nullptr;
+#else
+  if(m_data) {
+    munmap((void*)m_data, m_size);
+  }
+  if(m_file >= 0) {
+    ::close(m_file);
+  }
+  m_file = -1;
+#endif
+  m_data = nullptr;
+  m_size = 0;
+}
+
+std::string SceneBlob::getModelPath() const
+{
+  const SceneBlobHeader& header = getHeader();
+  return std::string(getSection<char>(header.modelPathOffset), header.modelPathLength);
+}
+
+bool SceneBlob::isCompatible(const SceneBlobOptions& options, std::string& reason) const
+{
+  const SceneBlobHeader& header = getHeader();
+
+  if(memcmp(&header.options, &options, sizeof(SceneBlobOptions)) != 0) {
+    reason = "loader settings differ";
+    return false;
+  }
+
+  // the blob is self-contained, only reject if the source model is present and changed
+  uint64_t fileSize;
+  uint64_t fileTime;
+  getFileStats(getModelPath(), fileSize, fileTime);
+  if(fileSize && (fileSize != header.modelFileSize || fileTime != header.modelFileTime)) {
+    reason = "model file changed";
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace ldrawviewer
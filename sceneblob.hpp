@@ -0,0 +1,162 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "external/ldrawloader/src/ldrawloader.h"
+
+namespace ldrawviewer {
+
+// Relocatable file containing everything needed to draw a model: the
+// DrawPart table, instances, the packed vertex/index/material arrays and meshlets.
+// All sections are referenced by file offsets, the file is memory-mapped
+// and uploaded straight from the mapping.
+
+struct SceneBlobOptions
+{
+  // loader settings the blob was baked with
+  uint32_t partFixMode;
+  uint32_t partFixTjunctions;
+  uint32_t partFixOverlap;
+  uint32_t partHiResPrimitives;
+  uint32_t renderpartBuildMode;
+  float    renderpartChamfer;
+  // vertex format, LdrRenderVertex or LdrVector
+  uint32_t drawRenderPart;
+  // vertex followed by its LdrMaterialID, see SceneVertexFormat
+  uint32_t vertexMaterials;
+  // QuantizedVertex or QuantizedRenderVertex
+  uint32_t quantizedVertices;
+  // geometry went through OptimizedPart
+  uint32_t optimizedParts;
+  // DrawPart lod ranges are filled, see PartLodChain
+  uint32_t partLods;
+};
+
+struct SceneBlobInstance
+{
+  LdrMatrix     transform;
+  LdrPartID     part;
+  LdrMaterialID material;
+};
+
+struct SceneBlobHeader
+{
+  char             magic[8];
+  uint32_t         version;
+  uint32_t         drawPartSize;
+  uint32_t         instanceSize;
+  uint32_t         vertexSize;
+  uint32_t         meshletSize;
+  SceneBlobOptions options;
+  uint64_t         modelFileSize;
+  uint64_t         modelFileTime;
+
+  uint32_t numDrawParts;
+  uint32_t numInstances;
+  uint32_t numVertices;
+  uint32_t numIndices;
+  uint32_t numMaterials;
+  uint32_t modelPathLength;
+  uint32_t numSplitVertices;
+  uint32_t numSplitMaterials;
+  uint32_t numIndices16;
+  uint32_t numMeshlets;
+
+  uint64_t drawPartsOffset;
+  uint64_t instancesOffset;
+  uint64_t verticesOffset;
+  uint64_t indicesOffset;  // numIndices uint32_t followed by numIndices16 uint16_t
+  uint64_t materialsOffset;
+  uint64_t modelPathOffset;
+  uint64_t partBoundsOffset;  // LdrBbox per DrawPart, quantized positions are relative to them
+  uint64_t meshletsOffset;    // referenced by the DrawPart meshlet ranges
+};
+
+struct SceneBlobContent
+{
+  SceneBlobOptions options = {};
+  std::string      modelPath;
+
+  uint32_t                 drawPartSize      = 0;
+  uint32_t                 numDrawParts      = 0;
+  const void*              drawParts         = nullptr;
+  uint32_t                 numInstances      = 0;
+  const SceneBlobInstance* instances         = nullptr;
+  uint32_t                 vertexSize        = 0;
+  uint32_t                 numVertices       = 0;
+  const void*              vertices          = nullptr;
+  uint32_t                 numIndices        = 0;
+  uint32_t                 numIndices16      = 0;
+  const void*              indices           = nullptr;
+  uint32_t                 numMaterials      = 0;
+  const LdrMaterialID*     materials         = nullptr;
+  uint32_t                 numSplitVertices  = 0;
+  uint32_t                 numSplitMaterials = 0;
+  const LdrBbox*           partBounds        = nullptr;  // numDrawParts entries
+  uint32_t                 meshletSize       = 0;
+  uint32_t                 numMeshlets       = 0;
+  const void*              meshlets          = nullptr;
+};
+
+class SceneBlob
+{
+public:
+  static const uint32_t VERSION = 7;
+
+  static bool save(const std::string& filename, const SceneBlobContent& content);
+
+  SceneBlob() = default;
+  SceneBlob(const SceneBlob&) = delete;
+  SceneBlob& operator=(const SceneBlob&) = delete;
+  SceneBlob(SceneBlob&& other) noexcept { *this = std::move(other); }
+  SceneBlob& operator=(SceneBlob&& other) noexcept;
+  ~SceneBlob() { close(); }
+
+  bool open(const std::string& filename);
+  void close();
+  bool isOpen() const { return m_data != nullptr; }
+
+  // checks settings and whether the source model changed since baking
+  bool isCompatible(const SceneBlobOptions& options, std::string& reason) const;
+
+  const SceneBlobHeader& getHeader() const { return *(const SceneBlobHeader*)m_data; }
+  std::string            getModelPath() const;
+
+  template <typename T>
+  const T* getSection(uint64_t offset) const
+  {
+    return (const T*)(m_data + offset);
+  }
+
+private:
+  const uint8_t* m_data = nullptr;
+  size_t         m_size = 0;
+#ifdef _WIN32
+  void* m_file    = nullptr;
+  void* m_mapping = nullptr;
+#else
+  int m_file = -1;
+#endif
+};
+
+}  // namespace ldrawviewer
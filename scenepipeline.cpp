@@ -0,0 +1,1491 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include "scenepipeline.hpp"
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+namespace ldrawviewer {
+
+static inline bool isLoadSuccess(LdrResult result)
+{
+  return result == LDR_SUCCESS || result == LDR_WARNING_PART_NOT_FOUND;
+}
+
+// parts referenced by an instance of the model
+static void getActiveParts(LdrModelHDL model, uint32_t numParts, std::vector<uint8_t>& activeParts)
+{
+  activeParts.assign(numParts, 0);
+  for(uint32_t i = 0; i < model->numInstances; i++) {
+    LdrPartID part = model->instances[i].part;
+    if(part != LDR_INVALID_ID && part < numParts)
+      activeParts[part] = 1;
+  }
+}
+
+void ScenePipeline::init(ThreadPool*        threadPool,
+                         const std::string& ldrawPath,
+                         const std::string& partCostFile,
+                         const std::string& partCacheFile)
+{
+  m_threadPool    = threadPool;
+  m_ldrawPath     = ldrawPath;
+  m_partCostFile  = partCostFile;
+  m_partCacheFile = partCacheFile;
+
+  if(!m_partCostFile.empty()) {
+    m_partCosts.loadHistory(m_partCostFile);
+  }
+}
+
+void ScenePipeline::deinit()
+{
+  unloadModel();
+  ldrDestroyLoader(m_loader);
+  m_loader = nullptr;
+}
+
+void ScenePipeline::log(const char* fmt, ...) const
+{
+  if(!m_verbose)
+    return;
+
+  va_list args;
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+}
+
+bool ScenePipeline::resetLoader(const LdrLoaderCreateInfo& createInfo, const SceneLoadSettings& settings)
+{
+  unloadModel();
+  ldrDestroyLoader(m_loader);
+  m_loader = nullptr;
+
+  m_createInfo = createInfo;
+  m_settings   = settings;
+
+  // pipelining and the part cache rely on the deferred stages of the threaded path
+  m_settings.threadedLoad = m_settings.threadedLoad || m_settings.pipelinedLoad || m_settings.partCache;
+
+  if(m_settings.partCache && !m_partCacheLoaded && !m_partCacheFile.empty()) {
+    m_partCache.load(m_partCacheFile);
+    m_partCacheLoaded = true;
+  }
+
+  LdrLoaderCreateInfo loaderInfo = createInfo;
+  if(m_settings.threadedLoad) {
+    // fixing and render part building are done as separate stages in loadModel
+    loaderInfo.partFixMode         = LDR_PART_FIX_NONE;
+    loaderInfo.renderpartBuildMode = decltype(loaderInfo.renderpartBuildMode)(0);
+  }
+
+  LdrResult result = ldrCreateLoader(&loaderInfo, &m_loader);
+  assert(result == LDR_SUCCESS);
+  m_loaderInfo = loaderInfo;
+
+  return result == LDR_SUCCESS;
+}
+
+void ScenePipeline::unloadModel()
+{
+  if(m_loader) {
+    ldrDestroyModel(m_loader, m_model);
+    ldrDestroyRenderModel(m_loader, m_renderModel);
+  }
+  m_model       = nullptr;
+  m_renderModel = nullptr;
+
+  if(m_updateLoader) {
+    ldrDestroyModel(m_updateLoader, m_updateModel);
+    ldrDestroyLoader(m_updateLoader);
+  }
+  m_updateLoader = nullptr;
+  m_updateModel  = nullptr;
+  m_updatedParts.clear();
+  m_chamferedParts.clear();
+
+  m_cachedParts.clear();
+  m_cachedRenderParts.clear();
+  m_cachedPartViews.clear();
+  m_optimizedParts.clear();
+  m_partOptimizations.clear();
+  m_partLods.clear();
+  m_renderPartLods.clear();
+
+  m_renderPartsBuilt = false;
+  m_partCacheHits    = 0;
+  m_schedule         = PartSchedule();
+}
+
+LdrResult ScenePipeline::loadModel(const std::string& filename, SceneLoadTimings& timings)
+{
+  timings = SceneLoadTimings();
+
+  unloadModel();
+  m_modelFilename = filename;
+
+  double timeLoadAll;
+  double time;
+
+  timeLoadAll = -getMicroSeconds();
+
+  LdrResult                result;
+  PartSchedule             schedule;
+  std::vector<std::string> cacheKeys;
+  if(m_settings.threadedLoad) {
+    time   = -getMicroSeconds();
+    result = ldrCreateModel(m_loader, filename.c_str(), LDR_FALSE, &m_model);
+    assert(isLoadSuccess(result));
+    time += getMicroSeconds();
+    timings.dependency = time;
+    log("dependency time %.2f ms\n", time / 1000.0f);
+
+    if(!isLoadSuccess(result))
+      return result;
+
+    uint32_t numParts = ldrGetNumRegisteredParts(m_loader);
+
+    m_cachedParts.resize(numParts, nullptr);
+    m_cachedRenderParts.resize(numParts, nullptr);
+
+    std::vector<LdrPartID> partIds;
+    if(m_settings.partCache) {
+      time = -getMicroSeconds();
+      m_partCache.beginLoad();
+      m_cachedPartViews.resize(numParts);
+      cacheKeys.resize(numParts);
+      for(uint32_t p = 0; p < numParts; p++) {
+        const LdrPart* part     = ldrGetPart(m_loader, p);
+        const char*    name     = part ? part->name : nullptr;
+        std::string    partFile = findPartFile(m_ldrawPath, m_modelFilename, name, m_createInfo.partHiResPrimitives != LDR_FALSE);
+
+        // parts that are not backed by a file (mpd embedded) are never cached
+        if(!partFile.empty()) {
+          cacheKeys[p] = PartCache::makeKey(partFile, m_createInfo, m_settings.optimizeParts);
+        }
+        if(cacheKeys[p].empty() || !m_partCache.lookup(name, cacheKeys[p], m_cachedParts[p], m_cachedRenderParts[p])) {
+          partIds.push_back((LdrPartID)p);
+          continue;
+        }
+        // the cache holds no per model state, the instance count is this model's
+        m_cachedPartViews[p]              = *m_cachedParts[p];
+        m_cachedPartViews[p].numInstances = 0;
+        m_cachedParts[p]                  = &m_cachedPartViews[p];
+        m_partCacheHits++;
+      }
+      for(uint32_t i = 0; i < m_model->numInstances; i++) {
+        LdrPartID id = m_model->instances[i].part;
+        if(id < numParts && m_cachedParts[id]) {
+          m_cachedPartViews[id].numInstances++;
+        }
+      }
+      time += getMicroSeconds();
+      timings.cacheLookup = time;
+      log("part cache lookup %.2f ms\n", time / 1000.0f);
+    }
+    else {
+      partIds.resize(numParts);
+      for(uint32_t p = 0; p < numParts; p++) {
+        partIds[p] = (LdrPartID)p;
+      }
+    }
+
+    time = -getMicroSeconds();
+    buildPartSchedule(m_loader, partIds, m_partCosts, m_ldrawPath, m_modelFilename, m_createInfo.partHiResPrimitives != LDR_FALSE,
+                      m_threadPool->getNumWorkers(), schedule);
+    time += getMicroSeconds();
+    timings.schedule = time;
+    log("schedule time %.2f ms (%d parts, %d estimates from history, %d from file size)\n", time / 1000.0f,
+        uint32_t(schedule.partIds.size()), schedule.numFromHistory, schedule.numFromFileSize);
+
+    // threaded loaded
+    time = -getMicroSeconds();
+
+    // pipelined: every batch of parts goes through fix and render part building
+    // right after being loaded, without waiting for all other parts
+    std::vector<PartStage> stages = {{"load", ldrLoadDeferredParts}};
+    if(m_settings.pipelinedLoad) {
+      if(m_createInfo.partFixMode != LDR_PART_FIX_NONE) {
+        stages.push_back({"fix", ldrFixParts});
+      }
+      if(m_createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD) {
+        stages.push_back({"build", ldrBuildRenderParts});
+      }
+    }
+
+    // the history is load only, pipelined fix and build are not part of the batch times
+    std::vector<WorkerStats> workerStats;
+    std::vector<double>      loadTimes;
+    std::vector<double>      stageTimes;
+    result = processPartsParallel(m_loader, schedule, stages, &workerStats, &loadTimes, &stageTimes);
+    if(!isLoadSuccess(result)) {
+      assert(0);
+      return result;
+    }
+
+    time += getMicroSeconds();
+    timings.load = time;
+    // the estimate only covers loading, the pipelined makespan includes fix and build
+    log("%s makespan %.2f ms, estimated load makespan %.2f ms\n", m_settings.pipelinedLoad ? "pipeline (load, fix, build)" : "load",
+        time / 1000.0f, schedule.estimatedMakespan / 1000.0f);
+    if(m_settings.pipelinedLoad) {
+      log("pipeline stages (summed over workers):\n");
+      for(size_t i = 0; i < stages.size(); i++) {
+        log("  %-5s %.2f ms\n", stages[i].name, stageTimes[i] / 1000.0f);
+      }
+    }
+
+    updatePartCostHistory(m_loader, schedule, loadTimes, m_partCosts);
+    if(!m_partCostFile.empty()) {
+      m_partCosts.saveHistory(m_partCostFile);
+    }
+
+    // resolved like the uncached path, whatever the loader holds for part cache hits is
+    // never read, they are served through the cache views
+    time = -getMicroSeconds();
+    ldrResolveModel(m_loader, m_model);
+    time += getMicroSeconds();
+    timings.resolve = time;
+
+    log("threaded time %.2f ms\n", (timings.load + timings.resolve) / 1000.0f);
+    if(m_verbose) {
+      printWorkerStats(workerStats);
+    }
+  }
+  else {
+    time   = -getMicroSeconds();
+    result = ldrCreateModel(m_loader, filename.c_str(), LDR_TRUE, &m_model);
+    assert(isLoadSuccess(result));
+    time += getMicroSeconds();
+    timings.load = time;
+    log("load time %.2f ms\n", time / 1000.0f);
+
+    if(!isLoadSuccess(result))
+      return result;
+  }
+
+  timeLoadAll += getMicroSeconds();
+  log("total load time %.2f ms\n", timeLoadAll / 1000.0f);
+
+  // threaded loading creates the loader without on-load fixing and building (see resetLoader),
+  // these stages are run here on the thread pool instead, using the same cost order as loading
+  time = -getMicroSeconds();
+  if(m_settings.threadedLoad && !m_settings.pipelinedLoad && m_createInfo.partFixMode != LDR_PART_FIX_NONE) {
+    result = processPartsParallel(m_loader, schedule, {{"fix", ldrFixParts}});
+    assert(isLoadSuccess(result));
+  }
+  time += getMicroSeconds();
+  timings.fix = time;
+  log("fix time %.2f ms\n", time / 1000.0f);
+
+  time = -getMicroSeconds();
+  if(m_settings.threadedLoad && !m_settings.pipelinedLoad && m_createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD) {
+    result = processPartsParallel(m_loader, schedule, {{"build", ldrBuildRenderParts}});
+    assert(isLoadSuccess(result));
+  }
+  time += getMicroSeconds();
+  timings.build = time;
+
+  if(m_createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD) {
+    // every render part the loader holds is built by now, the threaded path must not build cached parts
+    double timeRender = -getMicroSeconds();
+    result            = ldrCreateRenderModel(m_loader, m_model, m_settings.threadedLoad ? LDR_FALSE : LDR_TRUE, &m_renderModel);
+    assert(isLoadSuccess(result));
+    timeRender += getMicroSeconds();
+    timings.renderModel = timeRender;
+  }
+
+  log("build time %.2f ms\n", time / 1000.0f);
+
+  // both paths ran every stage the settings enable
+  m_renderPartsBuilt = m_createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD;
+  m_schedule         = schedule;
+
+  postProcessParts(true, timings);
+
+  if(m_settings.partCache) {
+    time = -getMicroSeconds();
+    for(LdrPartID id : schedule.partIds) {
+      // the optimized parts if enabled, parts the model does not use were not optimized
+      const LdrPart* part = getPart(id);
+      if(part && !cacheKeys[id].empty() && (!m_settings.optimizeParts || m_cachedParts[id])) {
+        m_partCache.store(part->name, cacheKeys[id], part, getRenderPart(id));
+      }
+    }
+    m_partCache.trim();
+    if(m_partCache.isDirty() && !m_partCacheFile.empty()) {
+      m_partCache.save(m_partCacheFile);
+    }
+    time += getMicroSeconds();
+    timings.cacheStore = time;
+
+    const PartCache::Stats& stats = m_partCache.getStats();
+    log("part cache: %d hits, %d misses, %d evicted, store %.2f ms\n", stats.hits, stats.misses, stats.evicted, time / 1000.0f);
+  }
+
+  if(m_settings.threadedLoad && m_verbose) {
+    m_threadPool->printStats();
+  }
+
+  timings.total = timings.dependency + timings.cacheLookup + timings.schedule + timings.load + timings.resolve + timings.fix
+                  + timings.build + timings.renderModel + timings.optimize + timings.lods + timings.cacheStore;
+
+  return result;
+}
+
+void ScenePipeline::postProcessParts(bool optimize, SceneLoadTimings& timings)
+{
+  double time;
+  if(optimize && m_settings.optimizeParts) {
+    time = -getMicroSeconds();
+    optimizeParts();
+    time += getMicroSeconds();
+    timings.optimize = time;
+    log("optimize time %.2f ms (%d parts)\n", time / 1000.0f, uint32_t(m_partOptimizations.size()));
+  }
+
+  if(m_settings.partLods) {
+    time = -getMicroSeconds();
+    buildPartLods();
+    time += getMicroSeconds();
+    timings.lods = time;
+    log("lod time %.2f ms\n", time / 1000.0f);
+  }
+}
+
+const char* getReloadStageName(SceneReloadStage stage)
+{
+  switch(stage) {
+    case RELOAD_NONE:
+      return "none";
+    case RELOAD_POSTPROCESS:
+      return "postprocess";
+    case RELOAD_RENDERPARTS:
+      return "renderparts";
+    default:
+      return "full";
+  }
+}
+
+// by the loader stage that consumes the changed setting
+static SceneReloadStage getInvalidatedStage(const LdrLoaderCreateInfo& oldInfo,
+                                            const SceneLoadSettings&   oldSettings,
+                                            const LdrLoaderCreateInfo& newInfo,
+                                            const SceneLoadSettings&   newSettings)
+{
+  // any other field, including the library path, affects parsing. Fixing works in place on the
+  // parsed geometry, the loader cannot fix again from the unfixed parts, so it needs parsing too.
+  LdrLoaderCreateInfo other = newInfo;
+  other.renderpartBuildMode = oldInfo.renderpartBuildMode;
+  other.renderpartChamfer   = oldInfo.renderpartChamfer;
+  if(memcmp(&other, &oldInfo, sizeof(LdrLoaderCreateInfo)) != 0)
+    return RELOAD_FULL;
+
+  if(newInfo.renderpartBuildMode != oldInfo.renderpartBuildMode || newInfo.renderpartChamfer != oldInfo.renderpartChamfer)
+    return RELOAD_RENDERPARTS;
+
+  if(newSettings.optimizeParts != oldSettings.optimizeParts || newSettings.partLods != oldSettings.partLods)
+    return RELOAD_POSTPROCESS;
+
+  // threaded, pipelined and part cache only change how the same geometry is loaded
+  return RELOAD_NONE;
+}
+
+SceneReloadStage ScenePipeline::getReloadStage(const LdrLoaderCreateInfo& createInfo, const SceneLoadSettings& settings) const
+{
+  SceneReloadStage stage = getInvalidatedStage(m_createInfo, m_settings, createInfo, settings);
+  if(stage == RELOAD_NONE)
+    return stage;
+
+  // stages the loader cannot rerun are rerun on a new loader for the affected parts, see updateModel
+  if(!m_model)
+    return RELOAD_FULL;
+  return stage;
+}
+
+bool ScenePipeline::canUpdateInPlace(const LdrLoaderCreateInfo& createInfo, SceneReloadStage stage, bool reoptimize) const
+{
+  // cache entries were processed with the old settings and have no loader data to start over from
+  if(reoptimize && m_partCacheHits)
+    return false;
+  if(stage < RELOAD_RENDERPARTS)
+    return true;
+  // the stages would miss the parts on the update loader
+  if(m_updateLoader)
+    return false;
+
+  bool build = createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD;
+
+  // the chamfer is fixed at loader creation
+  return !(build && createInfo.renderpartChamfer != m_loaderInfo.renderpartChamfer);
+}
+
+bool ScenePipeline::getAffectedParts(const LdrLoaderCreateInfo& createInfo, SceneReloadStage stage, std::vector<LdrPartID>& partIds) const
+{
+  uint32_t             numParts = ldrGetNumRegisteredParts(m_loader);
+  std::vector<uint8_t> activeParts;
+  getActiveParts(m_model, numParts, activeParts);
+
+  // Changing a non-zero chamfer leaves render parts that cannot chamfer as they are, every active part has a
+  // render part while building is on. Cache hits have no data on m_loader and the previous update loader is
+  // replaced, so their parts are always affected.
+  bool build       = createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD;
+  bool built       = m_createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD;
+  bool chamferOnly = stage == RELOAD_RENDERPARTS && build && built && createInfo.renderpartChamfer > 0
+                     && m_createInfo.renderpartChamfer > 0;
+  bool allParts    = stage >= RELOAD_RENDERPARTS && !chamferOnly;
+
+  partIds.clear();
+  for(uint32_t p = 0; p < numParts; p++) {
+    if(!activeParts[p])
+      continue;
+
+    bool                 cacheHit = p < m_cachedPartViews.size() && m_cachedParts[p] == &m_cachedPartViews[p];
+    const LdrRenderPart* rpart    = chamferOnly ? getRenderPart(p) : nullptr;
+    if(allParts || cacheHit || getPartLoader(p) != m_loader || (rpart && rpart->flags.canChamfer)) {
+      partIds.push_back(LdrPartID(p));
+    }
+  }
+
+  return chamferOnly;
+}
+
+LdrResult ScenePipeline::rebuildParts(const LdrLoaderCreateInfo&    createInfo,
+                                      const std::vector<LdrPartID>& partIds,
+                                      SceneLoadTimings&             timings)
+{
+  // fixing and render part building are done as stages right after loading, like the pipelined path
+  LdrLoaderCreateInfo loaderInfo = createInfo;
+  loaderInfo.partFixMode         = LDR_PART_FIX_NONE;
+  loaderInfo.renderpartBuildMode = decltype(loaderInfo.renderpartBuildMode)(0);
+
+  double       time   = -getMicroSeconds();
+  LdrLoaderHDL loader = nullptr;
+  LdrModelHDL  model  = nullptr;
+  LdrResult    result = ldrCreateLoader(&loaderInfo, &loader);
+  if(result == LDR_SUCCESS) {
+    result = ldrCreateModel(loader, m_modelFilename.c_str(), LDR_FALSE, &model);
+  }
+
+  // parsing is unaffected by the settings that got here, so the same file registers the same parts and
+  // materials in the same order. Checked anyway, m_model's IDs must be valid for both loaders.
+  uint32_t numParts = ldrGetNumRegisteredParts(m_loader);
+  bool     matching = isLoadSuccess(result) && ldrGetNumRegisteredParts(loader) == numParts
+                      && ldrGetNumRegisteredMaterials(loader) == ldrGetNumRegisteredMaterials(m_loader);
+  for(uint32_t p = 0; p < numParts && matching; p++) {
+    const LdrPart* part    = ldrGetPart(m_loader, p);
+    const LdrPart* newPart = ldrGetPart(loader, p);
+    const char*    name    = part ? part->name : nullptr;
+    const char*    newName = newPart ? newPart->name : nullptr;
+    matching               = name == newName || (name && newName && strcmp(name, newName) == 0);
+  }
+  time += getMicroSeconds();
+  timings.dependency = time;
+
+  if(matching) {
+    PartSchedule schedule;
+    time = -getMicroSeconds();
+    buildPartSchedule(loader, partIds, m_partCosts, m_ldrawPath, m_modelFilename, createInfo.partHiResPrimitives != LDR_FALSE,
+                      m_threadPool->getNumWorkers(), schedule);
+    time += getMicroSeconds();
+    timings.schedule = time;
+
+    std::vector<PartStage> stages = {{"load", ldrLoadDeferredParts}};
+    if(createInfo.partFixMode != LDR_PART_FIX_NONE) {
+      stages.push_back({"fix", ldrFixParts});
+    }
+    if(createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD) {
+      stages.push_back({"build", ldrBuildRenderParts});
+    }
+
+    time   = -getMicroSeconds();
+    result = processPartsParallel(loader, schedule, stages);
+    time += getMicroSeconds();
+    timings.load = time;
+  }
+  else {
+    log("update: the new loader registers the parts differently\n");
+    result = isLoadSuccess(result) ? LDR_ERROR_OTHER : result;
+  }
+
+  if(!isLoadSuccess(result)) {
+    if(loader) {
+      ldrDestroyModel(loader, model);
+      ldrDestroyLoader(loader);
+    }
+    return result;
+  }
+
+  // every part of the previous update loader is among partIds
+  if(m_updateLoader) {
+    ldrDestroyModel(m_updateLoader, m_updateModel);
+    ldrDestroyLoader(m_updateLoader);
+  }
+  m_updateLoader = loader;
+  m_updateModel  = model;
+  m_updatedParts.assign(numParts, 0);
+  for(LdrPartID id : partIds) {
+    m_updatedParts[id] = 1;
+  }
+  log("rebuilt %d of %d parts on a new loader in %.2f ms\n", uint32_t(partIds.size()), numParts,
+      (timings.dependency + timings.schedule + timings.load) / 1000.0f);
+
+  return result;
+}
+
+LdrResult ScenePipeline::updateModel(const LdrLoaderCreateInfo& createInfo, const SceneLoadSettings& settings, SceneLoadTimings& timings)
+{
+  timings = SceneLoadTimings();
+
+  SceneReloadStage stage = getReloadStage(createInfo, settings);
+  assert(stage != RELOAD_FULL);
+
+  bool reoptimize = stage > RELOAD_POSTPROCESS || settings.optimizeParts != m_settings.optimizeParts;
+  bool inPlace    = stage == RELOAD_NONE || canUpdateInPlace(createInfo, stage, reoptimize);
+
+  log("update from stage %s%s\n", getReloadStageName(stage), inPlace ? "" : " on a new loader");
+
+  double    timeAll = -getMicroSeconds();
+  double    time;
+  LdrResult result = LDR_SUCCESS;
+
+  // the affected parts depend on the current settings, nothing changes if this fails
+  std::vector<LdrPartID> partIds;
+  bool                   chamferOnly = false;
+  if(!inPlace) {
+    chamferOnly = getAffectedParts(createInfo, stage, partIds);
+    result      = rebuildParts(createInfo, partIds, timings);
+    if(!isLoadSuccess(result))
+      return result;
+  }
+  m_chamferedParts.clear();
+  if(chamferOnly) {
+    m_chamferedParts.swap(partIds);
+  }
+
+  // same rules as resetLoader, loading strategies only apply to the next load
+  m_createInfo            = createInfo;
+  m_settings              = settings;
+  m_settings.threadedLoad = settings.threadedLoad || settings.pipelinedLoad || settings.partCache;
+
+  if(stage == RELOAD_NONE)
+    return LDR_SUCCESS;
+
+  // cache hits are rebuilt when reoptimizing, every remaining entry is an optimized part
+  if(reoptimize) {
+    m_cachedParts.assign(m_cachedParts.size(), nullptr);
+    m_cachedRenderParts.assign(m_cachedRenderParts.size(), nullptr);
+    m_cachedPartViews.clear();
+    m_optimizedParts.clear();
+    m_partOptimizations.clear();
+    m_partCacheHits = 0;
+  }
+  m_partLods.clear();
+  m_renderPartLods.clear();
+
+  if(inPlace && stage >= RELOAD_RENDERPARTS && m_schedule.partIds.empty()) {
+    // the single threaded path loaded every registered part
+    std::vector<LdrPartID> partIds;
+    for(uint32_t p = 0; p < ldrGetNumRegisteredParts(m_loader); p++) {
+      if(ldrGetPart(m_loader, p)) {
+        partIds.push_back(LdrPartID(p));
+      }
+    }
+    buildPartSchedule(m_loader, partIds, m_partCosts, m_ldrawPath, m_modelFilename, m_createInfo.partHiResPrimitives != LDR_FALSE,
+                      m_threadPool->getNumWorkers(), m_schedule);
+  }
+
+  if(stage >= RELOAD_RENDERPARTS) {
+    ldrDestroyRenderModel(m_loader, m_renderModel);
+    m_renderModel = nullptr;
+
+    // render parts stay in the loader when building is turned off, turning it back on reuses them
+    if(m_createInfo.renderpartBuildMode == LDR_RENDERPART_BUILD_ONLOAD) {
+      if(inPlace && !m_renderPartsBuilt) {
+        time   = -getMicroSeconds();
+        result = processPartsParallel(m_loader, m_schedule, {{"build", ldrBuildRenderParts}});
+        assert(isLoadSuccess(result));
+        time += getMicroSeconds();
+        timings.build      = time;
+        m_renderPartsBuilt = true;
+        log("build time %.2f ms\n", time / 1000.0f);
+      }
+
+      // the render parts are built by now, rebuilt ones are taken from the update loader through getRenderPart
+      time   = -getMicroSeconds();
+      result = ldrCreateRenderModel(m_loader, m_model, LDR_FALSE, &m_renderModel);
+      assert(isLoadSuccess(result));
+      time += getMicroSeconds();
+      timings.renderModel = time;
+    }
+  }
+
+  postProcessParts(reoptimize, timings);
+
+  timeAll += getMicroSeconds();
+  timings.total = timeAll;
+  log("update time %.2f ms\n", timeAll / 1000.0f);
+
+  return result;
+}
+
+void ScenePipeline::optimizeParts()
+{
+  uint32_t numParts = ldrGetNumRegisteredParts(m_loader);
+  m_cachedParts.resize(numParts, nullptr);
+  m_cachedRenderParts.resize(numParts, nullptr);
+  m_optimizedParts.clear();
+  m_optimizedParts.resize(numParts);
+  m_partOptimizations.clear();
+
+  // part cache hits were optimized before they were stored, parts the model does not use are skipped
+  std::vector<uint8_t> optimize;
+  getActiveParts(m_model, numParts, optimize);
+  for(uint32_t p = 0; p < numParts; p++) {
+    optimize[p] = optimize[p] && !m_cachedParts[p] && ldrGetPart(getPartLoader(p), p);
+  }
+
+  m_threadPool->parallelItems(numParts, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t p = begin; p < end; p++) {
+      if(optimize[p]) {
+        m_optimizedParts[p].init(ldrGetPart(getPartLoader(p), p), ldrGetRenderPart(getPartLoader(p), p));
+      }
+    }
+  });
+
+  for(uint32_t p = 0; p < numParts; p++) {
+    if(!optimize[p])
+      continue;
+
+    m_cachedParts[p]       = m_optimizedParts[p].getPart();
+    m_cachedRenderParts[p] = m_optimizedParts[p].getRenderPart();
+    m_partOptimizations.push_back({LdrPartID(p), m_optimizedParts[p].getStats()});
+  }
+}
+
+// reorders every level for the vertex cache, like OptimizedPart does for the full geometry
+static void optimizeLodChain(PartLodChain& chain, uint32_t numVertices)
+{
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> triangles;
+  for(uint32_t l = 0; l < chain.numLevels; l++) {
+    std::vector<uint32_t>& level        = chain.triangles[l];
+    uint32_t               numTriangles = uint32_t(level.size() / 3);
+    optimizeVertexCache(level.data(), numTriangles, numVertices, order);
+
+    triangles.resize(level.size());
+    for(uint32_t t = 0; t < numTriangles; t++) {
+      memcpy(&triangles[t * 3], &level[order[t] * 3], sizeof(uint32_t) * 3);
+    }
+    level.swap(triangles);
+  }
+}
+
+void ScenePipeline::buildPartLods()
+{
+  uint32_t numParts = ldrGetNumRegisteredParts(m_loader);
+  m_partLods.clear();
+  m_partLods.resize(numParts);
+  m_renderPartLods.clear();
+  m_renderPartLods.resize(numParts);
+
+  std::vector<uint8_t> activeParts;
+  getActiveParts(m_model, numParts, activeParts);
+
+  // dropped triangles would shift per-triangle materials, parts with them keep the full geometry
+  m_threadPool->parallelItems(numParts, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t p = begin; p < end; p++) {
+      if(!activeParts[p])
+        continue;
+
+      const LdrPart* part = getPart(p);
+      if(part && !part->flags.hasComplexMaterial) {
+        buildPartLodChain(part->triangles, part->numTriangles, part->lines, part->numLines, part->positions, sizeof(LdrVector), 0,
+                          part->numPositions, false, m_partLods[p]);
+        if(m_settings.optimizeParts) {
+          optimizeLodChain(m_partLods[p], part->numPositions);
+        }
+      }
+
+      const LdrRenderPart* rpart = getRenderPart(p);
+      if(rpart && !rpart->flags.hasComplexMaterial) {
+        buildPartLodChain(rpart->triangles, rpart->numTriangles, rpart->lines, rpart->numLines, rpart->vertices,
+                          sizeof(LdrRenderVertex), offsetof(LdrRenderVertex, normal), rpart->numVertices, true, m_renderPartLods[p]);
+        if(m_settings.optimizeParts) {
+          optimizeLodChain(m_renderPartLods[p], rpart->numVertices);
+        }
+      }
+    }
+  });
+}
+
+const PartLodChain* ScenePipeline::getPartLods(LdrPartID id, bool renderPart) const
+{
+  const std::vector<PartLodChain>& lods = renderPart ? m_renderPartLods : m_partLods;
+  if(id >= lods.size() || !lods[id].numLevels)
+    return nullptr;
+  return &lods[id];
+}
+
+LdrResult ScenePipeline::processPartsParallel(LdrLoaderHDL                  loader,
+                                              const PartSchedule&           schedule,
+                                              const std::vector<PartStage>& stages,
+                                              std::vector<WorkerStats>*     workerStats,
+                                              std::vector<double>*          firstStageTimes,
+                                              std::vector<double>*          stageTimes)
+{
+  uint32_t numWorkers = std::max(m_threadPool->getNumWorkers(), 1u);
+  uint32_t numStages  = uint32_t(stages.size());
+
+  std::vector<LdrResult> errors(numWorkers, LDR_SUCCESS);
+  std::vector<double>    workerStageTimes(numWorkers * numStages, 0);
+
+  if(firstStageTimes) {
+    firstStageTimes->clear();
+    firstStageTimes->resize(schedule.partIds.size(), 0);
+  }
+
+  m_threadPool->parallelBatches(
+      schedule.batches,
+      [&](uint32_t idx, uint32_t begin, uint32_t end) {
+        for(uint32_t s = 0; s < numStages; s++) {
+          double    time  = -getMicroSeconds();
+          LdrResult error = stages[s].fn(loader, end - begin, &schedule.partIds[begin], sizeof(LdrPartID));
+          time += getMicroSeconds();
+
+          workerStageTimes[idx * numStages + s] += time;
+          if(firstStageTimes && s == 0) {
+            (*firstStageTimes)[begin] = time;
+          }
+          if(!isLoadSuccess(error) || errors[idx] == LDR_SUCCESS) {
+            errors[idx] = error;
+          }
+        }
+      },
+      workerStats);
+
+  if(stageTimes) {
+    stageTimes->clear();
+    stageTimes->resize(numStages, 0);
+    for(uint32_t i = 0; i < numWorkers; i++) {
+      for(uint32_t s = 0; s < numStages; s++) {
+        (*stageTimes)[s] += workerStageTimes[i * numStages + s];
+      }
+    }
+  }
+
+  LdrResult result = LDR_SUCCESS;
+  for(LdrResult error : errors) {
+    if(!isLoadSuccess(error)) {
+      return error;
+    }
+    if(error != LDR_SUCCESS) {
+      result = error;
+    }
+  }
+  return result;
+}
+
+const LdrPart* ScenePipeline::getPart(LdrPartID id) const
+{
+  if(id < m_cachedParts.size() && m_cachedParts[id]) {
+    return m_cachedParts[id];
+  }
+  return ldrGetPart(getPartLoader(id), id);
+}
+
+const LdrRenderPart* ScenePipeline::getRenderPart(LdrPartID id) const
+{
+  if(id < m_cachedParts.size() && m_cachedParts[id]) {
+    return m_cachedRenderParts[id];
+  }
+  return ldrGetRenderPart(getPartLoader(id), id);
+}
+
+LdrLoaderHDL ScenePipeline::getPartLoader(LdrPartID id) const
+{
+  return id < m_updatedParts.size() && m_updatedParts[id] ? m_updateLoader : m_loader;
+}
+
+namespace {
+struct PartCounts
+{
+  uint32_t vertices;
+  uint32_t indices;
+  uint32_t indices16;
+  uint32_t materials;
+};
+}  // namespace
+
+// exclusive prefix sum in three passes: block sums in parallel, serial scan over
+// the few block sums, then each block is scanned in parallel starting at its base
+static PartCounts exclusiveScanParallel(ThreadPool& threadPool, std::vector<PartCounts>& counts)
+{
+  uint32_t numItems  = uint32_t(counts.size());
+  uint32_t numBlocks = std::min(std::max(threadPool.getNumWorkers(), 1u) * 4, std::max(numItems, 1u));
+  uint32_t blockSize = (numItems + numBlocks - 1) / numBlocks;
+
+  std::vector<PartCounts> blockSums(numBlocks, PartCounts());
+
+  threadPool.parallelBatches(numBlocks, 1, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t b = begin; b < end; b++) {
+      PartCounts sum = {};
+      for(uint32_t i = b * blockSize; i < std::min((b + 1) * blockSize, numItems); i++) {
+        sum.vertices += counts[i].vertices;
+        sum.indices += counts[i].indices;
+        sum.indices16 += counts[i].indices16;
+        sum.materials += counts[i].materials;
+      }
+      blockSums[b] = sum;
+    }
+  });
+
+  PartCounts total = {};
+  for(uint32_t b = 0; b < numBlocks; b++) {
+    PartCounts sum = blockSums[b];
+    blockSums[b]   = total;
+    total.vertices += sum.vertices;
+    total.indices += sum.indices;
+    total.indices16 += sum.indices16;
+    total.materials += sum.materials;
+  }
+
+  threadPool.parallelBatches(numBlocks, 1, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t b = begin; b < end; b++) {
+      PartCounts offset = blockSums[b];
+      for(uint32_t i = b * blockSize; i < std::min((b + 1) * blockSize, numItems); i++) {
+        PartCounts count = counts[i];
+        counts[i]        = offset;
+        offset.vertices += count.vertices;
+        offset.indices += count.indices;
+        offset.indices16 += count.indices16;
+        offset.materials += count.materials;
+      }
+    }
+  });
+
+  return total;
+}
+
+namespace {
+struct VertexMaterialSplit
+{
+  std::vector<uint32_t>      vertices;   // source vertex of every output vertex, starts with the identity
+  std::vector<LdrMaterialID> materials;  // per output vertex
+  std::vector<uint32_t>      triangles;  // remapped triangles followed by the remapped chamfered triangles
+};
+}  // namespace
+
+// Every triangle corner must carry its triangle's material, so a vertex shared by triangles
+// of different materials is duplicated once per extra material. Source vertices keep their
+// index, which leaves lines untouched, duplicates are appended.
+static void splitVertexMaterials(uint32_t             numVertices,
+                                 const uint32_t*      triangles,
+                                 const LdrMaterialID* triangleMaterials,
+                                 uint32_t             numTriangles,
+                                 const uint32_t*      trianglesC,
+                                 const LdrMaterialID* materialsC,
+                                 uint32_t             numTrianglesC,
+                                 VertexMaterialSplit& split)
+{
+  const uint32_t UNUSED = ~0u;
+
+  split.vertices.resize(numVertices);
+  split.materials.assign(numVertices, UNUSED);
+  split.triangles.resize(size_t(numTriangles + numTrianglesC) * 3);
+  for(uint32_t v = 0; v < numVertices; v++) {
+    split.vertices[v] = v;
+  }
+
+  // duplicates of a source vertex form a list, materials per vertex are few
+  std::vector<uint32_t> next(numVertices, UNUSED);
+
+  auto remap = [&](uint32_t vertex, LdrMaterialID material) {
+    uint32_t last = vertex;
+    for(uint32_t v = vertex; v != UNUSED; v = next[v]) {
+      if(split.materials[v] == UNUSED) {
+        split.materials[v] = material;
+      }
+      if(split.materials[v] == material)
+        return v;
+      last = v;
+    }
+    uint32_t added = uint32_t(split.vertices.size());
+    split.vertices.push_back(vertex);
+    split.materials.push_back(material);
+    next.push_back(UNUSED);
+    next[last] = added;
+    return added;
+  };
+
+  for(uint32_t t = 0; t < numTriangles; t++) {
+    LdrMaterialID material = triangleMaterials ? triangleMaterials[t] : LDR_MATERIALID_INHERIT;
+    for(uint32_t c = 0; c < 3; c++) {
+      split.triangles[t * 3 + c] = remap(triangles[t * 3 + c], material);
+    }
+  }
+  for(uint32_t t = 0; t < numTrianglesC; t++) {
+    LdrMaterialID material = materialsC ? materialsC[t] : LDR_MATERIALID_INHERIT;
+    for(uint32_t c = 0; c < 3; c++) {
+      split.triangles[(numTriangles + t) * 3 + c] = remap(trianglesC[t * 3 + c], material);
+    }
+  }
+
+  // only referenced by lines
+  for(LdrMaterialID& material : split.materials) {
+    if(material == UNUSED) {
+      material = LDR_MATERIALID_INHERIT;
+    }
+  }
+}
+
+// only parts with complex materials have meaningful per-triangle materials
+static void splitPartVertexMaterials(const LdrPart* part, const LdrRenderPart* rpart, VertexMaterialSplit& split)
+{
+  if(rpart) {
+    bool complex = rpart->flags.hasComplexMaterial;
+    splitVertexMaterials(rpart->numVertices, rpart->triangles, complex ? rpart->triangleMaterials : nullptr, rpart->numTriangles,
+                         rpart->trianglesC, complex ? rpart->materialsC : nullptr, rpart->numTrianglesC, split);
+  }
+  else {
+    bool complex = part->flags.hasComplexMaterial;
+    splitVertexMaterials(part->numPositions, part->triangles, complex ? part->triangleMaterials : nullptr, part->numTriangles,
+                         nullptr, nullptr, 0, split);
+  }
+}
+
+static size_t getSceneVertexSize(bool renderParts, const SceneVertexFormat& format)
+{
+  size_t vertexSize;
+  if(format.quantized) {
+    vertexSize = renderParts ? sizeof(QuantizedRenderVertex) : sizeof(QuantizedVertex);
+  }
+  else {
+    vertexSize = renderParts ? sizeof(LdrRenderVertex) : sizeof(LdrVector);
+  }
+  return vertexSize + (format.materials ? sizeof(LdrMaterialID) : 0);
+}
+
+// converts source vertices to the layout's format, either in source order or through a split,
+// quantized positions are relative to bbox
+static void packVertices(uint8_t*                   dst,
+                         size_t                     dstVertexSize,
+                         const SceneVertexFormat&   format,
+                         bool                       renderParts,
+                         const void*                src,
+                         uint32_t                   numVertices,
+                         const LdrBbox&             bbox,
+                         const VertexMaterialSplit* split)
+{
+  size_t srcVertexSize = renderParts ? sizeof(LdrRenderVertex) : sizeof(LdrVector);
+
+  for(uint32_t v = 0; v < numVertices; v++) {
+    uint32_t       srcVertex = split ? split->vertices[v] : v;
+    const uint8_t* srcData   = (const uint8_t*)src + srcVertexSize * srcVertex;
+    uint8_t*       dstData   = dst + dstVertexSize * v;
+
+    if(format.quantized && renderParts) {
+      LdrRenderVertex       vertex;
+      QuantizedRenderVertex quantized;
+      memcpy(&vertex, srcData, sizeof(vertex));
+      quantizePosition(vertex.position, bbox, quantized.position);
+      encodeOctahedral(vertex.normal, quantized.normal);
+      memcpy(dstData, &quantized, sizeof(quantized));
+    }
+    else if(format.quantized) {
+      LdrVector       position;
+      QuantizedVertex quantized;
+      memcpy(&position, srcData, sizeof(position));
+      quantizePosition(position, bbox, quantized.position);
+      memcpy(dstData, &quantized, sizeof(quantized));
+    }
+    else {
+      memcpy(dstData, srcData, srcVertexSize);
+    }
+
+    if(format.materials) {
+      LdrMaterialID material = split ? split->materials[v] : LDR_MATERIALID_INHERIT;
+      memcpy(dstData + dstVertexSize - sizeof(LdrMaterialID), &material, sizeof(LdrMaterialID));
+    }
+  }
+}
+
+void ScenePipeline::computeSceneLayout(LdrModelHDL              model,
+                                       bool                     renderParts,
+                                       const SceneVertexFormat& format,
+                                       std::vector<DrawPart>&   drawParts,
+                                       SceneLayout&             layout) const
+{
+  uint32_t numParts = ldrGetNumRegisteredParts(m_loader);
+  drawParts.clear();
+  drawParts.resize(numParts, DrawPart());
+
+  std::vector<uint8_t> activeParts;
+  getActiveParts(model, numParts, activeParts);
+
+  layout            = SceneLayout();
+  layout.vertexSize = getSceneVertexSize(renderParts, format);
+  layout.format     = format;
+
+  // per-part counts
+  std::vector<PartCounts> counts(numParts, PartCounts());
+  std::vector<uint32_t>   splitMaterials(numParts, 0);
+
+  m_threadPool->parallelItems(numParts, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+      if(!activeParts[i])
+        continue;
+
+      const LdrPart* part = getPart(i);
+      if(!part)
+        continue;
+
+      DrawPart& drawPart = drawParts[i];
+
+      uint32_t materialIndexCount  = 0;
+      uint32_t materialIndexCountC = 0;
+
+      drawPart.flags = DRAWPART_ACTIVE;
+      if(part->flags.hasNoBackFaceCulling) {
+        drawPart.flags |= DRAWPART_NO_BACKFACE_CULLING;
+      }
+
+      if(!renderParts) {
+        drawPart.vertexCount    = part->numPositions;
+        drawPart.triangleCount  = part->numTriangles;
+        drawPart.edgesCount     = part->numLines;
+        drawPart.optionalCount  = part->numOptionalLines;
+        drawPart.triangleCountC = 0;
+        if(part->triangleMaterials && part->flags.hasComplexMaterial) {
+          materialIndexCount = part->numTriangles;
+          drawPart.flags |= DRAWPART_MATERIALS;
+        }
+      }
+      else {
+        const LdrRenderPart* rpart = getRenderPart(i);
+        if(rpart) {
+          drawPart.vertexCount    = rpart->numVertices;
+          drawPart.triangleCount  = rpart->numTriangles;
+          drawPart.edgesCount     = rpart->numLines;
+          drawPart.optionalCount  = 0;
+          drawPart.triangleCountC = rpart->numTrianglesC;
+          drawPart.flags |= DRAWPART_RENDERPART;
+          if(rpart->flags.canChamfer) {
+            drawPart.flags |= DRAWPART_CAN_CHAMFER;
+          }
+          if(rpart->triangleMaterials && rpart->flags.hasComplexMaterial) {
+            materialIndexCount = rpart->numTriangles;
+            drawPart.flags |= DRAWPART_MATERIALS;
+          }
+          if(rpart->materialsC && rpart->flags.hasComplexMaterial) {
+            materialIndexCountC = rpart->numTrianglesC;
+            drawPart.flags |= DRAWPART_MATERIALS_C;
+          }
+        }
+      }
+
+      // the split replaces the per-triangle materials
+      if(format.materials && (drawPart.flags & (DRAWPART_MATERIALS | DRAWPART_MATERIALS_C))) {
+        VertexMaterialSplit split;
+        splitPartVertexMaterials(part, renderParts ? getRenderPart(i) : nullptr, split);
+        drawPart.vertexCount = uint32_t(split.vertices.size());
+        drawPart.flags       = (drawPart.flags & ~(DRAWPART_MATERIALS | DRAWPART_MATERIALS_C)) | DRAWPART_VERTEX_MATERIALS;
+        splitMaterials[i]    = materialIndexCount + materialIndexCountC;
+        materialIndexCount   = 0;
+        materialIndexCountC  = 0;
+      }
+
+      // complex materials never have levels, so neither do split parts
+      const PartLodChain* lods = (!renderParts || (drawPart.flags & DRAWPART_RENDERPART)) ? getPartLods(i, renderParts) : nullptr;
+      uint32_t            lodIndexCount = 0;
+      drawPart.lodLevels                = lods ? lods->numLevels : 0;
+      for(uint32_t l = 0; l < drawPart.lodLevels; l++) {
+        drawPart.lodTriangleCount[l] = uint32_t(lods->triangles[l].size() / 3);
+        drawPart.lodError[l]         = lods->error[l];
+        lodIndexCount += drawPart.lodTriangleCount[l] * 3;
+      }
+
+      uint32_t indexCount = drawPart.triangleCount * 3 + drawPart.edgesCount * 2 + drawPart.optionalCount * 2 + drawPart.triangleCountC * 3
+                            + lodIndexCount;
+      if(drawPart.vertexCount <= 0x10000) {
+        drawPart.flags |= DRAWPART_INDEX16;
+        counts[i].indices16 = indexCount;
+      }
+      else {
+        counts[i].indices = indexCount;
+      }
+      counts[i].vertices  = drawPart.vertexCount;
+      counts[i].materials = materialIndexCount + materialIndexCountC;
+
+      // relative offsets within the part, made absolute once the bases are known
+      drawPart.triangleOffset    = 0;
+      drawPart.edgesOffset       = drawPart.triangleOffset + drawPart.triangleCount * 3;
+      drawPart.optionalOffset    = drawPart.edgesOffset + drawPart.edgesCount * 2;
+      drawPart.triangleOffsetC   = drawPart.optionalOffset + drawPart.optionalCount * 2;
+      for(uint32_t l = 0; l < drawPart.lodLevels; l++) {
+        drawPart.lodTriangleOffset[l] = l ? drawPart.lodTriangleOffset[l - 1] + drawPart.lodTriangleCount[l - 1] * 3 :
+                                            drawPart.triangleOffsetC + drawPart.triangleCountC * 3;
+      }
+      drawPart.materialIDOffset  = 0;
+      drawPart.materialIDOffsetC = materialIndexCount;
+    }
+  });
+
+  PartCounts total = exclusiveScanParallel(*m_threadPool, counts);
+
+  m_threadPool->parallelItems(numParts, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+      DrawPart& drawPart = drawParts[i];
+      if(!(drawPart.flags & DRAWPART_ACTIVE))
+        continue;
+
+      // the uint16_t pool starts after the uint32_t pool, counted in uint16_t
+      uint32_t indexOffset = (drawPart.flags & DRAWPART_INDEX16) ? total.indices * 2 + counts[i].indices16 : counts[i].indices;
+
+      drawPart.vertexOffset = counts[i].vertices;
+      drawPart.triangleOffset += indexOffset;
+      drawPart.edgesOffset += indexOffset;
+      drawPart.optionalOffset += indexOffset;
+      drawPart.triangleOffsetC += indexOffset;
+      for(uint32_t l = 0; l < drawPart.lodLevels; l++) {
+        drawPart.lodTriangleOffset[l] += indexOffset;
+      }
+      drawPart.materialIDOffset += counts[i].materials;
+      drawPart.materialIDOffsetC += counts[i].materials;
+    }
+  });
+
+  layout.numVertices  = total.vertices;
+  layout.numIndices   = total.indices;
+  layout.numIndices16 = total.indices16;
+  layout.numMaterials = total.materials;
+
+  for(uint32_t i = 0; i < numParts; i++) {
+    const DrawPart& drawPart = drawParts[i];
+    if(!(drawPart.flags & DRAWPART_VERTEX_MATERIALS))
+      continue;
+
+    uint32_t sourceVertices = renderParts ? getRenderPart(i)->numVertices : getPart(i)->numPositions;
+    layout.splitVertices += drawPart.vertexCount - sourceVertices;
+    layout.splitMaterials += splitMaterials[i];
+  }
+}
+
+void ScenePipeline::packSceneBuffers(const std::vector<DrawPart>& drawParts,
+                                     const SceneLayout&           layout,
+                                     bool                         renderParts,
+                                     void*                        vertices,
+                                     void*                        indices,
+                                     LdrMaterialID*               materials) const
+{
+  uint8_t* vertexData = (uint8_t*)vertices;
+  size_t   vertexSize = layout.vertexSize;
+
+  auto copyData = [](void* dst, const void* src, size_t size) {
+    if(size) {
+      memcpy(dst, src, size);
+    }
+  };
+  // source indices are uint32_t, narrowed for parts in the uint16_t pool
+  auto copyIndices = [&](const DrawPart& drawPart, uint32_t offset, const uint32_t* src, uint32_t count) {
+    if(drawPart.flags & DRAWPART_INDEX16) {
+      uint16_t* dst = (uint16_t*)indices + offset;
+      for(uint32_t i = 0; i < count; i++) {
+        dst[i] = uint16_t(src[i]);
+      }
+    }
+    else {
+      copyData((uint32_t*)indices + offset, src, sizeof(uint32_t) * count);
+    }
+  };
+
+  m_threadPool->parallelItems(uint32_t(drawParts.size()), [&](uint32_t, uint32_t begin, uint32_t end) {
+    VertexMaterialSplit split;
+
+    for(uint32_t i = begin; i < end; i++) {
+      const DrawPart& drawPart = drawParts[i];
+
+      if(!(drawPart.flags & DRAWPART_ACTIVE))
+        continue;
+
+      // converted per vertex, indices are copied unless the material split remapped them
+      if(layout.format.materials || layout.format.quantized) {
+        if(renderParts && !(drawPart.flags & DRAWPART_RENDERPART))
+          continue;
+
+        const LdrPart*       part    = getPart(i);
+        const LdrRenderPart* rpart   = renderParts ? getRenderPart(i) : nullptr;
+        const void*          src     = rpart ? (const void*)rpart->vertices : (const void*)part->positions;
+        uint32_t             srcNum  = rpart ? rpart->numVertices : part->numPositions;
+        uint8_t*             dst     = &vertexData[vertexSize * drawPart.vertexOffset];
+        bool                 isSplit = (drawPart.flags & DRAWPART_VERTEX_MATERIALS) != 0;
+
+        // same bounds as computePartBounds
+        LdrBbox bbox = computeVertexBbox(src, rpart ? sizeof(LdrRenderVertex) : sizeof(LdrVector), srcNum);
+
+        if(isSplit) {
+          splitPartVertexMaterials(part, rpart, split);
+        }
+        packVertices(dst, vertexSize, layout.format, renderParts, src, drawPart.vertexCount, bbox, isSplit ? &split : nullptr);
+
+        // materials without split go through the index buffer as before
+        if(drawPart.flags & DRAWPART_MATERIALS) {
+          copyData(&materials[drawPart.materialIDOffset], rpart ? rpart->triangleMaterials : part->triangleMaterials,
+                   sizeof(LdrMaterialID) * drawPart.triangleCount);
+        }
+        if(drawPart.flags & DRAWPART_MATERIALS_C) {
+          copyData(&materials[drawPart.materialIDOffsetC], rpart->materialsC, sizeof(LdrMaterialID) * drawPart.triangleCountC);
+        }
+
+        const uint32_t* triangles = isSplit ? split.triangles.data() : (rpart ? rpart->triangles : part->triangles);
+        copyIndices(drawPart, drawPart.triangleOffset, triangles, drawPart.triangleCount * 3);
+        copyIndices(drawPart, drawPart.edgesOffset, rpart ? rpart->lines : part->lines, drawPart.edgesCount * 2);
+        if(rpart) {
+          const uint32_t* trianglesC = isSplit ? split.triangles.data() + drawPart.triangleCount * 3 : rpart->trianglesC;
+          copyIndices(drawPart, drawPart.triangleOffsetC, trianglesC, drawPart.triangleCountC * 3);
+        }
+        else {
+          copyIndices(drawPart, drawPart.optionalOffset, part->optional_lines, drawPart.optionalCount * 2);
+        }
+      }
+      else if(!renderParts) {
+        const LdrPart* part = getPart(i);
+
+        copyData(&vertexData[vertexSize * drawPart.vertexOffset], part->positions, vertexSize * drawPart.vertexCount);
+        copyIndices(drawPart, drawPart.triangleOffset, part->triangles, drawPart.triangleCount * 3);
+        copyIndices(drawPart, drawPart.edgesOffset, part->lines, drawPart.edgesCount * 2);
+        copyIndices(drawPart, drawPart.optionalOffset, part->optional_lines, drawPart.optionalCount * 2);
+
+        if(drawPart.flags & DRAWPART_MATERIALS) {
+          copyData(&materials[drawPart.materialIDOffset], part->triangleMaterials, sizeof(LdrMaterialID) * drawPart.triangleCount);
+        }
+      }
+      else if(drawPart.flags & DRAWPART_RENDERPART) {
+        const LdrRenderPart* rpart = getRenderPart(i);
+
+        copyData(&vertexData[vertexSize * drawPart.vertexOffset], rpart->vertices, vertexSize * drawPart.vertexCount);
+        copyIndices(drawPart, drawPart.triangleOffset, rpart->triangles, drawPart.triangleCount * 3);
+        copyIndices(drawPart, drawPart.edgesOffset, rpart->lines, drawPart.edgesCount * 2);
+        copyIndices(drawPart, drawPart.triangleOffsetC, rpart->trianglesC, drawPart.triangleCountC * 3);
+
+        if(drawPart.flags & DRAWPART_MATERIALS) {
+          copyData(&materials[drawPart.materialIDOffset], rpart->triangleMaterials, sizeof(LdrMaterialID) * drawPart.triangleCount);
+        }
+        if(drawPart.flags & DRAWPART_MATERIALS_C) {
+          copyData(&materials[drawPart.materialIDOffsetC], rpart->materialsC, sizeof(LdrMaterialID) * drawPart.triangleCountC);
+        }
+      }
+
+      // levels reference the unsplit vertices, parts with them never get split
+      const PartLodChain* lods = drawPart.lodLevels ? getPartLods(i, renderParts) : nullptr;
+      for(uint32_t l = 0; l < drawPart.lodLevels; l++) {
+        copyIndices(drawPart, drawPart.lodTriangleOffset[l], lods->triangles[l].data(), drawPart.lodTriangleCount[l] * 3);
+      }
+    }
+  });
+}
+
+void ScenePipeline::computePartBounds(const std::vector<DrawPart>& drawParts, bool renderParts, std::vector<LdrBbox>& bounds) const
+{
+  bounds.resize(drawParts.size());
+  m_threadPool->parallelItems(uint32_t(drawParts.size()), [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+      bounds[i] = computePartBounds(LdrPartID(i), drawParts[i], renderParts);
+    }
+  });
+}
+
+LdrBbox ScenePipeline::computePartBounds(LdrPartID id, const DrawPart& drawPart, bool renderParts) const
+{
+  if(!(drawPart.flags & DRAWPART_ACTIVE))
+    return makeEmptyBbox();
+
+  // split vertices only duplicate source vertices, so the source arrays give the same bounds
+  if(!renderParts) {
+    return computeVertexBbox(getPart(id)->positions, sizeof(LdrVector), getPart(id)->numPositions);
+  }
+  if(drawPart.flags & DRAWPART_RENDERPART) {
+    return computeVertexBbox(getRenderPart(id)->vertices, sizeof(LdrRenderVertex), getRenderPart(id)->numVertices);
+  }
+  return makeEmptyBbox();
+}
+
+void ScenePipeline::buildMeshlets(std::vector<DrawPart>& drawParts, bool renderParts, std::vector<Meshlet>& meshlets) const
+{
+  std::vector<std::vector<Meshlet>> partMeshlets(drawParts.size());
+  std::vector<std::vector<Meshlet>> partMeshletsC(drawParts.size());
+  m_threadPool->parallelItems(uint32_t(drawParts.size()), [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+      buildPartMeshlets(LdrPartID(i), drawParts[i], renderParts, partMeshlets[i], partMeshletsC[i]);
+    }
+  });
+
+  meshlets.clear();
+  for(size_t i = 0; i < drawParts.size(); i++) {
+    DrawPart& drawPart      = drawParts[i];
+    drawPart.meshletOffset  = uint32_t(meshlets.size());
+    drawPart.meshletCount   = uint32_t(partMeshlets[i].size());
+    meshlets.insert(meshlets.end(), partMeshlets[i].begin(), partMeshlets[i].end());
+    drawPart.meshletOffsetC = uint32_t(meshlets.size());
+    drawPart.meshletCountC  = uint32_t(partMeshletsC[i].size());
+    meshlets.insert(meshlets.end(), partMeshletsC[i].begin(), partMeshletsC[i].end());
+  }
+}
+
+void ScenePipeline::buildPartMeshlets(LdrPartID             id,
+                                      const DrawPart&       drawPart,
+                                      bool                  renderParts,
+                                      std::vector<Meshlet>& meshlets,
+                                      std::vector<Meshlet>& meshletsC) const
+{
+  meshlets.clear();
+  meshletsC.clear();
+
+  if(!(drawPart.flags & DRAWPART_ACTIVE))
+    return;
+
+  // split vertices keep the triangle order and positions, so the source lists give the same ranges
+  if(!renderParts) {
+    const LdrPart* part = getPart(id);
+    ldrawviewer::buildMeshlets(part->triangles, part->numTriangles, part->positions, sizeof(LdrVector), part->numPositions, meshlets);
+  }
+  else if(drawPart.flags & DRAWPART_RENDERPART) {
+    const LdrRenderPart* rpart = getRenderPart(id);
+    ldrawviewer::buildMeshlets(rpart->triangles, rpart->numTriangles, rpart->vertices, sizeof(LdrRenderVertex), rpart->numVertices,
+                               meshlets);
+    ldrawviewer::buildMeshlets(rpart->trianglesC, rpart->numTrianglesC, rpart->vertices, sizeof(LdrRenderVertex),
+                               rpart->numVertices, meshletsC);
+  }
+}
+
+void ScenePipeline::computeQuantizationErrors(const std::vector<DrawPart>&    drawParts,
+                                              bool                            renderParts,
+                                              std::vector<QuantizationError>& errors) const
+{
+  std::vector<QuantizationError> partErrors(drawParts.size());
+  m_threadPool->parallelItems(uint32_t(drawParts.size()), [&](uint32_t, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+      const DrawPart& drawPart = drawParts[i];
+      partErrors[i]            = {LDR_INVALID_ID, 0, 0};
+
+      if(!(drawPart.flags & DRAWPART_ACTIVE))
+        continue;
+
+      if(!renderParts) {
+        const LdrPart* part = getPart(i);
+        LdrBbox        bbox = computeVertexBbox(part->positions, sizeof(LdrVector), part->numPositions);
+        partErrors[i] = measureQuantizationError(LdrPartID(i), part->positions, sizeof(LdrVector), 0, part->numPositions, bbox, false);
+      }
+      else if(drawPart.flags & DRAWPART_RENDERPART) {
+        const LdrRenderPart* rpart = getRenderPart(i);
+        LdrBbox              bbox  = computeVertexBbox(rpart->vertices, sizeof(LdrRenderVertex), rpart->numVertices);
+        partErrors[i] = measureQuantizationError(LdrPartID(i), rpart->vertices, sizeof(LdrRenderVertex),
+                                                 offsetof(LdrRenderVertex, normal), rpart->numVertices, bbox, true);
+      }
+    }
+  });
+
+  errors.clear();
+  for(const QuantizationError& error : partErrors) {
+    if(error.part != LDR_INVALID_ID) {
+      errors.push_back(error);
+    }
+  }
+}
+
+void getVertexMaterialBytes(const SceneLayout& layout, size_t& addedBytes, size_t& savedBytes)
+{
+  addedBytes = 0;
+  savedBytes = 0;
+  if(!layout.format.materials)
+    return;
+
+  size_t sourceVertexSize = layout.vertexSize - sizeof(LdrMaterialID);
+  addedBytes              = layout.vertexSize * layout.numVertices - sourceVertexSize * (layout.numVertices - layout.splitVertices);
+  savedBytes              = sizeof(LdrMaterialID) * layout.splitMaterials;
+}
+
+void computePartMemory(const std::vector<DrawPart>& drawParts, const SceneLayout& layout, LdrModelHDL model, std::vector<PartMemory>& parts)
+{
+  std::vector<uint32_t> instances(drawParts.size(), 0);
+  for(uint32_t i = 0; i < model->numInstances; i++) {
+    LdrPartID part = model->instances[i].part;
+    if(part != LDR_INVALID_ID && part < instances.size()) {
+      instances[part]++;
+    }
+  }
+
+  parts.clear();
+  for(uint32_t i = 0; i < uint32_t(drawParts.size()); i++) {
+    const DrawPart& drawPart = drawParts[i];
+    if(!(drawPart.flags & DRAWPART_ACTIVE))
+      continue;
+
+    PartMemory mem;
+    mem.part          = LdrPartID(i);
+    mem.instances     = instances[i];
+    mem.vertexBytes   = layout.vertexSize * drawPart.vertexCount;
+    mem.triangleBytes = getIndexSize(drawPart) * drawPart.triangleCount * 3;
+    mem.edgeBytes     = getIndexSize(drawPart) * drawPart.edgesCount * 2;
+    mem.optionalBytes = getIndexSize(drawPart) * drawPart.optionalCount * 2;
+    mem.chamferBytes  = getIndexSize(drawPart) * drawPart.triangleCountC * 3;
+    mem.materialBytes = 0;
+    mem.lodBytes      = 0;
+    for(uint32_t l = 0; l < drawPart.lodLevels; l++) {
+      mem.lodBytes += getIndexSize(drawPart) * drawPart.lodTriangleCount[l] * 3;
+    }
+    if(drawPart.flags & DRAWPART_MATERIALS) {
+      mem.materialBytes += sizeof(LdrMaterialID) * drawPart.triangleCount;
+    }
+    if(drawPart.flags & DRAWPART_MATERIALS_C) {
+      mem.materialBytes += sizeof(LdrMaterialID) * drawPart.triangleCountC;
+    }
+    parts.push_back(mem);
+  }
+
+  std::sort(parts.begin(), parts.end(), [](const PartMemory& a, const PartMemory& b) { return a.getTotal() > b.getTotal(); });
+}
+
+bool savePartMemoryCsv(const std::string& filename, const std::vector<PartMemory>& parts, const ScenePipeline* pipeline)
+{
+  FILE* file = fopen(filename.c_str(), "wt");
+  if(!file)
+    return false;
+
+  fprintf(file, "part,name,instances,vertex_bytes,triangle_bytes,edge_bytes,optional_bytes,chamfer_bytes,material_bytes,lod_bytes,"
+                "total_bytes\n");
+  for(const PartMemory& mem : parts) {
+    const LdrPart* part = pipeline ? pipeline->getPart(mem.part) : nullptr;
+    fprintf(file, "%d,%s,%d,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", mem.part, part && part->name ? part->name : "", mem.instances,
+            (unsigned long long)mem.vertexBytes, (unsigned long long)mem.triangleBytes, (unsigned long long)mem.edgeBytes,
+            (unsigned long long)mem.optionalBytes, (unsigned long long)mem.chamferBytes, (unsigned long long)mem.materialBytes,
+            (unsigned long long)mem.lodBytes, (unsigned long long)mem.getTotal());
+  }
+  fclose(file);
+  return true;
+}
+
+}  // namespace ldrawviewer
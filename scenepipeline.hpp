@@ -0,0 +1,330 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "external/ldrawloader/src/ldrawloader.h"
+
+#include "meshlets.hpp"
+#include "partcache.hpp"
+#include "partcost.hpp"
+#include "partlod.hpp"
+#include "partoptimizer.hpp"
+#include "threadpool.hpp"
+#include "vertexformat.hpp"
+
+namespace ldrawviewer {
+
+enum DrawPartFlags
+{
+  DRAWPART_ACTIVE              = 1,
+  DRAWPART_RENDERPART          = 2,
+  DRAWPART_NO_BACKFACE_CULLING = 4,
+  DRAWPART_CAN_CHAMFER         = 8,
+  DRAWPART_MATERIALS           = 16,
+  DRAWPART_MATERIALS_C         = 32,
+  // vertices were split along material boundaries, the material is part of the vertex
+  DRAWPART_VERTEX_MATERIALS = 64,
+  // indices are uint16_t, offsets count uint16_t from the start of the index buffer
+  DRAWPART_INDEX16 = 128,
+};
+
+struct DrawPart
+{
+  uint32_t flags;
+  uint32_t vertexCount;
+  uint32_t vertexOffset;
+  uint32_t triangleCount;
+  uint32_t triangleOffset;
+  uint32_t triangleCountC;
+  uint32_t triangleOffsetC;
+  uint32_t edgesCount;
+  uint32_t edgesOffset;
+  uint32_t optionalCount;
+  uint32_t optionalOffset;
+  uint32_t materialIDOffset;
+  uint32_t materialIDOffsetC;
+  // into the scene's meshlet array, for the triangles and the chamfered triangles
+  uint32_t meshletOffset;
+  uint32_t meshletCount;
+  uint32_t meshletOffsetC;
+  uint32_t meshletCountC;
+  // simplified triangle lists, level l > 0 replaces the triangle range with lodTriangleOffset/Count[l - 1],
+  // also for chamfered drawing. lodError is the object space error of the level.
+  uint32_t lodLevels;
+  uint32_t lodTriangleCount[PART_LOD_LEVELS - 1];
+  uint32_t lodTriangleOffset[PART_LOD_LEVELS - 1];
+  float    lodError[PART_LOD_LEVELS - 1];
+};
+
+struct SceneVertexFormat
+{
+  // every vertex ends with a uint32_t LdrMaterialID, LDR_MATERIALID_INHERIT for the instance's material
+  bool materials = false;
+  // QuantizedVertex or QuantizedRenderVertex instead of LdrVector or LdrRenderVertex
+  bool quantized = false;
+};
+
+struct SceneLayout
+{
+  size_t   vertexSize   = 0;
+  uint32_t numVertices  = 0;
+  uint32_t numIndices   = 0;  // uint32_t pool at the start of the index buffer
+  uint32_t numIndices16 = 0;  // uint16_t pool after it
+  uint32_t numMaterials = 0;
+
+  SceneVertexFormat format;
+  uint32_t          splitVertices  = 0;  // vertices added by splitting along material boundaries
+  uint32_t          splitMaterials = 0;  // per-triangle material IDs the split replaced
+
+  size_t getIndexBytes() const { return sizeof(uint32_t) * numIndices + sizeof(uint16_t) * numIndices16; }
+};
+
+// parts with few enough vertices use the uint16_t pool
+inline size_t getIndexSize(const DrawPart& drawPart)
+{
+  return (drawPart.flags & DRAWPART_INDEX16) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+struct SceneLoadSettings
+{
+  bool threadedLoad  = false;
+  bool pipelinedLoad = false;  // requires threadedLoad
+  bool partCache     = false;  // requires threadedLoad
+  bool optimizeParts = false;  // see OptimizedPart, with partCache the optimized parts are cached
+  bool partLods      = false;  // see PartLodChain, built for the parts of the model, never cached
+};
+
+// wall clock per stage in microseconds, stages that did not run stay 0
+struct SceneLoadTimings
+{
+  double dependency  = 0;
+  double cacheLookup = 0;
+  double schedule    = 0;
+  double load        = 0;  // deferred part loading (includes fix and build when pipelined), or all of ldrCreateModel
+  double resolve     = 0;
+  double fix         = 0;
+  double build       = 0;
+  double renderModel = 0;
+  double optimize    = 0;
+  double lods        = 0;
+  double cacheStore  = 0;
+  double total       = 0;
+};
+
+// earliest load stage a settings change invalidates, every later stage is rerun as well
+enum SceneReloadStage
+{
+  RELOAD_NONE,         // loading strategies only, the geometry stays the same
+  RELOAD_POSTPROCESS,  // optimizeParts, partLods
+  RELOAD_RENDERPARTS,  // render part building and chamfer
+  RELOAD_FULL,         // parsing and part fixing, anything the loader is created with besides build settings
+};
+
+const char* getReloadStageName(SceneReloadStage stage);
+
+// vertex cache behavior of a part optimized during the last load, parts that came
+// optimized from the part cache are not listed
+struct PartOptimization
+{
+  LdrPartID            part;
+  OptimizedPart::Stats stats;
+};
+
+// Everything from the loader to CPU-side scene buffers, no OpenGL involved,
+// so it can be driven by the viewer as well as the headless benchmark.
+class ScenePipeline
+{
+public:
+  ~ScenePipeline() { deinit(); }
+
+  // part cost history and part cache files are optional, empty strings disable them
+  void init(ThreadPool* threadPool, const std::string& ldrawPath, const std::string& partCostFile, const std::string& partCacheFile);
+  void deinit();
+
+  void setVerbose(bool verbose) { m_verbose = verbose; }
+
+  bool      resetLoader(const LdrLoaderCreateInfo& createInfo, const SceneLoadSettings& settings);
+  LdrResult loadModel(const std::string& filename, SceneLoadTimings& timings);
+  void      unloadModel();
+
+  // the stage updateModel would rerun to apply the settings to the loaded model, RELOAD_FULL only
+  // without a model or if parsing is affected.
+  SceneReloadStage getReloadStage(const LdrLoaderCreateInfo& createInfo, const SceneLoadSettings& settings) const;
+  // reruns the stages getReloadStage returns, which must not be RELOAD_FULL. Stages the loader can rerun
+  // run in place, otherwise only the affected parts are loaded again on a separate loader created with the
+  // new settings (see rebuildParts). The model stays, the render model may be replaced.
+  // Fails without changes if that loader registers the model's parts differently, a full reload is needed then.
+  LdrResult updateModel(const LdrLoaderCreateInfo& createInfo, const SceneLoadSettings& settings, SceneLoadTimings& timings);
+  // render parts the last updateModel rebuilt for a different chamfer while every other part kept its data,
+  // empty after any other update or load
+  const std::vector<LdrPartID>& getChamferedParts() const { return m_chamferedParts; }
+
+  LdrLoaderHDL      getLoader() const { return m_loader; }
+  LdrModelHDL       getModel() const { return m_model; }
+  LdrRenderModelHDL getRenderModel() const { return m_renderModel; }
+
+  // use these instead of ldrGetPart/ldrGetRenderPart, parts may come from the part cache or the update loader
+  const LdrPart*       getPart(LdrPartID id) const;
+  const LdrRenderPart* getRenderPart(LdrPartID id) const;
+
+  const std::vector<PartOptimization>& getPartOptimizations() const { return m_partOptimizations; }
+  // nullptr without simplified levels
+  const PartLodChain* getPartLods(LdrPartID id, bool renderPart) const;
+
+  // drawParts are indexed by LdrPartID, pack fills the buffers in parallel
+  void computeSceneLayout(LdrModelHDL              model,
+                          bool                     renderParts,
+                          const SceneVertexFormat& format,
+                          std::vector<DrawPart>&   drawParts,
+                          SceneLayout&             layout) const;
+  void packSceneBuffers(const std::vector<DrawPart>& drawParts,
+                        const SceneLayout&           layout,
+                        bool                         renderParts,
+                        void*                        vertices,
+                        void*                        indices,
+                        LdrMaterialID*               materials) const;
+  // local bounds of the geometry packSceneBuffers would upload, inactive parts stay empty.
+  // Quantized positions are relative to these bounds.
+  void    computePartBounds(const std::vector<DrawPart>& drawParts, bool renderParts, std::vector<LdrBbox>& bounds) const;
+  LdrBbox computePartBounds(LdrPartID id, const DrawPart& drawPart, bool renderParts) const;
+  // what quantization would lose per active part, for any layout
+  void computeQuantizationErrors(const std::vector<DrawPart>&    drawParts,
+                                 bool                            renderParts,
+                                 std::vector<QuantizationError>& errors) const;
+  // meshlets of the triangle lists packSceneBuffers would upload, sets the meshlet ranges of drawParts
+  void buildMeshlets(std::vector<DrawPart>& drawParts, bool renderParts, std::vector<Meshlet>& meshlets) const;
+  // the same for a single part, meshletsC stays empty unless it is a render part
+  void buildPartMeshlets(LdrPartID             id,
+                         const DrawPart&       drawPart,
+                         bool                  renderParts,
+                         std::vector<Meshlet>& meshlets,
+                         std::vector<Meshlet>& meshletsC) const;
+
+private:
+  struct PartStage
+  {
+    const char* name;
+    LdrResult (*fn)(LdrLoaderHDL, uint32_t, const LdrPartID*, size_t);
+  };
+  // each batch of parts runs through all stages in order before the next batch is picked.
+  // firstStageTimes holds the time of stages[0] alone per batch, indexed by its first item,
+  // stageTimes the time of every stage summed over all workers.
+  LdrResult processPartsParallel(LdrLoaderHDL                  loader,
+                                 const PartSchedule&           schedule,
+                                 const std::vector<PartStage>& stages,
+                                 std::vector<WorkerStats>*     workerStats     = nullptr,
+                                 std::vector<double>*          firstStageTimes = nullptr,
+                                 std::vector<double>*          stageTimes      = nullptr);
+
+  // whether m_loader can rerun the stages for the new settings on its own parts
+  bool canUpdateInPlace(const LdrLoaderCreateInfo& createInfo, SceneReloadStage stage, bool reoptimize) const;
+  // active parts whose data changes with the new settings when they cannot be updated in place,
+  // returns true if only the chamfer of render parts changes
+  bool getAffectedParts(const LdrLoaderCreateInfo& createInfo, SceneReloadStage stage, std::vector<LdrPartID>& partIds) const;
+  // loads and processes partIds on a new loader with createInfo, it replaces the previous update loader
+  LdrResult rebuildParts(const LdrLoaderCreateInfo& createInfo, const std::vector<LdrPartID>& partIds, SceneLoadTimings& timings);
+  // m_updateLoader for parts rebuilt by rebuildParts, m_loader otherwise
+  LdrLoaderHDL getPartLoader(LdrPartID id) const;
+
+  // replaces every loaded part the model instances that did not come from the part cache with an OptimizedPart
+  void optimizeParts();
+  // LOD chains of the parts and render parts the model instances
+  void buildPartLods();
+  // optimize and lod stages of loadModel, without optimize the current optimized parts stay
+  void postProcessParts(bool optimize, SceneLoadTimings& timings);
+
+  void log(const char* fmt, ...) const;
+
+  ThreadPool*         m_threadPool = nullptr;
+  bool                m_verbose    = true;
+  std::string         m_ldrawPath;
+  std::string         m_modelFilename;
+  LdrLoaderCreateInfo m_createInfo = {};
+  SceneLoadSettings   m_settings;
+  LdrLoaderHDL        m_loader      = nullptr;
+  LdrModelHDL         m_model       = nullptr;
+  LdrRenderModelHDL   m_renderModel = nullptr;
+
+  // what the loader was created with and which of its stages ran on the loaded parts,
+  // the loader cannot undo a stage or change its settings afterwards
+  LdrLoaderCreateInfo m_loaderInfo       = {};
+  bool                m_renderPartsBuilt = false;
+  uint32_t            m_partCacheHits    = 0;
+  PartSchedule        m_schedule;  // of the loaded parts, empty until a stage reruns on the single threaded path
+
+  // holds the parts m_loader could not update, registered with the same IDs, see rebuildParts
+  LdrLoaderHDL           m_updateLoader = nullptr;
+  LdrModelHDL            m_updateModel  = nullptr;
+  std::vector<uint8_t>   m_updatedParts;
+  std::vector<LdrPartID> m_chamferedParts;
+
+  PartCostEstimator m_partCosts;
+  std::string       m_partCostFile;
+  PartCache         m_partCache;
+  std::string       m_partCacheFile;
+  bool              m_partCacheLoaded = false;
+
+  // parts served by the part cache, nullptr where the loader's data is used
+  std::vector<const LdrPart*>       m_cachedParts;
+  std::vector<const LdrRenderPart*> m_cachedRenderParts;
+  // part cache hits with the instance count of the model
+  std::vector<LdrPart> m_cachedPartViews;
+  // backing storage of optimized parts that are not part cache entries
+  std::vector<OptimizedPart>    m_optimizedParts;
+  std::vector<PartOptimization> m_partOptimizations;
+  std::vector<PartLodChain>     m_partLods;
+  std::vector<PartLodChain>     m_renderPartLods;
+};
+
+// GPU memory a DrawPart occupies in the scene buffers
+struct PartMemory
+{
+  LdrPartID part;
+  uint32_t  instances;
+  size_t    vertexBytes;
+  size_t    triangleBytes;
+  size_t    edgeBytes;
+  size_t    optionalBytes;
+  size_t    chamferBytes;
+  size_t    materialBytes;
+  size_t    lodBytes;
+
+  size_t getTotal() const
+  {
+    return vertexBytes + triangleBytes + edgeBytes + optionalBytes + chamferBytes + materialBytes + lodBytes;
+  }
+};
+
+// with format.materials: vertex bytes added by the split and the material attribute,
+// and the per-triangle material bytes no longer stored
+void getVertexMaterialBytes(const SceneLayout& layout, size_t& addedBytes, size_t& savedBytes);
+
+// active parts only, sorted by total size, largest first
+void computePartMemory(const std::vector<DrawPart>& drawParts,
+                       const SceneLayout&           layout,
+                       LdrModelHDL                  model,
+                       std::vector<PartMemory>&     parts);
+// part names are taken from the pipeline if provided
+bool savePartMemoryCsv(const std::string& filename, const std::vector<PartMemory>& parts, const ScenePipeline* pipeline);
+
+}  // namespace ldrawviewer
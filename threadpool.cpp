@@ -0,0 +1,276 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace ldrawviewer {
+
+double getMicroSeconds()
+{
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+         / 1000.0;
+}
+
+void WorkStealingQueues::init(uint32_t numWorkers, uint32_t numItems, uint32_t batchSize)
+{
+  std::vector<Batch> batches;
+
+  batchSize         = std::max(batchSize, 1u);
+  uint32_t numBatch = (numItems + batchSize - 1) / batchSize;
+  batches.resize(numBatch);
+  for(uint32_t b = 0; b < numBatch; b++) {
+    batches[b].begin = b * batchSize;
+    batches[b].end   = std::min(batches[b].begin + batchSize, numItems);
+  }
+
+  init(numWorkers, batches);
+}
+
+void WorkStealingQueues::init(uint32_t numWorkers, const std::vector<Batch>& batches)
+{
+  m_queues = std::vector<Queue>(std::max(numWorkers, 1u));
+
+  for(size_t b = 0; b < batches.size(); b++) {
+    m_queues[b % m_queues.size()].batches.push_back(batches[b]);
+  }
+}
+
+bool WorkStealingQueues::acquire(uint32_t worker, Batch& batch, bool& stolen)
+{
+  {
+    Queue&                      own = m_queues[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if(!own.batches.empty()) {
+      batch = own.batches.front();
+      own.batches.pop_front();
+      stolen = false;
+      return true;
+    }
+  }
+
+  // no new batches are ever added, so a full sweep over empty victims means we are done
+  uint32_t numQueues = uint32_t(m_queues.size());
+  for(uint32_t i = 1; i < numQueues; i++) {
+    Queue&                      victim = m_queues[(worker + i) % numQueues];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if(!victim.batches.empty()) {
+      batch = victim.batches.back();
+      victim.batches.pop_back();
+      stolen = true;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint32_t getWorkStealingBatchSize(uint32_t numItems, uint32_t numWorkers)
+{
+  // aim for ~8 batches per worker, but keep batches small as single parts can be very costly
+  return std::min(std::max(numItems / (std::max(numWorkers, 1u) * 8), 1u), 16u);
+}
+
+void ThreadPool::init(uint32_t numWorkers)
+{
+  deinit();
+
+  numWorkers = std::max(numWorkers, 1u);
+
+  // measure what we save by keeping the threads alive
+  {
+    double time = -getMicroSeconds();
+
+    std::vector<std::thread> threads(numWorkers);
+    for(uint32_t i = 0; i < numWorkers; i++) {
+      threads[i] = std::thread([]() {});
+    }
+    for(uint32_t i = 0; i < numWorkers; i++) {
+      threads[i].join();
+    }
+
+    time += getMicroSeconds();
+    m_stats                   = Stats();
+    m_stats.spawnMicroSeconds = time / double(numWorkers);
+  }
+
+  m_shutdown   = false;
+  m_generation = 0;
+  m_threads.resize(numWorkers);
+  for(uint32_t i = 0; i < numWorkers; i++) {
+    m_threads[i] = std::thread(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+void ThreadPool::deinit()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shutdown = true;
+  }
+  m_wakeCondition.notify_all();
+
+  for(size_t i = 0; i < m_threads.size(); i++) {
+    m_threads[i].join();
+  }
+  m_threads.clear();
+}
+
+void ThreadPool::workerLoop(uint32_t idx)
+{
+  uint64_t generation = 0;
+
+  while(true) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wakeCondition.wait(lock, [&] { return m_shutdown || m_generation != generation; });
+      if(m_shutdown)
+        return;
+      generation = m_generation;
+    }
+
+    double latency = getMicroSeconds() - m_dispatchTime;
+
+    WorkerStats&              local = m_workerStats[idx];
+    WorkStealingQueues::Batch batch;
+    bool                      stolen;
+    while(m_queues.acquire(idx, batch, stolen)) {
+      double time = -getMicroSeconds();
+      (*m_fn)(idx, batch.begin, batch.end);
+      time += getMicroSeconds();
+
+      local.busyMicroSeconds += time;
+      local.batches++;
+      local.steals += stolen ? 1 : 0;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stats.wakeups++;
+      m_stats.queueLatencyMicroSeconds += latency;
+      m_stats.queueLatencyMaxMicroSeconds = std::max(m_stats.queueLatencyMaxMicroSeconds, latency);
+      if(--m_pending == 0) {
+        m_doneCondition.notify_one();
+      }
+    }
+  }
+}
+
+void ThreadPool::parallelBatches(uint32_t numItems, uint32_t batchSize, const BatchFunction& fn, std::vector<WorkerStats>* workerStats)
+{
+  std::lock_guard<std::mutex> dispatchLock(m_dispatchMutex);
+
+  m_queues.init(std::max(getNumWorkers(), 1u), numItems, batchSize);
+  dispatch(fn, workerStats);
+}
+
+void ThreadPool::parallelBatches(const std::vector<WorkStealingQueues::Batch>& batches,
+                                 const BatchFunction&                          fn,
+                                 std::vector<WorkerStats>*                     workerStats)
+{
+  std::lock_guard<std::mutex> dispatchLock(m_dispatchMutex);
+
+  m_queues.init(std::max(getNumWorkers(), 1u), batches);
+  dispatch(fn, workerStats);
+}
+
+void ThreadPool::dispatch(const BatchFunction& fn, std::vector<WorkerStats>* workerStats)
+{
+  uint32_t numWorkers = getNumWorkers();
+
+  m_workerStats = std::vector<WorkerStats>(std::max(numWorkers, 1u));
+
+  if(!numWorkers) {
+    // not initialized, process on calling thread
+    WorkerStats&              local = m_workerStats[0];
+    WorkStealingQueues::Batch batch;
+    bool                      stolen;
+    while(m_queues.acquire(0, batch, stolen)) {
+      double time = -getMicroSeconds();
+      fn(0, batch.begin, batch.end);
+      time += getMicroSeconds();
+
+      local.busyMicroSeconds += time;
+      local.batches++;
+    }
+    if(workerStats) {
+      *workerStats = m_workerStats;
+    }
+    return;
+  }
+
+  double timeBegin = getMicroSeconds();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fn           = &fn;
+    m_pending      = numWorkers;
+    m_dispatchTime = timeBegin;
+    m_generation++;
+  }
+  m_wakeCondition.notify_all();
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [&] { return m_pending == 0; });
+    m_fn = nullptr;
+  }
+  double timeTotal = getMicroSeconds() - timeBegin;
+
+  for(uint32_t i = 0; i < numWorkers; i++) {
+    m_workerStats[i].idleMicroSeconds = std::max(0.0, timeTotal - m_workerStats[i].busyMicroSeconds);
+  }
+
+  m_stats.jobs++;
+  m_stats.avoidedSpawnMicroSeconds += m_stats.spawnMicroSeconds * double(numWorkers);
+
+  if(workerStats) {
+    *workerStats = m_workerStats;
+  }
+}
+
+void ThreadPool::printStats() const
+{
+  printf("thread pool: %d workers, %d jobs, avoided thread creation %.2f ms, queue latency avg %.3f ms max %.3f ms\n",
+         getNumWorkers(), m_stats.jobs, m_stats.avoidedSpawnMicroSeconds / 1000.0f,
+         m_stats.wakeups ? m_stats.queueLatencyMicroSeconds / double(m_stats.wakeups) / 1000.0f : 0.0,
+         m_stats.queueLatencyMaxMicroSeconds / 1000.0f);
+}
+
+void printWorkerStats(const std::vector<WorkerStats>& stats)
+{
+  if(stats.empty())
+    return;
+
+  double busyMax = 0;
+  double busyAvg = 0;
+  for(size_t i = 0; i < stats.size(); i++) {
+    const WorkerStats& worker = stats[i];
+    printf("  worker %3d: busy %8.2f ms idle %8.2f ms batches %5d steals %5d\n", uint32_t(i),
+           worker.busyMicroSeconds / 1000.0f, worker.idleMicroSeconds / 1000.0f, worker.batches, worker.steals);
+    busyMax = std::max(busyMax, worker.busyMicroSeconds);
+    busyAvg += worker.busyMicroSeconds;
+  }
+  busyAvg /= double(stats.size());
+  printf("  load imbalance (max/avg busy) %.2f\n", busyAvg > 0 ? busyMax / busyAvg : 1.0);
+}
+
+}  // namespace ldrawviewer
@@ -0,0 +1,137 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ldrawviewer {
+
+// steady clock, for timings that are taken outside of the window's profiler
+double getMicroSeconds();
+
+struct WorkerStats
+{
+  double   busyMicroSeconds = 0;
+  double   idleMicroSeconds = 0;
+  uint32_t batches          = 0;
+  uint32_t steals           = 0;
+};
+
+// Items [0, numItems) are split into small batches that are distributed
+// round-robin over per-worker deques. A worker pops from the front of its own
+// deque and, once that is empty, steals from the back of the others. When batches
+// are sorted by descending cost, owners work on the big ones first and thieves
+// pick up the cheap tail.
+class WorkStealingQueues
+{
+public:
+  struct Batch
+  {
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  void init(uint32_t numWorkers, uint32_t numItems, uint32_t batchSize);
+  void init(uint32_t numWorkers, const std::vector<Batch>& batches);
+
+  // returns false once all deques are empty
+  bool acquire(uint32_t worker, Batch& batch, bool& stolen);
+
+  uint32_t getNumWorkers() const { return uint32_t(m_queues.size()); }
+
+private:
+  struct Queue
+  {
+    std::mutex        mutex;
+    std::deque<Batch> batches;
+  };
+
+  std::vector<Queue> m_queues;
+};
+
+// picks a batch size that leaves enough batches per worker for stealing to balance out
+uint32_t getWorkStealingBatchSize(uint32_t numItems, uint32_t numWorkers);
+
+// Persistent set of worker threads, every parallel job is processed via
+// work-stealing over small batches. The calling thread blocks until the job
+// is completed, nested jobs from within workers are not supported.
+class ThreadPool
+{
+public:
+  typedef std::function<void(uint32_t worker, uint32_t begin, uint32_t end)> BatchFunction;
+
+  struct Stats
+  {
+    uint32_t jobs                        = 0;
+    uint32_t wakeups                     = 0;
+    double   spawnMicroSeconds           = 0;  // measured cost to create and join a single thread
+    double   avoidedSpawnMicroSeconds    = 0;  // what spawning fresh threads per job would have cost
+    double   queueLatencyMicroSeconds    = 0;  // sum over all wakeups, dispatch to worker start
+    double   queueLatencyMaxMicroSeconds = 0;
+  };
+
+  ~ThreadPool() { deinit(); }
+
+  void init(uint32_t numWorkers);
+  void deinit();
+
+  uint32_t getNumWorkers() const { return uint32_t(m_threads.size()); }
+
+  void parallelBatches(uint32_t numItems, uint32_t batchSize, const BatchFunction& fn, std::vector<WorkerStats>* workerStats = nullptr);
+  void parallelBatches(const std::vector<WorkStealingQueues::Batch>& batches,
+                       const BatchFunction&                          fn,
+                       std::vector<WorkerStats>*                     workerStats = nullptr);
+  void parallelItems(uint32_t numItems, const BatchFunction& fn, std::vector<WorkerStats>* workerStats = nullptr)
+  {
+    parallelBatches(numItems, getWorkStealingBatchSize(numItems, getNumWorkers()), fn, workerStats);
+  }
+
+  const Stats& getStats() const { return m_stats; }
+  void         printStats() const;
+
+private:
+  void workerLoop(uint32_t idx);
+  void dispatch(const BatchFunction& fn, std::vector<WorkerStats>* workerStats);
+
+  std::vector<std::thread> m_threads;
+  std::mutex               m_mutex;
+  std::mutex               m_dispatchMutex;
+  std::condition_variable  m_wakeCondition;
+  std::condition_variable  m_doneCondition;
+  uint64_t                 m_generation   = 0;
+  uint32_t                 m_pending      = 0;
+  bool                     m_shutdown     = false;
+  double                   m_dispatchTime = 0;
+  const BatchFunction*     m_fn           = nullptr;
+
+  WorkStealingQueues       m_queues;
+  std::vector<WorkerStats> m_workerStats;
+  Stats                    m_stats;
+};
+
+void printWorkerStats(const std::vector<WorkerStats>& stats);
+
+}  // namespace ldrawviewer
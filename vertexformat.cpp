@@ -0,0 +1,161 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "vertexformat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace ldrawviewer {
+
+static inline uint16_t quantizeUnorm16(float value, float minValue, float maxValue)
+{
+  float extent = maxValue - minValue;
+  if(extent <= 0)
+    return 0;
+
+  float unorm = std::min(std::max((value - minValue) / extent, 0.0f), 1.0f);
+  return uint16_t(std::lround(unorm * 65535.0f));
+}
+
+static inline float dequantizeUnorm16(uint16_t value, float minValue, float maxValue)
+{
+  // same expression as scene.vert.glsl
+  float unorm = float(value) / 65535.0f;
+  return minValue + (maxValue - minValue) * unorm;
+}
+
+void quantizePosition(const LdrVector& position, const LdrBbox& bbox, uint16_t quantized[4])
+{
+  quantized[0] = quantizeUnorm16(position.x, bbox.min.x, bbox.max.x);
+  quantized[1] = quantizeUnorm16(position.y, bbox.min.y, bbox.max.y);
+  quantized[2] = quantizeUnorm16(position.z, bbox.min.z, bbox.max.z);
+  quantized[3] = 0;
+}
+
+LdrVector dequantizePosition(const uint16_t quantized[4], const LdrBbox& bbox)
+{
+  LdrVector position;
+  position.x = dequantizeUnorm16(quantized[0], bbox.min.x, bbox.max.x);
+  position.y = dequantizeUnorm16(quantized[1], bbox.min.y, bbox.max.y);
+  position.z = dequantizeUnorm16(quantized[2], bbox.min.z, bbox.max.z);
+  return position;
+}
+
+static inline int16_t quantizeSnorm16(float value)
+{
+  return int16_t(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+static inline float signNotZero(float value)
+{
+  return value >= 0 ? 1.0f : -1.0f;
+}
+
+void encodeOctahedral(const LdrVector& normal, int16_t encoded[2])
+{
+  float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+  if(length == 0) {
+    encoded[0] = 0;
+    encoded[1] = 0;
+    return;
+  }
+
+  float x = normal.x / length;
+  float y = normal.y / length;
+  // lower hemisphere is folded over the diagonals
+  if(normal.z < 0) {
+    float foldX = (1.0f - std::fabs(y)) * signNotZero(x);
+    float foldY = (1.0f - std::fabs(x)) * signNotZero(y);
+    x           = foldX;
+    y           = foldY;
+  }
+  encoded[0] = quantizeSnorm16(x);
+  encoded[1] = quantizeSnorm16(y);
+}
+
+LdrVector decodeOctahedral(const int16_t encoded[2])
+{
+  // GL snorm conversion, then the same unfolding as scene.vert.glsl
+  LdrVector normal;
+  normal.x = std::max(float(encoded[0]) / 32767.0f, -1.0f);
+  normal.y = std::max(float(encoded[1]) / 32767.0f, -1.0f);
+  normal.z = 1.0f - std::fabs(normal.x) - std::fabs(normal.y);
+
+  float t = std::max(-normal.z, 0.0f);
+  normal.x += normal.x >= 0 ? -t : t;
+  normal.y += normal.y >= 0 ? -t : t;
+
+  float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+  normal.x /= length;
+  normal.y /= length;
+  normal.z /= length;
+  return normal;
+}
+
+QuantizationError measureQuantizationError(LdrPartID      part,
+                                           const void*    vertices,
+                                           size_t         vertexSize,
+                                           size_t         normalOffset,
+                                           uint32_t       numVertices,
+                                           const LdrBbox& bbox,
+                                           bool           hasNormals)
+{
+  QuantizationError error = {part, 0, 0};
+
+  double maxCosineError = 0;
+  for(uint32_t v = 0; v < numVertices; v++) {
+    const uint8_t* vertex = (const uint8_t*)vertices + vertexSize * v;
+
+    LdrVector position;
+    memcpy(&position, vertex, sizeof(LdrVector));
+
+    uint16_t quantized[4];
+    quantizePosition(position, bbox, quantized);
+    LdrVector decoded = dequantizePosition(quantized, bbox);
+
+    float dx       = decoded.x - position.x;
+    float dy       = decoded.y - position.y;
+    float dz       = decoded.z - position.z;
+    error.position = std::max(error.position, std::sqrt(dx * dx + dy * dy + dz * dz));
+
+    if(hasNormals) {
+      LdrVector normal;
+      memcpy(&normal, vertex + normalOffset, sizeof(LdrVector));
+
+      double length = std::sqrt(double(normal.x) * normal.x + double(normal.y) * normal.y + double(normal.z) * normal.z);
+      if(length == 0)
+        continue;
+
+      int16_t encoded[2];
+      encodeOctahedral(normal, encoded);
+      LdrVector decodedNormal = decodeOctahedral(encoded);
+
+      double cosine  = (normal.x * decodedNormal.x + normal.y * decodedNormal.y + normal.z * decodedNormal.z) / length;
+      maxCosineError = std::max(maxCosineError, 1.0 - std::min(cosine, 1.0));
+    }
+  }
+
+  error.normal = float(std::acos(1.0 - maxCosineError) * 180.0 / 3.14159265358979);
+  return error;
+}
+
+}  // namespace ldrawviewer
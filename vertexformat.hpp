@@ -0,0 +1,68 @@
+/*
+* Copyright (c) 2026, Christoph Kubisch. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* SPDX-FileCopyrightText: Copyright (c) 2026 Christoph Kubisch
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+#include "external/ldrawloader/src/ldrawloader.h"
+
+namespace ldrawviewer {
+
+// Compact vertex encodings, decoded in scene.vert.glsl.
+// Positions are 16-bit unorm relative to the part's bounding box, which the
+// shader gets from the part bounds buffer, normals are octahedral 2x16-bit snorm.
+
+struct QuantizedVertex
+{
+  uint16_t position[4];  // w unused
+};
+
+struct QuantizedRenderVertex
+{
+  uint16_t position[4];  // w unused
+  int16_t  normal[2];
+};
+
+void      quantizePosition(const LdrVector& position, const LdrBbox& bbox, uint16_t quantized[4]);
+LdrVector dequantizePosition(const uint16_t quantized[4], const LdrBbox& bbox);
+
+// normal does not need to be normalized, zero vectors encode as +z
+void      encodeOctahedral(const LdrVector& normal, int16_t encoded[2]);
+LdrVector decodeOctahedral(const int16_t encoded[2]);
+
+// largest deviation over the part's vertices, position in LDraw units, normal in degrees
+struct QuantizationError
+{
+  LdrPartID part;
+  float     position;
+  float     normal;
+};
+
+// position must be the first member of the vertex, normals are optional
+QuantizationError measureQuantizationError(LdrPartID      part,
+                                           const void*    vertices,
+                                           size_t         vertexSize,
+                                           size_t         normalOffset,
+                                           uint32_t       numVertices,
+                                           const LdrBbox& bbox,
+                                           bool           hasNormals);
+
+}  // namespace ldrawviewer